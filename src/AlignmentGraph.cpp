@@ -47,6 +47,28 @@ void shasta::align(
     // Also create alignment summary information.
     AlignmentInfo& alignmentInfo
     )
+{
+    const array<MarkersSortedByKmerId, 2> markerViews = {
+        MarkersSortedByKmerId(markers[0]),
+        MarkersSortedByKmerId(markers[1])};
+    graph.create(markerViews, maxMarkerFrequency, maxSkip, maxDrift, debug,
+        alignment, alignmentInfo);
+}
+
+
+
+// Same, but the markers of the two oriented reads
+// are passed as views that don't require copying.
+void shasta::align(
+    const array<MarkersSortedByKmerId, 2>& markers,
+    size_t maxSkip,
+    size_t maxDrift,
+    uint32_t maxMarkerFrequency,
+    bool debug,
+    AlignmentGraph& graph,
+    Alignment& alignment,
+    AlignmentInfo& alignmentInfo
+    )
 {
     graph.create(markers, maxMarkerFrequency, maxSkip, maxDrift, debug,
         alignment, alignmentInfo);
@@ -56,7 +78,7 @@ void shasta::align(
 
 
 void AlignmentGraph::create(
-    const array<vector<MarkerWithOrdinal>, 2>& markers,
+    const array<MarkersSortedByKmerId, 2>& markers,
     uint32_t maxMarkerFrequency,
     size_t maxSkip,
     size_t maxDrift,
@@ -139,7 +161,7 @@ void AlignmentGraph::create(
 
 
 void AlignmentGraph::writeMarkers(
-    const vector<MarkerWithOrdinal>& markers,
+    const MarkersSortedByKmerId& markers,
     const string& fileName
     )
 {
@@ -147,7 +169,7 @@ void AlignmentGraph::writeMarkers(
     csv << "Index,KmerId,Ordinal,Position\n";
 
     for(size_t i=0; i<markers.size(); i++) {
-        const MarkerWithOrdinal& marker = markers[i];
+        const MarkerWithOrdinal marker = markers[i];
         csv << i << "," << marker.kmerId << "," << marker.ordinal << "," << marker.position << "\n";
     }
 
@@ -156,19 +178,14 @@ void AlignmentGraph::writeMarkers(
 
 
 void AlignmentGraph::createVertices(
-    const array<vector<MarkerWithOrdinal>, 2>& markers,
+    const array<MarkersSortedByKmerId, 2>& markers,
     uint32_t maxMarkerFrequency)
 {
     // Some shorthands for readability.
-    const vector<MarkerWithOrdinal>& markers0 = markers[0];
-    const vector<MarkerWithOrdinal>& markers1 = markers[1];
-
-    // Some iterators we will need.
-    using MarkerIterator = vector<MarkerWithOrdinal>::const_iterator;
-    const MarkerIterator begin0 = markers0.begin();
-    const MarkerIterator end0   = markers0.end();
-    const MarkerIterator begin1 = markers1.begin();
-    const MarkerIterator end1   = markers1.end();
+    const MarkersSortedByKmerId& markers0 = markers[0];
+    const MarkersSortedByKmerId& markers1 = markers[1];
+    const uint64_t end0 = markers0.size();
+    const uint64_t end1 = markers1.size();
 
     // Initialize isLowFrequencyMarker flags to all true.
     // We will set to false the ones that need it,
@@ -179,44 +196,47 @@ void AlignmentGraph::createVertices(
     }
 
     // Joint loop over the markers, looking for common k-mer ids.
-    auto it0 = begin0;
-    auto it1 = begin1;
-    while(it0!=end0 && it1!=end1) {
-        if(it0->kmerId < it1->kmerId) {
-            ++it0;
-        } else if(it1->kmerId < it0->kmerId) {
-            ++it1;
+    // The markers are accessed by index in their sorted order.
+    uint64_t i0 = 0;
+    uint64_t i1 = 0;
+    while(i0!=end0 && i1!=end1) {
+        const KmerId kmerId0 = markers0.kmerId(i0);
+        const KmerId kmerId1 = markers1.kmerId(i1);
+        if(kmerId0 < kmerId1) {
+            ++i0;
+        } else if(kmerId1 < kmerId0) {
+            ++i1;
         } else {
 
             // We found a common k-mer id.
-            const KmerId kmerId = it0->kmerId;
+            const KmerId kmerId = kmerId0;
 
 
             // This k-mer could appear more than once in each of the oriented reads,
             // so we need to find the streak of this k-mer in kmers0 and kmers1.
-            MarkerIterator it0Begin = it0;
-            MarkerIterator it1Begin = it1;
-            MarkerIterator it0End = it0Begin;
-            MarkerIterator it1End = it1Begin;
-            while(it0End!=end0 && it0End->kmerId==kmerId) {
-                ++it0End;
+            const uint64_t i0Begin = i0;
+            const uint64_t i1Begin = i1;
+            uint64_t i0End = i0Begin;
+            uint64_t i1End = i1Begin;
+            while(i0End!=end0 && markers0.kmerId(i0End)==kmerId) {
+                ++i0End;
             }
-            while(it1End!=end1 && it1End->kmerId==kmerId) {
-                ++it1End;
+            while(i1End!=end1 && markers1.kmerId(i1End)==kmerId) {
+                ++i1End;
             }
-            const size_t streakLength0 = it0End - it0Begin;
-            const size_t streakLength1 = it1End - it1Begin;
+            const size_t streakLength0 = i0End - i0Begin;
+            const size_t streakLength1 = i1End - i1Begin;
 
 
             if(streakLength0>maxMarkerFrequency || streakLength1>maxMarkerFrequency) {
 
                 // At least one of these streaks is too long.
                 // Flag these markers as high frequency markers.
-                for(MarkerIterator jt0=it0Begin; jt0!=it0End; ++jt0) {
-                    isLowFrequencyMarker[0][jt0->ordinal]= false;
+                for(uint64_t j0=i0Begin; j0!=i0End; ++j0) {
+                    isLowFrequencyMarker[0][markers0[j0].ordinal]= false;
                 }
-                for(MarkerIterator jt1=it1Begin; jt1!=it1End; ++jt1) {
-                    isLowFrequencyMarker[1][jt1->ordinal]= false;
+                for(uint64_t j1=i1Begin; j1!=i1End; ++j1) {
+                    isLowFrequencyMarker[1][markers1[j1].ordinal]= false;
                 }
 
             } else {
@@ -225,19 +245,21 @@ void AlignmentGraph::createVertices(
                 // Generate vertices in the alignment graph.
 
                 // Loop over pairs in the streaks.
-                for(MarkerIterator jt0=it0Begin; jt0!=it0End; ++jt0) {
-                    for(MarkerIterator jt1=it1Begin; jt1!=it1End; ++jt1) {
+                for(uint64_t j0=i0Begin; j0!=i0End; ++j0) {
+                    const MarkerWithOrdinal marker0 = markers0[j0];
+                    for(uint64_t j1=i1Begin; j1!=i1End; ++j1) {
+                        const MarkerWithOrdinal marker1 = markers1[j1];
 
                         // Generate a vertex corresponding to this pair
                         // of occurrences of this common k-mer.
                         AlignmentGraphVertex vertex;
                         vertex.kmerId = kmerId;
-                        vertex.indexes[0] = jt0 - begin0;
-                        vertex.indexes[1] = jt1 - begin1;
-                        vertex.positions[0] = jt0->position;
-                        vertex.positions[1] = jt1->position;
-                        vertex.ordinals[0] = jt0->ordinal;
-                        vertex.ordinals[1] = jt1->ordinal;
+                        vertex.indexes[0] = j0;
+                        vertex.indexes[1] = j1;
+                        vertex.positions[0] = marker0.position;
+                        vertex.positions[1] = marker1.position;
+                        vertex.ordinals[0] = marker0.ordinal;
+                        vertex.ordinals[1] = marker1.ordinal;
                         addVertex(vertex);
                     }
                 }
@@ -245,8 +267,8 @@ void AlignmentGraph::createVertices(
             }
 
             // Continue joint loop over k-mers.
-            it0 = it0End;
-            it1 = it1End;
+            i0 = i0End;
+            i1 = i1End;
         }
     }
 
@@ -500,8 +522,8 @@ void AlignmentGraph::writeShortestPath(const string& fileName) const
 // Write an image representing the markers and the computed alignment
 // in 2-D ordinal space.
 void AlignmentGraph::writeImage(
-    const vector<MarkerWithOrdinal>& markers0,
-    const vector<MarkerWithOrdinal>& markers1,
+    const MarkersSortedByKmerId& markers0,
+    const MarkersSortedByKmerId& markers1,
     const Alignment& alignment,
     const string& fileName)
 {
@@ -543,9 +565,9 @@ void AlignmentGraph::writeImage(
 
     // Write the markers.
     for(int i0=0; i0<n0; i0++) {
-        const MarkerWithOrdinal& marker0 = markers0[i0];
+        const MarkerWithOrdinal marker0 = markers0[i0];
         for(int i1=0; i1<n1; i1++) {
-            const MarkerWithOrdinal& marker1 = markers1[i1];
+            const MarkerWithOrdinal marker1 = markers1[i1];
             if(marker0.kmerId == marker1.kmerId) {
                 image.setPixel(marker0.ordinal, marker1.ordinal, 255, 0, 0);
             }
@@ -22,6 +22,7 @@ To find a good alignment, we find a shortest path in the graph.
 // Shasta
 #include "CompactUndirectedGraph.hpp"
 #include "Marker.hpp"
+#include "Markers.hpp"
 #include "shortestPath.hpp"
 
 // Standard library.
@@ -76,6 +77,19 @@ namespace shasta {
         // Also create alignment summary information.
         AlignmentInfo&
         );
+
+    // Same, but the markers of the two oriented reads
+    // are passed as views that don't require copying.
+    void align(
+        const array<MarkersSortedByKmerId, 2>& markers,
+        size_t maxSkip,
+        size_t maxDrift,
+        uint32_t maxMarkerFrequency,
+        bool debug,
+        AlignmentGraph&,
+        Alignment&,
+        AlignmentInfo&
+        );
 }
 
 
@@ -128,7 +142,7 @@ class shasta::AlignmentGraph : public AlignmentGraphBaseClass {
 public:
 
     void create(
-        const array<vector<MarkerWithOrdinal>, 2>&,
+        const array<MarkersSortedByKmerId, 2>&,
         uint32_t maxMarkerFrequency,
         size_t maxSkip,
         size_t maxDrift,
@@ -144,11 +158,11 @@ private:
     vertex_descriptor vFinish;
 
     static void writeMarkers(
-        const vector<MarkerWithOrdinal>&,
+        const MarkersSortedByKmerId&,
         const string& fileName
         );
     void createVertices(
-        const array<vector<MarkerWithOrdinal>, 2>&,
+        const array<MarkersSortedByKmerId, 2>&,
         uint32_t maxMarkerFrequency);
     void writeVertices(const string& fileName) const;
     void createEdges(
@@ -165,8 +179,8 @@ private:
     // in 2-D ordinal space.
 public:
     static void writeImage(
-        const vector<MarkerWithOrdinal>&,
-        const vector<MarkerWithOrdinal>&,
+        const MarkersSortedByKmerId&,
+        const MarkersSortedByKmerId&,
         const Alignment&,
         const string& fileName);
 private:
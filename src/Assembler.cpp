@@ -39,14 +39,27 @@ Assembler::Assembler(
         largeDataPageSize = assemblerInfo->largeDataPageSize;
 
         reads.accessExistingReadWrite(largeDataName("Reads"));
-        readNames.accessExistingReadWrite(largeDataName("ReadNames"));
-        readRepeatCounts.accessExistingReadWrite(largeDataName("ReadRepeatCounts"));
+        try {
+            readNames.accessExistingReadWrite(largeDataName("ReadNames"));
+        } catch(...) {
+            compressedReadNames.accessExistingReadOnly(largeDataName("CompressedReadNames"));
+        }
+        try {
+            readRepeatCounts.accessExistingReadWrite(largeDataName("ReadRepeatCounts"));
+        } catch(...) {
+            compressedReadRepeatCounts.accessExistingReadOnly(
+                largeDataName("CompressedReadRepeatCounts"));
+        }
         // cout << "Accessed an existing assembly with page size " << largeDataPageSize << endl;
 
     }
     SHASTA_ASSERT(largeDataPageSize == assemblerInfo->largeDataPageSize);
 
-    // In both cases, assemblerInfo, reads, readNames, readRepeatCounts are all open for write.
+    // In both cases, assemblerInfo and reads are open for write.
+    // The read names are in readNames, open for write,
+    // or in compressedReadNames, open read-only.
+    // The repeat counts are in readRepeatCounts, open for write,
+    // or in compressedReadRepeatCounts, open read-only.
 
 #ifdef SHASTA_HTTP_SERVER
     fillServerFunctionTable();
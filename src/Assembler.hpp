@@ -6,6 +6,8 @@
 #include "AlignmentCandidates.hpp"
 #include "AssembledSegment.hpp"
 #include "AssemblyGraph.hpp"
+#include "CompressedReadNames.hpp"
+#include "CompressedRepeatCounts.hpp"
 #include "Coverage.hpp"
 #include "dset64-gccAtomic.hpp"
 #include "HttpServer.hpp"
@@ -13,6 +15,7 @@
 #include "LongBaseSequence.hpp"
 #include "Marker.hpp"
 #include "MarkerGraph.hpp"
+#include "Markers.hpp"
 #include "MemoryMappedObject.hpp"
 #include "MultithreadedObject.hpp"
 #include "OrientedReadPair.hpp"
@@ -27,7 +30,9 @@
 #endif
 
 // Standard library.
+#include <condition_variable>
 #include "memory.hpp"
+#include <sstream>
 #include "string.hpp"
 #include "tuple.hpp"
 
@@ -49,6 +54,8 @@ namespace shasta {
     class LocalAssemblyGraph;
     class LocalAlignmentGraph;
     class LocalReadGraph;
+    class ReadLoader;
+    class ReadSubsampler;
 
 #ifdef SHASTA_HTTP_SERVER
     class LocalMarkerGraph;
@@ -129,6 +136,19 @@ public:
     double assemblyElapsedTimeSeconds = 0.;
     double averageCpuUtilization;
 
+    // AssemblerInfo is persistent. New fields must be added at the end,
+    // so the AssemblerInfo of existing assemblies remains readable.
+
+    // Statistics on decompression of gzip compressed input files.
+    // These are incremented during each call to addReads.
+    uint64_t compressedInputByteCount = 0;
+    uint64_t decompressedInputByteCount = 0;
+    double inputDecompressionTime = 0.;
+
+    // If k is greater than maxKmerTableK, the k-mer table is empty
+    // and this is the hash threshold used by isHashedMarkerKmer.
+    uint64_t markerHashThreshold = 0;
+
 };
 
 
@@ -173,10 +193,129 @@ public:
         size_t blockSize,
         size_t threadCountForReading,
         size_t threadCountForProcessing);
+    // If a ReadSubsampler is specified, reads it does not select
+    // are not stored.
     void addReads(
         const string& fileName,
         size_t minReadLength,
+        size_t threadCount,
+        uint64_t loadBufferSize = 0,
+        ReadSubsampler* readSubsampler = 0);
+
+    // Add reads from several files.
+    // Up to concurrentFileCount files are loaded at the same time,
+    // each using its share of the threads, so reading and decompression
+    // of some files overlaps with parsing of others.
+    // The reads of each file are appended in the order of the input files,
+    // so the ReadIds don't depend on which file finishes loading first.
+    // If targetCoverage is positive, only a subset of the reads
+    // is stored, as described for subsampleReads below,
+    // but the selection is done while loading, so most of the reads
+    // that are not selected are never stored.
+    void addReads(
+        const vector<string>& fileNames,
+        size_t minReadLength,
+        size_t threadCount,
+        uint64_t loadBufferSize,
+        size_t concurrentFileCount,
+        const string& cacheDirectory = "",
+        double targetCoverage = 0.,
+        uint64_t genomeSize = 0,
+        const string& subsamplingMethod = "hash");
+private:
+    void addReadsThreadFunction(size_t threadId);
+
+    // Remove the reads, beginning at firstReadId,
+    // that are not in the final selection of a ReadSubsampler.
+    void removeUnselectedReads(const ReadSubsampler&, ReadId firstReadId);
+
+    // Functions used to cache preprocessed reads.
+    // See AssemblerReads.cpp for details.
+    static string computeReadsCacheKey(
+        const vector<string>& fileNames,
+        size_t minReadLength,
+        const ReadSubsampler*);
+    static string getReadsCachePath(
+        const string& cacheDirectory,
+        const string& cacheKey);
+    bool loadReadsFromCache(
+        const string& cachePath,
+        const string& cacheKey,
         size_t threadCount);
+    bool cloneReadsFromCache(const string& cachePath);
+    void loadReadsFromCacheThreadFunction(size_t threadId);
+    class LoadReadsFromCacheData {
+    public:
+        LongBaseSequences reads;
+        MemoryMapped::VectorOfVectors<char, uint64_t> readNames;
+        MemoryMapped::VectorOfVectors<uint8_t, uint64_t> readRepeatCounts;
+    };
+    LoadReadsFromCacheData loadReadsFromCacheData;
+    void storeReadsInCache(
+        const string& cacheDirectory,
+        const string& cachePath,
+        const string& cacheKey);
+    void storeReadLoaderStatistics(
+        const ReadLoader&,
+        const string& fileName,
+        size_t minReadLength,
+        ostream&);
+    class AddReadsData {
+    public:
+        const vector<string>* fileNames;
+        size_t minReadLength;
+        size_t threadCountPerFile;
+        uint64_t loadBufferSize;
+        size_t concurrentFileCount;
+        ReadSubsampler* readSubsampler;
+
+        // The reads of a file are stored here after it is loaded,
+        // until all preceding files have been appended.
+        // Messages are also held here so they come out in file order.
+        class File {
+        public:
+            LongBaseSequences reads;
+            MemoryMapped::VectorOfVectors<char, uint64_t> readNames;
+            MemoryMapped::VectorOfVectors<uint8_t, uint64_t> readRepeatCounts;
+            std::ostringstream log;
+
+            // Where the reads of this file go in the global data structures.
+            // Set when space is reserved for them.
+            uint64_t readBegin;
+            uint64_t readWordBegin;
+            uint64_t readNameBegin;
+            uint64_t readRepeatCountBegin;
+        };
+
+        // Indexed by file id. Set when the file is loaded,
+        // and reset after its reads are appended.
+        vector< shared_ptr<File> > files;
+
+        // The next file to be loaded, the number of files for which
+        // space was reserved in the global data structures,
+        // the number of files whose reads are being copied there,
+        // and the number of files whose reads were already appended.
+        // All are protected by the mutex.
+        uint64_t nextFileId;
+        uint64_t reservedFileCount;
+        uint64_t copyingFileCount;
+        uint64_t appendedFileCount;
+        std::condition_variable condition;
+    };
+    AddReadsData addReadsData;
+    bool canAppendReadsInPlace(const AddReadsData::File&) const;
+public:
+
+    // Statistics on decompression of gzip compressed input files
+    // processed by addReads.
+    double getInputDecompressionTime() const
+    {
+        return assemblerInfo->inputDecompressionTime;
+    }
+    uint64_t getDecompressedInputByteCount() const
+    {
+        return assemblerInfo->decompressedInputByteCount;
+    }
 
     // Create a histogram of read lengths.
     void histogramReadLength(const string& fileName);
@@ -190,8 +329,47 @@ public:
 
     // Functions related to markers.
     // See the beginning of Marker.hpp for more information.
-    void findMarkers(size_t threadCount);
+    void findMarkers(
+        size_t threadCount,
+        bool storeStrand1 = true,
+        uint64_t minimizerWindow = 0,
+        bool singlePass = false);
     void accessMarkers();
+    void computeSortedMarkers(size_t threadCount);
+    void accessSortedMarkers();
+    void computeKmerOccurrences(size_t threadCount);
+    void accessKmerOccurrences();
+
+    // The k-mer occurrence index has a table of contents with 4^k+1 entries
+    // of 8 bytes each, so it is only available for k up to this value.
+    // For k=14 the table of contents uses 2 GB.
+    static const uint64_t maxKmerOccurrencesK = 14;
+
+    // Find the oriented reads that contain a given sequence,
+    // using the k-mer occurrence index created by computeKmerOccurrences.
+    // The query sequence is given in raw representation.
+    // Each hit is a chain of marker k-mers shared by the query and
+    // an oriented read, with the difference between read position and
+    // query position (the diagonal) varying by at most maxDrift
+    // between consecutive k-mers of the chain.
+    // All positions are in run-length representation,
+    // and end positions are one past the last base of the last k-mer.
+    // Hits with less than minMarkerCount distinct query k-mers are discarded,
+    // and the remaining ones are returned in order of decreasing markerCount.
+    class SequenceHit {
+    public:
+        ReadId readId;
+        Strand strand;
+        uint32_t markerCount;
+        uint32_t queryBegin;
+        uint32_t queryEnd;
+        uint32_t readBegin;
+        uint32_t readEnd;
+    };
+    vector<SequenceHit> findSequenceInReads(
+        const string& sequence,
+        uint64_t minMarkerCount,
+        uint64_t maxDrift) const;
     void writeMarkers(ReadId, Strand, const string& fileName);
     vector<KmerId> getMarkers(ReadId, Strand);
     void writeMarkerFrequency();
@@ -544,21 +722,63 @@ private:
     run-length representation requires more memory for the reads
     than the raw representation.
 
-    Run-length representations that are more economic in memory are possible,
-    at the price of additional code complexity and performance cost
-    in assembly phases that use the base repeat counts.
+    Optionally (--Reads.compressRepeatCounts), after all reads are
+    loaded the repeat counts are moved to a CompressedRepeatCounts
+    object, which uses about 2.5 bits per base and still allows
+    random access to individual repeat counts.
+    Code that uses repeat counts should access them via
+    getReadRepeatCount and getReadRepeatCounts, which work
+    with either representation.
 
     ***************************************************************************/
 
     LongBaseSequences reads;
     MemoryMapped::VectorOfVectors<uint8_t, uint64_t> readRepeatCounts;
+    CompressedRepeatCounts compressedReadRepeatCounts;
 public:
     ReadId readCount() const
     {
         return ReadId(reads.size());
     }
+
+    // Replace readRepeatCounts with compressedReadRepeatCounts.
+    // After this, no more reads can be added.
+    void compressReadRepeatCounts();
+
+    // Keep only a subset of the reads with total number of raw bases
+    // close to targetCoverage * genomeSize, and remove the others.
+    // This must be called after all reads are loaded,
+    // before anything else is computed.
+    // It is usually better to let addReads do the selection
+    // while loading the reads.
+    // The method can be:
+    // - "hash": select reads in order of a hash of the read name.
+    //   This is a deterministic, unbiased random subsample.
+    // - "longest": select the longest reads.
+    // ReadIds are renumbered, but the selected reads remain
+    // in the same order.
+    void subsampleReads(
+        double targetCoverage,
+        uint64_t genomeSize,
+        const string& method);
 private:
+
+    // Access repeat counts, as stored (that is, for strand 0),
+    // using whichever representation is in use.
+    uint8_t getReadRepeatCount(ReadId readId, uint32_t position) const
+    {
+        if(readRepeatCounts.isOpen()) {
+            return readRepeatCounts.begin(readId)[position];
+        } else {
+            return compressedReadRepeatCounts.get(readId, position);
+        }
+    }
+    void getReadRepeatCounts(ReadId, vector<uint8_t>&) const;
+    uint64_t getReadRepeatCountsTotalSize() const;
+
     void checkReadsAreOpen() const;
+    void checkReadRepeatCountsAreNotCompressed() const;
+    void checkReadNamesAreNotCompressed() const;
     void checkReadNamesAreOpen() const;
     void checkReadId(ReadId) const;
 
@@ -589,9 +809,8 @@ private:
         const ReadId readId = orientedReadId.getReadId();
         const Strand strand = orientedReadId.getStrand();
 
-        // Access the bases and repeat counts for this read.
+        // Access the bases for this read.
         const auto& read = reads[readId];
-        const auto& counts = readRepeatCounts[readId];
 
         // Compute the position as stored, depending on strand.
         uint32_t orientedPosition = position;
@@ -600,7 +819,8 @@ private:
         }
 
         // Extract the base and repeat count at this position.
-        pair<Base, uint8_t> p = make_pair(read[orientedPosition], counts[orientedPosition]);
+        pair<Base, uint8_t> p = make_pair(read[orientedPosition],
+            getReadRepeatCount(readId, orientedPosition));
 
         // Complement the base, if necessary.
         if(strand == 1) {
@@ -631,7 +851,23 @@ private:
     // We don't use read names to identify reads.
     // These names are only used as an aid in tracing each read
     // back to its origin.
+    // Optionally (--Reads.compressNames), after all reads are loaded
+    // the names are moved to compressedReadNames, which
+    // also allows finding a read by name in constant time.
+    // Use getReadName and getReadId, which work with either representation.
     MemoryMapped::VectorOfVectors<char, uint64_t> readNames;
+    CompressedReadNames compressedReadNames;
+public:
+    // Replace readNames with compressedReadNames.
+    // After this, no more reads can be added.
+    void compressReadNames();
+    string getReadName(ReadId) const;
+
+    // Return the ReadId of the read with the given name,
+    // or invalidReadId if there is no such read.
+    // This is a linear scan unless read names are compressed.
+    ReadId getReadId(const string& readName) const;
+private:
 
     // Function to write a read in Fasta format.
     void writeRead(ReadId, ostream&);
@@ -665,9 +901,15 @@ private:
     // if (and only if) a k-mer is a marker, its reverse complement
     // is also a marker. That is, for all permitted values of i, 0 <= i < 4^k:
     // kmerTable[i].isMarker == kmerTable[kmerTable[i].reverseComplementKmerId].isMarker
+    // If k is greater than maxKmerTableK, the k-mer table is empty
+    // and marker k-mers are selected by hashing instead (see Kmer.hpp).
     MemoryMapped::Vector<KmerInfo> kmerTable;
     void checkKmersAreOpen() const;
 
+    // Return true if a k-mer is a marker k-mer,
+    // using the k-mer table if available.
+    bool isMarkerKmer(KmerId) const;
+
 public:
     void accessKmers();
     void writeKmers(const string& fileName) const;
@@ -703,19 +945,88 @@ public:
     );
 private:
     void computeKmerFrequency(size_t threadId);
+    void addReverseComplementedKmerFrequency(size_t threadId);
     void initializeKmerTable();
 
 
 
     // The markers on all oriented reads. Indexed by OrientedReadId::getValue().
-    MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t> markers;
+    // Depending on the option used when finding markers,
+    // this may only store the markers of strand 0 of each read.
+    Markers markers;
     void checkMarkersAreOpen() const;
 
+    // Optional index containing, for each oriented read,
+    // the ordinals of its markers sorted by KmerId.
+    // Markers with the same KmerId are in the same order
+    // as when getMarkersSortedByKmerId sorts them without the index,
+    // so using the index does not change any results.
+    // Indexed by OrientedReadId::getValue().
+    // If the markers only store strand 0, the index also only
+    // stores strand 0, and the entries for strand 1 are empty.
+    // It is computed once by computeSortedMarkers and, if available,
+    // used by getMarkersSortedByKmerId, which then does not need to sort.
+    MemoryMapped::VectorOfVectors<uint32_t, uint64_t> sortedMarkers;
+    void computeSortedMarkersThreadFunction(size_t threadId);
+
+    // Optional inverted index of the markers.
+    // For each KmerId, it contains the occurrences of that k-mer
+    // as a marker, sorted by ReadId and then by ordinal.
+    // Only the markers of strand 0 of each read are stored:
+    // an occurrence of the reverse complement of a k-mer on strand 0
+    // is an occurrence of the k-mer on strand 1.
+    // Indexed by KmerId, so this is only available for k <= maxKmerOccurrencesK.
+    // It is computed once by computeKmerOccurrences and
+    // used by findSequenceInReads.
+    class KmerOccurrence {
+    public:
+        ReadId readId;
+        uint32_t ordinal;
+        bool operator<(const KmerOccurrence& that) const
+        {
+            return tie(readId, ordinal) < tie(that.readId, that.ordinal);
+        }
+    };
+    MemoryMapped::VectorOfVectors<KmerOccurrence, uint64_t> kmerOccurrences;
+    void computeKmerOccurrencesPass1(size_t threadId);
+    void computeKmerOccurrencesPass2(size_t threadId);
+    void computeKmerOccurrencesPass3(size_t threadId);
+
     // Get markers sorted by KmerId for a given OrientedReadId.
     void getMarkersSortedByKmerId(
         OrientedReadId,
         vector<MarkerWithOrdinal>&) const;
 
+    // Same, but return a view of the markers sorted by KmerId.
+    // If sortedMarkers is available for this oriented read,
+    // the view follows the sorted ordinals stored there,
+    // and nothing is copied. Otherwise, the markers are sorted
+    // into the vector passed as an argument, and the view points to it.
+    MarkersSortedByKmerId getMarkersSortedByKmerIdView(
+        OrientedReadId,
+        vector<MarkerWithOrdinal>&) const;
+
+    // Sort the markers of an oriented read by KmerId,
+    // without using sortedMarkers.
+    void sortMarkersByKmerId(
+        OrientedReadId,
+        vector<MarkerWithOrdinal>&) const;
+
+    // Return the sorted ordinals for an oriented read, without copying.
+    // This requires sortedMarkers to be available.
+    // It returns an empty container for strand 1 if
+    // the markers only store strand 0.
+    MemoryAsContainer<const uint32_t> getSortedMarkerOrdinals(OrientedReadId orientedReadId) const
+    {
+        return sortedMarkers[orientedReadId.getValue()];
+    }
+    bool hasSortedMarkerOrdinals(OrientedReadId orientedReadId) const
+    {
+        const uint64_t i = orientedReadId.getValue();
+        return sortedMarkers.isOpen() and
+            ((sortedMarkers.size(i) != 0) or (markers.size(i) == 0));
+    }
+
     // Given a marker by its OrientedReadId and ordinal,
     // return the corresponding global marker id.
     MarkerId getMarkerId(OrientedReadId, uint32_t ordinal) const;
@@ -783,7 +1094,10 @@ public:
         size_t minBucketSize,           // The minimum size for a bucket to be used.
         size_t maxBucketSize,           // The maximum size for a bucket to be used.
         size_t minFrequency,            // Minimum number of lowHash hits for a pair to become a candidate.
-        size_t threadCount
+        size_t threadCount,
+        bool hashFeaturesOnce = false,  // If set, feature hashes are computed once and reused at each iteration.
+        double minNewCandidateFraction = 0.,    // Adaptive mode: stop when the fraction of new candidates is less than this.
+        size_t minCandidatesPerRead = 0         // Adaptive mode: stop when the number of reads with fewer candidates stops decreasing.
     );
     void findAlignmentCandidatesLowHash1(
         size_t m,                       // Number of consecutive k-mers that define a feature.
@@ -793,7 +1107,8 @@ public:
         size_t minBucketSize,           // The minimum size for a bucket to be used.
         size_t maxBucketSize,           // The maximum size for a bucket to be used.
         size_t minFrequency,            // Minimum number of lowHash hits for a pair to become a candidate.
-        size_t threadCount
+        size_t threadCount,
+        bool hashFeaturesOnce = false   // If set, feature hashes are computed once and reused at each iteration.
     );
     void markAlignmentCandidatesAllPairs();
     void accessAlignmentCandidates();
@@ -840,6 +1155,18 @@ private:
         Alignment&,
         AlignmentInfo&
     );
+    // Same, but using views of the markers sorted by kmerId,
+    // as returned by getMarkersSortedByKmerIdView.
+    void alignOrientedReads(
+        const array<MarkersSortedByKmerId, 2>& markersSortedByKmerId,
+        size_t maxSkip,             // Maximum ordinal skip allowed.
+        size_t maxDrift,            // Maximum ordinal drift allowed.
+        uint32_t maxMarkerFrequency,
+        bool debug,
+        AlignmentGraph&,
+        Alignment&,
+        AlignmentInfo&
+    );
 public:
     void analyzeAlignmentMatrix(ReadId, Strand, ReadId, Strand);
 private:
@@ -1565,6 +1892,7 @@ public:
     void exploreSummary(const vector<string>&, ostream&);
     void exploreRead(const vector<string>&, ostream&);
     void blastRead(const vector<string>&, ostream&);
+    void findSequence(const vector<string>&, ostream&);
     void exploreAlignments(const vector<string>&, ostream&);
     void exploreAlignment(const vector<string>&, ostream&);
     void displayAlignmentMatrix(const vector<string>&, ostream&);
@@ -117,6 +117,23 @@ void Assembler::alignOrientedReads(
 
 
 
+void Assembler::alignOrientedReads(
+    const array<MarkersSortedByKmerId, 2>& markersSortedByKmerId,
+    size_t maxSkip,             // Maximum ordinal skip allowed.
+    size_t maxDrift,            // Maximum ordinal drift allowed.
+    uint32_t maxMarkerFrequency,
+    bool debug,
+    AlignmentGraph& graph,
+    Alignment& alignment,
+    AlignmentInfo& alignmentInfo
+)
+{
+    align(markersSortedByKmerId,
+        maxSkip, maxDrift, maxMarkerFrequency, debug, graph, alignment, alignmentInfo);
+}
+
+
+
 // Compute marker alignments of an oriented read with all reads
 // for which we have an alignment.
 void Assembler::alignOverlappingOrientedReads(
@@ -293,7 +310,8 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
 
     array<OrientedReadId, 2> orientedReadIds;
     array<OrientedReadId, 2> orientedReadIdsOppositeStrand;
-    array<vector<MarkerWithOrdinal>, 2> markersSortedByKmerId;
+    array<vector<MarkerWithOrdinal>, 2> sortedMarkersBuffers;
+    array<MarkersSortedByKmerId, 2> markersSortedByKmerId;
     AlignmentGraph graph;
     Alignment alignment;
     AlignmentInfo alignmentInfo;
@@ -334,7 +352,8 @@ void Assembler::computeAlignmentsThreadFunction(size_t threadId)
 
             // Get the markers for the two oriented reads in this candidate.
             for(size_t j=0; j<2; j++) {
-                getMarkersSortedByKmerId(orientedReadIds[j], markersSortedByKmerId[j]);
+                markersSortedByKmerId[j] =
+                    getMarkersSortedByKmerIdView(orientedReadIds[j], sortedMarkersBuffers[j]);
             }
 
             // Compute the Alignment.
@@ -563,7 +582,8 @@ void Assembler::flagPalindromicReadsThreadFunction(size_t threadId)
     AlignmentGraph graph;
     Alignment alignment;
     AlignmentInfo alignmentInfo;
-    array<vector<MarkerWithOrdinal>, 2> markersSortedByKmerId;
+    array<vector<MarkerWithOrdinal>, 2> sortedMarkersBuffers;
+    array<MarkersSortedByKmerId, 2> markersSortedByKmerId;
 
     // Make local copies of the parameters.
     const uint32_t maxSkip = flagPalindromicReadsData.maxSkip;
@@ -587,7 +607,8 @@ void Assembler::flagPalindromicReadsThreadFunction(size_t threadId)
 
             // Get markers sorted by KmerId for this read and its reverse complement.
             for(Strand strand=0; strand<2; strand++) {
-                getMarkersSortedByKmerId(OrientedReadId(readId, strand), markersSortedByKmerId[strand]);
+                markersSortedByKmerId[strand] =
+                    getMarkersSortedByKmerIdView(OrientedReadId(readId, strand), sortedMarkersBuffers[strand]);
             }
 
             // Compute a marker alignment of this read versus its reverse complement.
@@ -93,9 +93,9 @@ void Assembler::alignOrientedReads1(
     using TAlignGraph = Graph<Alignment<TDepStringSet> >;
 
     // Access the markers of our oriented reads.
-    const MemoryAsContainer<CompressedMarker> markers0 =
+    const auto markers0 =
         markers[orientedReadId0.getValue()];
-    const MemoryAsContainer<CompressedMarker> markers1 =
+    const auto markers1 =
         markers[orientedReadId1.getValue()];
 
 
@@ -105,19 +105,29 @@ void Assembler::alignOrientedReads1(
     // So if KmerId 45 is a marker we replace it with the first KmerId
     // that does not represent a marker.
     // This is messy but I did not find a better solution.
+    // Only a limited number of KmerIds are tried, because with long k-mers
+    // or a high marker density all KmerIds can be markers.
     bool replacementIsNeeded = false;
     const KmerId seqanGapValue = 45;
     KmerId replacementValue = seqanGapValue;
-    if(kmerTable[seqanGapValue].isMarker) {
+    if(isMarkerKmer(seqanGapValue)) {
         replacementIsNeeded = true;
-        for(uint64_t i=0; i<kmerTable.size(); i++) {
-            if(!kmerTable[i].isMarker) {
+        const uint64_t k = assemblerInfo->k;
+        const uint64_t kmerCount = (2*k < 64) ?
+            (1ULL << (2ULL*k)) : std::numeric_limits<uint64_t>::max();
+        const uint64_t maxCandidateCount = 1024;
+        for(uint64_t i=0; i<min(kmerCount, maxCandidateCount); i++) {
+            if(!isMarkerKmer(KmerId(i))) {
                 replacementValue = KmerId(i);
                 break;
             }
         }
+        if(replacementValue == seqanGapValue) {
+            throw runtime_error("Align.alignMethod 1 cannot be used because "
+                "no KmerId could be found that is not a marker. "
+                "Use a lower marker density or a different alignment method.");
+        }
         cout << "Replacement value " << replacementValue << endl;
-        SHASTA_ASSERT(replacementValue != seqanGapValue);
     }
 
 
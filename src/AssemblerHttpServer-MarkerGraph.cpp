@@ -62,6 +62,7 @@ void Assembler::exploreMarkerGraph(
         uint32_t(assemblerInfo->k),
         reads,
         readRepeatCounts,
+        compressedReadRepeatCounts,
         markers,
         markerGraph.vertexTable,
         *consensusCaller);
@@ -444,7 +445,7 @@ void Assembler::exploreMarkerGraphVertex(const vector<string>& request, ostream&
     SHASTA_ASSERT(markerCount > 0);
 
     // Get the marker sequence.
-    const KmerId kmerId = markers.begin()[markerIds[0]].kmerId;
+    const KmerId kmerId = markers.get(markerIds[0]).kmerId;
     const size_t k = assemblerInfo->k;
     const Kmer kmer(kmerId, k);
 
@@ -456,7 +457,7 @@ void Assembler::exploreMarkerGraphVertex(const vector<string>& request, ostream&
     vector< vector<uint8_t> > repeatCounts(markerCount, vector<uint8_t>(k));
     for(size_t j=0; j<markerCount; j++) {
         const MarkerId markerId = markerIds[j];
-        const CompressedMarker& marker = markers.begin()[markerId];
+        const CompressedMarker& marker = markers.get(markerId);
         tie(orientedReadIds[j], ordinals[j]) = findMarkerId(markerId);
 
         // Get the repeat count for this marker at each of the k positions.
@@ -50,6 +50,7 @@ void Assembler::fillServerFunctionTable()
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreSummary);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreRead);
     SHASTA_ADD_TO_FUNCTION_TABLE(blastRead);
+    SHASTA_ADD_TO_FUNCTION_TABLE(findSequence);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreAlignments);
     SHASTA_ADD_TO_FUNCTION_TABLE(exploreAlignment);
     SHASTA_ADD_TO_FUNCTION_TABLE(computeAllAlignments);
@@ -302,6 +303,7 @@ void Assembler::writeNavigation(ostream& html) const
         });
     writeNavigation(html, "Reads", {
         {"Reads", "exploreRead"},
+        {"Find a sequence in the reads", "findSequence"},
         });
     writeNavigation(html, "Alignments", {
         {"Stored alignments", "exploreAlignments"},
@@ -382,6 +384,18 @@ void Assembler::accessAllSoft()
         allDataAreAvailable = false;
     }
 
+    // The sorted markers are optional, so don't complain if they are missing.
+    try {
+        accessSortedMarkers();
+    } catch(const exception&) {
+    }
+
+    // The k-mer occurrence index is also optional.
+    try {
+        accessKmerOccurrences();
+    } catch(const exception&) {
+    }
+
     try {
         accessAlignmentCandidates();
     } catch(const exception& e) {
@@ -539,9 +553,9 @@ void Assembler::writeAssemblySummaryBody(ostream& html)
         "<tr><td>Read N50 (for raw read sequence)"
         "<td class=right>" << assemblerInfo->readN50 <<
         "<tr><td>Number of run-length encoded bases"
-        "<td class=right>" << readRepeatCounts.totalSize() <<
+        "<td class=right>" << getReadRepeatCountsTotalSize() <<
         "<tr><td>Average length ratio of run-length encoded sequence over raw sequence"
-        "<td class=right>" << setprecision(4) << double(readRepeatCounts.totalSize()) / double(assemblerInfo->baseCount) <<
+        "<td class=right>" << setprecision(4) << double(getReadRepeatCountsTotalSize()) / double(assemblerInfo->baseCount) <<
         "<tr><td>Number of reads flagged as palindromic"
         "<td class=right>" << assemblerInfo->palindromicReadCount <<
         "<tr><td>Number of reads flagged as chimeric"
@@ -611,14 +625,14 @@ void Assembler::writeAssemblySummaryBody(ostream& html)
         "<tr><td>Average number of markers per raw base"
         "<td class=right>" << setprecision(4) << double(markers.totalSize()/2)/double(assemblerInfo->baseCount) <<
         "<tr><td>Average number of markers per run-length encoded base"
-        "<td class=right>" << setprecision(4) << double(markers.totalSize()/2)/double(readRepeatCounts.totalSize()) <<
+        "<td class=right>" << setprecision(4) << double(markers.totalSize()/2)/double(getReadRepeatCountsTotalSize()) <<
         "<tr><td>Average base offset between markers in raw sequence"
         "<td class=right>" << setprecision(4) << double(assemblerInfo->baseCount)/double(markers.totalSize()/2) <<
         "<tr><td>Average base offset between markers in run-length encoded sequence"
-        "<td class=right>" << setprecision(4) << double(readRepeatCounts.totalSize())/double(markers.totalSize()/2) <<
+        "<td class=right>" << setprecision(4) << double(getReadRepeatCountsTotalSize())/double(markers.totalSize()/2) <<
         "<tr><td>Average base gap between markers in run-length encoded sequence"
         "<td class=right>" << setprecision(4) <<
-        double(readRepeatCounts.totalSize())/double(markers.totalSize()/2) - double(assemblerInfo->k) <<
+        double(getReadRepeatCountsTotalSize())/double(markers.totalSize()/2) - double(assemblerInfo->k) <<
         "</table>"
         "<ul><li>Here and elsewhere, &quot;raw&quot; refers to the original read sequence, "
         "as opposed to run-length encoded sequence.</ul>"
@@ -777,9 +791,9 @@ void Assembler::writeAssemblySummaryJson(ostream& json)
         "    \"Average read length (for raw read sequence)\": " <<
         assemblerInfo->baseCount / assemblerInfo->readCount << ",\n"
         "    \"Read N50 (for raw read sequence)\": " << assemblerInfo->readN50 << ",\n"
-        "    \"Number of run-length encoded bases\": " << readRepeatCounts.totalSize() << ",\n"
+        "    \"Number of run-length encoded bases\": " << getReadRepeatCountsTotalSize() << ",\n"
         "    \"Average length ratio of run-length encoded sequence over raw sequence\": " <<
-        setprecision(4) << double(readRepeatCounts.totalSize()) / double(assemblerInfo->baseCount) << ",\n"
+        setprecision(4) << double(getReadRepeatCountsTotalSize()) / double(assemblerInfo->baseCount) << ",\n"
         "    \"Number of reads flagged as palindromic\": " << assemblerInfo->palindromicReadCount << ",\n"
         "    \"Number of reads flagged as chimeric\": " << assemblerInfo->chimericReadCount << "\n"
         "  },\n"
@@ -843,14 +857,14 @@ void Assembler::writeAssemblySummaryJson(ostream& json)
         "    \"Average number of markers per raw base\": "
         << setprecision(4) << double(markers.totalSize()/2)/double(assemblerInfo->baseCount) << ",\n"
         "    \"Average number of markers per run-length encoded base\": "
-        << setprecision(4) << double(markers.totalSize()/2)/double(readRepeatCounts.totalSize()) << ",\n"
+        << setprecision(4) << double(markers.totalSize()/2)/double(getReadRepeatCountsTotalSize()) << ",\n"
         "    \"Average base offset between markers in raw sequence\": "
         << setprecision(4) << double(assemblerInfo->baseCount)/double(markers.totalSize()/2) << ",\n"
         "    \"Average base offset between markers in run-length encoded sequence\": "
-        << setprecision(4) << double(readRepeatCounts.totalSize())/double(markers.totalSize()/2) << ",\n"
+        << setprecision(4) << double(getReadRepeatCountsTotalSize())/double(markers.totalSize()/2) << ",\n"
         "    \"Average base gap between markers in run-length encoded sequence\": "
         << setprecision(4) <<
-        double(readRepeatCounts.totalSize())/double(markers.totalSize()/2) - double(assemblerInfo->k) << "\n"
+        double(getReadRepeatCountsTotalSize())/double(markers.totalSize()/2) - double(assemblerInfo->k) << "\n"
         "  },\n"
 
 
@@ -946,10 +960,23 @@ void Assembler::exploreRead(
 {
     // Get the ReadId and Strand from the request.
     ReadId readId = 0;
-    const bool readIdIsPresent = getParameterValue(request, "readId", readId);
+    bool readIdIsPresent = getParameterValue(request, "readId", readId);
     Strand strand = 0;
     const bool strandIsPresent = getParameterValue(request, "strand", strand);
 
+    // The read can also be specified by name.
+    // This is only used if the ReadId is not specified.
+    string requestedReadName;
+    getParameterValue(request, "readName", requestedReadName);
+    if(!readIdIsPresent and !requestedReadName.empty()) {
+        readId = getReadId(requestedReadName);
+        if(readId == invalidReadId) {
+            html << "<p>No read with name " << htmlEscape(requestedReadName) << " was found.";
+        } else {
+            readIdIsPresent = true;
+        }
+    }
+
     // Get the begin and end position.
     uint32_t beginPosition = 0;
     const bool beginPositionIsPresent = getParameterValue(request, "beginPosition", beginPosition);
@@ -972,11 +999,16 @@ void Assembler::exploreRead(
     html <<
         "<form>"
         "<input type=submit value='Show read'> "
-        "<input type=text name=readId required" <<
+        "<input type=text name=readId" <<
         (readIdIsPresent ? (" value=" + to_string(readId)) : "") <<
         " size=8 title='Enter a read id between 0 and " << reads.size()-1 << "'>"
         " on strand ";
     writeStrandSelection(html, "strand", strandIsPresent && strand==0, strandIsPresent && strand==1);
+    html << "<br>or read name <input type=text name=readName size=40";
+    if(!requestedReadName.empty()) {
+        html << " value='" << htmlEscape(requestedReadName) << "'";
+    }
+    html << " title='Enter a read name. This is only used if the read id is not specified.'>";
     html << "<br><input type=text name=beginPosition size=8";
     if(beginPositionIsPresent) {
         html << " value=" << beginPosition;
@@ -1008,7 +1040,7 @@ void Assembler::exploreRead(
     const OrientedReadId orientedReadId(readId, strand);
     const vector<Base> rawOrientedReadSequence = getOrientedReadRawSequence(orientedReadId);
     const auto readStoredSequence = reads[readId];
-    const auto readName = readNames[readId];
+    const string readName = getReadName(readId);
     const auto orientedReadMarkers = markers[orientedReadId.getValue()];
     if(!beginPositionIsPresent) {
         beginPosition = 0;
@@ -1790,6 +1822,85 @@ void Assembler::blastRead(
 
 
 
+// Find the oriented reads that contain a given sequence,
+// using the optional k-mer occurrence index.
+// This does not require any external tools.
+void Assembler::findSequence(
+    const vector<string>& request,
+    ostream& html)
+{
+    // Get the parameters.
+    string sequence;
+    const bool sequenceIsPresent = getParameterValue(request, "sequence", sequence);
+    uint64_t minMarkerCount = 3;
+    getParameterValue(request, "minMarkerCount", minMarkerCount);
+    uint64_t maxDrift = 30;
+    getParameterValue(request, "maxDrift", maxDrift);
+
+    // Write the form.
+    html <<
+        "<h1>Find a sequence in the reads</h1>"
+        "<form>"
+        "<textarea name=sequence rows=8 cols=100 required>" << htmlEscape(sequence) << "</textarea>"
+        "<br>Minimum number of marker k-mers per hit "
+        "<input type=text name=minMarkerCount required size=8 value=" << minMarkerCount << ">"
+        "<br>Maximum drift between consecutive marker k-mers of a hit "
+        "<input type=text name=maxDrift required size=8 value=" << maxDrift << ">"
+        "<br><input type=submit value='Find'>"
+        "</form>";
+
+    if(not kmerOccurrences.isOpen()) {
+        html << "<p>The k-mer occurrence index is not available. "
+            "It can be created using option --Kmers.storeKmerOccurrences.";
+        return;
+    }
+    if(not sequenceIsPresent) {
+        return;
+    }
+
+    // Find the hits.
+    vector<SequenceHit> hits;
+    const auto t0 = std::chrono::steady_clock::now();
+    try {
+        hits = findSequenceInReads(sequence, minMarkerCount, maxDrift);
+    } catch(const exception& e) {
+        html << "<p>" << e.what();
+        return;
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    html << "<p>Found " << hits.size() << " hits in " <<
+        1.e-9 * double((std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)).count()) << " s.";
+    if(hits.empty()) {
+        return;
+    }
+
+    // Write them out.
+    html <<
+        "<p>All positions are in run-length representation."
+        "<p><table><tr>"
+        "<th>Oriented<br>read"
+        "<th>Marker<br>k-mers"
+        "<th>Query<br>begin"
+        "<th>Query<br>end"
+        "<th>Read<br>begin"
+        "<th>Read<br>end";
+    for(const SequenceHit& hit: hits) {
+        const OrientedReadId orientedReadId(hit.readId, hit.strand);
+        html <<
+            "<tr>"
+            "<td class=centered><a href='exploreRead?readId=" << hit.readId <<
+            "&strand=" << hit.strand << "'>" << orientedReadId << "</a>"
+            "<td class=centered>" << hit.markerCount <<
+            "<td class=centered>" << hit.queryBegin <<
+            "<td class=centered>" << hit.queryEnd <<
+            "<td class=centered>" << hit.readBegin <<
+            "<td class=centered>" << hit.readEnd;
+    }
+    html << "</table>";
+}
+
+
+
 void Assembler::exploreAlignments(
     const vector<string>& request,
     ostream& html)
@@ -2130,8 +2241,8 @@ void Assembler::exploreAlignment(
         getMarkersSortedByKmerId(orientedReadId0, sortedMarkers0);
         getMarkersSortedByKmerId(orientedReadId1, sortedMarkers1);
         AlignmentGraph::writeImage(
-            sortedMarkers0,
-            sortedMarkers1,
+            MarkersSortedByKmerId(sortedMarkers0),
+            MarkersSortedByKmerId(sortedMarkers1),
             alignment,
             "Alignment.png");
 #else
@@ -3268,7 +3379,7 @@ void Assembler::exploreReadGraph(
         BGL_FORALL_VERTICES(v, graph, LocalReadGraph) {
             const LocalReadGraphVertex& vertex = graph[v];
             const vector<Base> sequence = getOrientedReadRawSequence(vertex.orientedReadId);
-            const auto readName = readNames[vertex.orientedReadId.getReadId()];
+            const string readName = getReadName(vertex.orientedReadId.getReadId());
             fastaFile << ">" << vertex.orientedReadId << " ";
             copy(readName.begin(), readName.end(), ostream_iterator<char>(fastaFile));
             fastaFile << "\n";
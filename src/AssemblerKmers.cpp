@@ -1,4 +1,5 @@
 #include "Assembler.hpp"
+#include "KmerIterator.hpp"
 using namespace shasta;
 
 #include <random>
@@ -8,7 +9,9 @@ using namespace shasta;
 void Assembler::accessKmers()
 {
     kmerTable.accessExistingReadOnly(largeDataName("Kmers"));
-    if(kmerTable.size() != (1ULL<< (2*assemblerInfo->k))) {
+    const uint64_t k = assemblerInfo->k;
+    const uint64_t expectedSize = (k > maxKmerTableK) ? 0 : (1ULL << (2ULL*k));
+    if(kmerTable.size() != expectedSize) {
         throw runtime_error("Size of k-mer vector is inconsistent with stored value of k.");
     }
 }
@@ -34,7 +37,6 @@ void Assembler::randomlySelectKmers(
         throw runtime_error("K-mer capacity exceeded.");
     }
     assemblerInfo->k = k;
-    const size_t kmerCount = 1ULL << (2ULL*k);
 
     // Sanity check on the requested fraction.
     // It can be 1 at most. If it is 1, all k-mers
@@ -45,6 +47,21 @@ void Assembler::randomlySelectKmers(
             to_string(probability) + " requested.");
     }
 
+    // If k is too large for a k-mer table, leave the k-mer table
+    // empty and select marker k-mers by hashing.
+    // Each k-mer is selected together with its reverse complement,
+    // so the probability is used directly.
+    if(k > maxKmerTableK) {
+        kmerTable.createNew(largeDataName("Kmers"), largeDataPageSize);
+        assemblerInfo->markerHashThreshold = (probability == 1.) ?
+            std::numeric_limits<uint64_t>::max() :
+            uint64_t(probability * double(std::numeric_limits<uint64_t>::max()));
+        cout << "Marker " << k << "-mers will be selected by hashing "
+            "with inclusion probability " << probability << "." << endl;
+        return;
+    }
+    const size_t kmerCount = 1ULL << (2ULL*k);
+
 
 
     // Fill in the fields of the k-mer table
@@ -108,6 +125,22 @@ void Assembler::randomlySelectKmers(
 
 
 
+// Return true if a k-mer is a marker k-mer,
+// using the k-mer table if available.
+bool Assembler::isMarkerKmer(KmerId kmerId) const
+{
+    const uint64_t k = assemblerInfo->k;
+    if(k <= maxKmerTableK) {
+        return kmerTable[kmerId].isMarker;
+    } else {
+        return isHashedMarkerKmer(kmerId,
+            Markers::reverseComplementKmerId(kmerId, k),
+            assemblerInfo->markerHashThreshold);
+    }
+}
+
+
+
 void Assembler::initializeKmerTable()
 {
     // Create the kmer table with the necessary size.
@@ -152,6 +185,10 @@ void Assembler::writeKmers(const string& fileName) const
 
     // Get the k-mer length.
     const size_t k = assemblerInfo->k;
+    if(k > maxKmerTableK) {
+        throw runtime_error("The k-mer table is not available for k greater than " +
+            to_string(maxKmerTableK) + ".");
+    }
     const size_t kmerCount = 1ULL << (2ULL*k);
     SHASTA_ASSERT(kmerTable.size() == kmerCount);
 
@@ -197,6 +234,10 @@ void Assembler::selectKmersBasedOnFrequency(
     if(k > Kmer::capacity) {
         throw runtime_error("K-mer capacity exceeded.");
     }
+    if(k > maxKmerTableK) {
+        throw runtime_error("Selection of marker k-mers based on frequency "
+            "is not supported for k greater than " + to_string(maxKmerTableK) + ".");
+    }
     assemblerInfo->k = k;
 
     // Sanity check.
@@ -217,6 +258,8 @@ void Assembler::selectKmersBasedOnFrequency(
     // Compute the frequency of all k-mers in oriented reads.
     setupLoadBalancing(reads.size(), 1000);
     runThreads(&Assembler::computeKmerFrequency, threadCount);
+    setupLoadBalancing(kmerTable.size(), 1024 * 1024);
+    runThreads(&Assembler::addReverseComplementedKmerFrequency, threadCount);
 
     // Compute the total number of k-mer occurrences
     // and the number of RLE kmers.
@@ -350,18 +393,14 @@ void Assembler::selectKmersBasedOnFrequency(
 }
 
 
+// Count the k-mers of all reads, on strand 0 only.
+// All threads increment the frequency field of the shared k-mer table
+// using atomic increments, so the memory used does not depend
+// on the number of threads and no merge step is required.
+// The counts for the reverse complemented reads are
+// added later by addReverseComplementedKmerFrequency.
 void Assembler::computeKmerFrequency(size_t threadId)
 {
-    // Create a frequency vector for this thread.
-    MemoryMapped::Vector<uint64_t> frequency;
-    frequency.createNew(
-        largeDataName("tmp-KmerFrequency-" + to_string(threadId)),
-        largeDataPageSize);
-    frequency.resize(kmerTable.size());
-    fill(frequency.begin(), frequency.end(), 0);
-
-
-
     // Loop over all batches assigned to this thread.
     const size_t k = assemblerInfo->k;
     uint64_t begin, end;
@@ -378,47 +417,38 @@ void Assembler::computeKmerFrequency(size_t threadId)
                 continue;
             }
 
-            // Loop over k-mers of this read.
-            Kmer kmer;
-            for(size_t position=0; position<k; position++) {
-                kmer.set(position, read[position]);
-            }
-            for(uint32_t position=0; /*The check is done later */; position++) {
-
-                // Get the k-mer id.
-                const KmerId kmerId = KmerId(kmer.id(k));
-
-                // Increment its frequency.
-                ++frequency[kmerId];
-
-                // Also increment the frequency of the reverse complemented k-mer.
-                ++frequency[kmerTable[kmerId].reverseComplementedKmerId];
-
-                // Check if we reached the end of the read.
-                if(position+k == read.baseCount) {
-                    break;
-                }
-
-                // Update the k-mer.
-                kmer.shiftLeft();
-                kmer.set(k-1, read[position+k]);
+            // Loop over k-mers of this read and increment their frequencies.
+            for(KmerIterator it(read, k); it.isValid(); ++it) {
+                __sync_fetch_and_add(&kmerTable[it.kmerId()].frequency, 1ULL);
             }
         }
     }
+}
+
 
 
-    // Update the frequency in the k-mer table.
-    {
-        std::lock_guard<std::mutex> lock(mutex);
-        for(uint64_t kmerId=0; kmerId!=frequency.size(); kmerId++) {
-            kmerTable[kmerId].frequency += frequency[kmerId];
+// Each occurrence of a k-mer on strand 0 of a read is also
+// an occurrence of its reverse complement on strand 1.
+// So the frequency of a k-mer in all oriented reads is
+// the sum of the strand 0 frequencies of the k-mer and its reverse complement.
+// Each pair is processed by the thread that owns the lower KmerId.
+void Assembler::addReverseComplementedKmerFrequency(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t kmerId=begin; kmerId!=end; kmerId++) {
+            KmerInfo& info = kmerTable[kmerId];
+            const uint64_t reverseComplementedKmerId = info.reverseComplementedKmerId;
+            if(reverseComplementedKmerId == kmerId) {
+                info.frequency *= 2;
+            } else if(reverseComplementedKmerId > kmerId) {
+                KmerInfo& reverseComplementedInfo = kmerTable[reverseComplementedKmerId];
+                const uint64_t frequency = info.frequency + reverseComplementedInfo.frequency;
+                info.frequency = frequency;
+                reverseComplementedInfo.frequency = frequency;
+            }
         }
     }
-
-
-
-    // Remove the frequency vector for this thread.
-    frequency.remove();
 }
 
 
@@ -15,7 +15,10 @@ void Assembler::findAlignmentCandidatesLowHash0(
     size_t minBucketSize,           // The minimum size for a bucket to be used.
     size_t maxBucketSize,           // The maximum size for a bucket to be used.
     size_t minFrequency,            // Minimum number of minHash hits for a pair to become a candidate.
-    size_t threadCount)
+    size_t threadCount,
+    bool hashFeaturesOnce,
+    double minNewCandidateFraction,
+    size_t minCandidatesPerRead)
 {
 
     // Check that we have what we need.
@@ -37,6 +40,9 @@ void Assembler::findAlignmentCandidatesLowHash0(
         minBucketSize,
         maxBucketSize,
         minFrequency,
+        hashFeaturesOnce,
+        minNewCandidateFraction,
+        minCandidatesPerRead,
         threadCount,
         kmerTable,
         readFlags,
@@ -130,7 +136,8 @@ void Assembler::findAlignmentCandidatesLowHash1(
     size_t minBucketSize,           // The minimum size for a bucket to be used.
     size_t maxBucketSize,           // The maximum size for a bucket to be used.
     size_t minFrequency,            // Minimum number of minHash hits for a pair to become a candidate.
-    size_t threadCount)
+    size_t threadCount,
+    bool hashFeaturesOnce)
 {
     // Check that we have what we need.
     checkKmersAreOpen();
@@ -153,6 +160,7 @@ void Assembler::findAlignmentCandidatesLowHash1(
         minBucketSize,
         maxBucketSize,
         minFrequency,
+        hashFeaturesOnce,
         threadCount,
         kmerTable,
         readFlags,
@@ -365,7 +365,8 @@ void Assembler::createMarkerGraphVertices(
 void Assembler::createMarkerGraphVerticesThreadFunction1(size_t threadId)
 {
 
-    array<vector<MarkerWithOrdinal>, 2> markersSortedByKmerId;
+    array<vector<MarkerWithOrdinal>, 2> sortedMarkersBuffers;
+    array<MarkersSortedByKmerId, 2> markersSortedByKmerId;
     AlignmentGraph graph;
     Alignment alignment;
     AlignmentInfo alignmentInfo;
@@ -414,7 +415,8 @@ void Assembler::createMarkerGraphVerticesThreadFunction1(size_t threadId)
 
             // Get the markers for the two oriented reads.
             for(size_t j=0; j<2; j++) {
-                getMarkersSortedByKmerId(orientedReadIds[j], markersSortedByKmerId[j]);
+                markersSortedByKmerId[j] =
+                    getMarkersSortedByKmerIdView(orientedReadIds[j], sortedMarkersBuffers[j]);
             }
 
             // Compute the Alignment.
@@ -432,7 +434,7 @@ void Assembler::createMarkerGraphVerticesThreadFunction1(size_t threadId)
                 const uint32_t ordinal1 = p[1];
                 const MarkerId markerId0 = getMarkerId(orientedReadIds[0], ordinal0);
                 const MarkerId markerId1 = getMarkerId(orientedReadIds[1], ordinal1);
-                SHASTA_ASSERT(markers.begin()[markerId0].kmerId == markers.begin()[markerId1].kmerId);
+                SHASTA_ASSERT(markers.get(markerId0).kmerId == markers.get(markerId1).kmerId);
                 disjointSetsPointer->unite(markerId0, markerId1);
 
                 // Also merge the reverse complemented markers.
@@ -1384,8 +1386,8 @@ vector<Assembler::GlobalMarkerGraphEdgeInformation> Assembler::getGlobalMarkerGr
             // Get the positions.
             const MarkerId markerId0 = getMarkerId(childInfo.orientedReadId, info.ordinal0);
             const MarkerId markerId1 = getMarkerId(childInfo.orientedReadId, info.ordinal1);
-            const auto& marker0 = markers.begin()[markerId0];
-            const auto& marker1 = markers.begin()[markerId1];
+            const auto& marker0 = markers.get(markerId0);
+            const auto& marker1 = markers.get(markerId1);
             info.position0 = marker0.position;
             info.position1 = marker1.position;
 
@@ -2884,7 +2886,7 @@ void Assembler::computeMarkerGraphVertexConsensusSequence(
     markerPositions.reserve(markerIds.size());
     for(const MarkerId markerId: markerIds) {
         markerInfos.push_back(findMarkerId(markerId));
-        markerPositions.push_back(markers.begin()[markerId].position);
+        markerPositions.push_back(markers.get(markerId).position);
     }
 
 
@@ -4476,7 +4478,7 @@ void Assembler::computeMarkerGraphVerticesCoverageDataThreadFunction(size_t thre
             markerPositions.clear();
             for(const MarkerId markerId: markerIds) {
                 markerInfos.push_back(findMarkerId(markerId));
-                markerPositions.push_back(markers.begin()[markerId].position);
+                markerPositions.push_back(markers.get(markerId).position);
             }
 
             // Loop over the k base positions in this vertex.
@@ -1,23 +1,43 @@
 // shasta.
 #include "Assembler.hpp"
+#include "computeRunLengthRepresentation.hpp"
 #include "findMarkerId.hpp"
+#include "KmerIterator.hpp"
 #include "MarkerFinder.hpp"
+#include "timestamp.hpp"
 using namespace shasta;
 
+// Standard library.
+#include <cctype>
+#include <limits>
+#include <thread>
 
 
-void Assembler::findMarkers(size_t threadCount)
+
+void Assembler::findMarkers(
+    size_t threadCount,
+    bool storeStrand1,
+    uint64_t minimizerWindow,
+    bool singlePass)
 {
     checkReadsAreOpen();
     checkKmersAreOpen();
 
-    markers.createNew(largeDataName("Markers"), largeDataPageSize);
+    markers.createNew(largeDataName("Markers"), largeDataPageSize, assemblerInfo->k);
     MarkerFinder markerFinder(
         assemblerInfo->k,
         kmerTable,
         reads,
         markers,
+        storeStrand1,
+        minimizerWindow,
+        assemblerInfo->markerHashThreshold,
+        singlePass,
         threadCount);
+    if(not storeStrand1) {
+        cout << "Stored only the markers of strand 0, using " <<
+            markers.byteCount() << " bytes." << endl;
+    }
 
 }
 
@@ -25,7 +45,312 @@ void Assembler::findMarkers(size_t threadCount)
 
 void Assembler::accessMarkers()
 {
-    markers.accessExistingReadOnly(largeDataName("Markers"));
+    markers.accessExistingReadOnly(largeDataName("Markers"), assemblerInfo->k);
+}
+
+
+
+// Compute, for each oriented read, the ordinals of its markers
+// sorted by KmerId. This is optional. If done, getMarkersSortedByKmerId
+// no longer needs to sort the markers of an oriented read
+// each time it is called.
+// If the markers only store strand 0, this also only
+// stores strand 0, and strand 1 is still sorted when needed.
+void Assembler::computeSortedMarkers(size_t threadCount)
+{
+    checkMarkersAreOpen();
+    cout << timestamp << "Sorting the markers of each oriented read by k-mer id." << endl;
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    const uint64_t orientedReadCount = markers.size();
+    const bool storeStrand1 = markers.storesStrand1();
+    sortedMarkers.createNew(largeDataName("SortedMarkers"), largeDataPageSize);
+    sortedMarkers.beginPass1(orientedReadCount);
+    for(uint64_t i=0; i<orientedReadCount; i++) {
+        if(storeStrand1 or ((i & 1ULL) == 0)) {
+            sortedMarkers.incrementCount(i, markers.size(i));
+        }
+    }
+    sortedMarkers.beginPass2();
+    sortedMarkers.endPass2(false);
+
+    setupLoadBalancing(orientedReadCount, 1000);
+    runThreads(&Assembler::computeSortedMarkersThreadFunction, threadCount);
+    cout << timestamp << "Done sorting markers." << endl;
+}
+
+
+
+void Assembler::computeSortedMarkersThreadFunction(size_t threadId)
+{
+    // Work area used inside the loop and defined here
+    // to reduce memory allocation activity.
+    vector<MarkerWithOrdinal> v;
+
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch.
+        for(uint64_t i=begin; i!=end; i++) {
+            const uint64_t markerCount = sortedMarkers.size(i);
+            if(markerCount == 0) {
+                continue;
+            }
+
+            // Sort exactly as getMarkersSortedByKmerId does without the index,
+            // so markers with the same KmerId end up in the same order.
+            sortMarkersByKmerId(OrientedReadId(OrientedReadId::Int(i)), v);
+            SHASTA_ASSERT(v.size() == markerCount);
+
+            // Store the ordinals.
+            uint32_t* ordinals = sortedMarkers.begin(i);
+            for(uint64_t j=0; j<markerCount; j++) {
+                ordinals[j] = v[j].ordinal;
+            }
+        }
+    }
+}
+
+
+
+void Assembler::accessSortedMarkers()
+{
+    sortedMarkers.accessExistingReadOnly(largeDataName("SortedMarkers"));
+}
+
+
+
+// Create the k-mer occurrence index, which contains,
+// for each KmerId, the occurrences of that k-mer as a marker
+// on strand 0 of each read.
+// This is optional and only used by findSequenceInReads.
+void Assembler::computeKmerOccurrences(size_t threadCount)
+{
+    checkKmersAreOpen();
+    checkMarkersAreOpen();
+    const uint64_t k = assemblerInfo->k;
+    if(k > maxKmerOccurrencesK) {
+        throw runtime_error("The k-mer occurrence index is only available for k <= " +
+            to_string(maxKmerOccurrencesK) + ".");
+    }
+    cout << timestamp << "Creating the k-mer occurrence index." << endl;
+
+    // Adjust the numbers of threads, if necessary.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // Pass 1: count the occurrences of each k-mer.
+    const uint64_t kmerCount = 1ULL << (2ULL * k);
+    const uint64_t readCount = reads.size();
+    kmerOccurrences.createNew(largeDataName("KmerOccurrences"), largeDataPageSize);
+    kmerOccurrences.beginPass1(kmerCount);
+    setupLoadBalancing(readCount, 1000);
+    runThreads(&Assembler::computeKmerOccurrencesPass1, threadCount);
+
+    // Pass 2: store the occurrences.
+    kmerOccurrences.beginPass2();
+    setupLoadBalancing(readCount, 1000);
+    runThreads(&Assembler::computeKmerOccurrencesPass2, threadCount);
+    kmerOccurrences.endPass2(false);
+
+    // Pass 3: sort the occurrences of each k-mer,
+    // so the result does not depend on the order
+    // in which threads stored them.
+    setupLoadBalancing(kmerCount, 10000);
+    runThreads(&Assembler::computeKmerOccurrencesPass3, threadCount);
+
+    cout << timestamp << "The k-mer occurrence index contains " <<
+        kmerOccurrences.totalSize() << " occurrences and uses " <<
+        (kmerCount + 1) * sizeof(uint64_t) + kmerOccurrences.totalSize() * sizeof(KmerOccurrence) <<
+        " bytes." << endl;
+}
+
+
+
+void Assembler::computeKmerOccurrencesPass1(size_t threadId)
+{
+    vector<KmerId> kmerIdsBuffer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            const uint64_t orientedReadIdValue = OrientedReadId(readId, 0).getValue();
+            const KmerId* kmerIds = markers.getKmerIds(orientedReadIdValue, kmerIdsBuffer);
+            const uint64_t markerCount = markers.size(orientedReadIdValue);
+            for(uint64_t ordinal=0; ordinal<markerCount; ordinal++) {
+                kmerOccurrences.incrementCountMultithreaded(kmerIds[ordinal]);
+            }
+        }
+    }
+}
+
+
+
+void Assembler::computeKmerOccurrencesPass2(size_t threadId)
+{
+    vector<KmerId> kmerIdsBuffer;
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            const uint64_t orientedReadIdValue = OrientedReadId(readId, 0).getValue();
+            const KmerId* kmerIds = markers.getKmerIds(orientedReadIdValue, kmerIdsBuffer);
+            const uint64_t markerCount = markers.size(orientedReadIdValue);
+            KmerOccurrence occurrence;
+            occurrence.readId = readId;
+            for(uint64_t ordinal=0; ordinal<markerCount; ordinal++) {
+                occurrence.ordinal = uint32_t(ordinal);
+                kmerOccurrences.storeMultithreaded(kmerIds[ordinal], occurrence);
+            }
+        }
+    }
+}
+
+
+
+void Assembler::computeKmerOccurrencesPass3(size_t threadId)
+{
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t kmerId=begin; kmerId!=end; kmerId++) {
+            sort(kmerOccurrences.begin(kmerId), kmerOccurrences.end(kmerId));
+        }
+    }
+}
+
+
+
+void Assembler::accessKmerOccurrences()
+{
+    kmerOccurrences.accessExistingReadOnly(largeDataName("KmerOccurrences"));
+}
+
+
+
+vector<Assembler::SequenceHit> Assembler::findSequenceInReads(
+    const string& sequence,
+    uint64_t minMarkerCount,
+    uint64_t maxDrift) const
+{
+    checkKmersAreOpen();
+    checkMarkersAreOpen();
+    if(not kmerOccurrences.isOpen()) {
+        throw runtime_error("The k-mer occurrence index is not accessible.");
+    }
+    const uint64_t k = assemblerInfo->k;
+
+    // Compute the run-length representation of the query.
+    // White space is ignored.
+    vector<Base> rawSequence;
+    for(const char c: sequence) {
+        if(not std::isspace(c)) {
+            rawSequence.push_back(Base::fromCharacter(c));
+        }
+    }
+    vector<Base> runLengthSequence;
+    vector<uint8_t> repeatCount;
+    if(not computeRunLengthRepresentation(rawSequence, runLengthSequence, repeatCount)) {
+        throw runtime_error("The query sequence contains a homopolymer run "
+            "longer than 255 bases.");
+    }
+    const LongBaseSequence query(runLengthSequence);
+
+
+
+    // Gather the hits of the query marker k-mers.
+    // For each hit we store the oriented read, the diagonal
+    // (read position minus query position), the query position,
+    // and the read position.
+    // An occurrence of a k-mer on strand 0 of a read is a hit on strand 0,
+    // and an occurrence of its reverse complement on strand 0
+    // is a hit on strand 1.
+    // Using positions rather than ordinals makes this independent
+    // of marker density.
+    using Hit = tuple<OrientedReadId::Int, int64_t, uint32_t, uint32_t>;
+    vector<Hit> hits;
+    for(KmerIterator it(query, k); it.isValid(); ++it) {
+        const KmerId kmerId = it.kmerId();
+        if(not isMarkerKmer(kmerId)) {
+            continue;
+        }
+        const uint32_t queryPosition = it.position();
+        for(const KmerOccurrence& occurrence: kmerOccurrences[kmerId]) {
+            const OrientedReadId orientedReadId(occurrence.readId, 0);
+            const uint32_t readPosition =
+                markers[orientedReadId.getValue()][occurrence.ordinal].position;
+            hits.push_back(Hit(orientedReadId.getValue(),
+                int64_t(readPosition) - int64_t(queryPosition), queryPosition, readPosition));
+        }
+        for(const KmerOccurrence& occurrence: kmerOccurrences[it.reverseComplementedKmerId()]) {
+            const OrientedReadId orientedReadId(occurrence.readId, 1);
+            const auto orientedReadMarkers = markers[orientedReadId.getValue()];
+            const uint32_t readPosition =
+                orientedReadMarkers[orientedReadMarkers.size() - 1 - occurrence.ordinal].position;
+            hits.push_back(Hit(orientedReadId.getValue(),
+                int64_t(readPosition) - int64_t(queryPosition), queryPosition, readPosition));
+        }
+    }
+    sort(hits.begin(), hits.end());
+
+
+
+    // Chain hits on the same oriented read with consecutive diagonals
+    // differing by at most maxDrift.
+    vector<SequenceHit> sequenceHits;
+    vector<uint32_t> queryPositions;
+    for(uint64_t chainBegin=0; chainBegin!=hits.size(); ) {
+        const OrientedReadId::Int orientedReadIdValue = get<0>(hits[chainBegin]);
+        uint64_t chainEnd = chainBegin + 1;
+        while(chainEnd!=hits.size() and
+            get<0>(hits[chainEnd]) == orientedReadIdValue and
+            uint64_t(get<1>(hits[chainEnd]) - get<1>(hits[chainEnd-1])) <= maxDrift) {
+            ++chainEnd;
+        }
+
+        // Count the distinct query positions in the chain
+        // and compute its position ranges.
+        queryPositions.clear();
+        uint32_t readBegin = std::numeric_limits<uint32_t>::max();
+        uint32_t readEnd = 0;
+        for(uint64_t i=chainBegin; i!=chainEnd; i++) {
+            const uint32_t readPosition = get<3>(hits[i]);
+            queryPositions.push_back(get<2>(hits[i]));
+            readBegin = min(readBegin, readPosition);
+            readEnd = max(readEnd, uint32_t(readPosition + k));
+        }
+        sort(queryPositions.begin(), queryPositions.end());
+        queryPositions.resize(
+            unique(queryPositions.begin(), queryPositions.end()) - queryPositions.begin());
+
+        if(queryPositions.size() >= minMarkerCount) {
+            const OrientedReadId orientedReadId = OrientedReadId(orientedReadIdValue);
+            SequenceHit sequenceHit;
+            sequenceHit.readId = orientedReadId.getReadId();
+            sequenceHit.strand = orientedReadId.getStrand();
+            sequenceHit.markerCount = uint32_t(queryPositions.size());
+            sequenceHit.queryBegin = queryPositions.front();
+            sequenceHit.queryEnd = uint32_t(queryPositions.back() + k);
+            sequenceHit.readBegin = readBegin;
+            sequenceHit.readEnd = readEnd;
+            sequenceHits.push_back(sequenceHit);
+        }
+
+        chainBegin = chainEnd;
+    }
+
+    // Best hits first.
+    stable_sort(sequenceHits.begin(), sequenceHits.end(),
+        [](const SequenceHit& x, const SequenceHit& y)
+        {
+            return x.markerCount > y.markerCount;
+        });
+    return sequenceHits;
 }
 
 void Assembler::checkMarkersAreOpen() const
@@ -116,6 +441,49 @@ size_t Assembler::getNumMarkersFromOrientedReadId(OrientedReadId orientedReadId)
 void Assembler::getMarkersSortedByKmerId(
     OrientedReadId orientedReadId,
     vector<MarkerWithOrdinal>& markersSortedByKmerId) const
+{
+    // If the sorted ordinals are available, use them.
+    if(hasSortedMarkerOrdinals(orientedReadId)) {
+        const auto compressedMarkers = markers[orientedReadId.getValue()];
+        const auto ordinals = getSortedMarkerOrdinals(orientedReadId);
+        SHASTA_ASSERT(ordinals.size() == compressedMarkers.size());
+        markersSortedByKmerId.resize(ordinals.size());
+        for(uint64_t i=0; i<ordinals.size(); i++) {
+            const uint32_t ordinal = ordinals[i];
+            markersSortedByKmerId[i] = MarkerWithOrdinal(compressedMarkers[ordinal], ordinal);
+        }
+        return;
+    }
+
+    sortMarkersByKmerId(orientedReadId, markersSortedByKmerId);
+}
+
+
+
+// Same, but return a view of the markers sorted by KmerId.
+// If the sorted ordinals are available, nothing is copied.
+MarkersSortedByKmerId Assembler::getMarkersSortedByKmerIdView(
+    OrientedReadId orientedReadId,
+    vector<MarkerWithOrdinal>& buffer) const
+{
+    if(hasSortedMarkerOrdinals(orientedReadId)) {
+        return MarkersSortedByKmerId(
+            markers[orientedReadId.getValue()],
+            getSortedMarkerOrdinals(orientedReadId).begin());
+    }
+
+    sortMarkersByKmerId(orientedReadId, buffer);
+    return MarkersSortedByKmerId(buffer);
+}
+
+
+
+// Sort the markers of an oriented read by KmerId.
+// This is also used by computeSortedMarkers, so the order of markers
+// with the same KmerId is the same with and without the index.
+void Assembler::sortMarkersByKmerId(
+    OrientedReadId orientedReadId,
+    vector<MarkerWithOrdinal>& markersSortedByKmerId) const
 {
     const auto compressedMarkers = markers[orientedReadId.getValue()];
     markersSortedByKmerId.clear();
@@ -137,9 +505,7 @@ void Assembler::getMarkersSortedByKmerId(
 MarkerId Assembler::getMarkerId(
     OrientedReadId orientedReadId, uint32_t ordinal) const
 {
-    return
-        (markers.begin(orientedReadId.getValue()) - markers.begin())
-        + ordinal;
+    return markers.getMarkerId(orientedReadId, ordinal);
 }
 
 
@@ -180,14 +546,38 @@ MarkerId Assembler::findReverseComplement(MarkerId markerId) const
 void Assembler::writeMarkerFrequency()
 {
     const uint64_t k = assemblerInfo->k;
-    const uint64_t kmerCount = 1ULL << (2ULL*k);
     SHASTA_ASSERT(markers.isOpen());
+
+    // If k is too large for a table indexed by KmerId,
+    // sort the KmerIds of all markers instead.
+    if(k > maxKmerTableK) {
+        vector<KmerId> kmerIds;
+        kmerIds.reserve(markers.totalSize());
+        for(uint64_t i=0; i<markers.size(); i++) {
+            for(const CompressedMarker& marker: markers[i]) {
+                kmerIds.push_back(marker.kmerId);
+            }
+        }
+        sort(kmerIds.begin(), kmerIds.end());
+
+        ofstream csv("MarkerFrequency.csv");
+        for(auto it=kmerIds.begin(); it!=kmerIds.end(); ) {
+            const auto streakEnd = upper_bound(it, kmerIds.end(), *it);
+            const Kmer kmer(*it, k);
+            kmer.write(csv, k);
+            csv << "," << (streakEnd - it) << "\n";
+            it = streakEnd;
+        }
+        return;
+    }
+
+    const uint64_t kmerCount = 1ULL << (2ULL*k);
     vector<uint64_t> frequency(kmerCount, 0);
 
-    const CompressedMarker* compressedMarker = markers.begin();
-    const CompressedMarker* end = markers.end();
-    for(; compressedMarker!=end; ++compressedMarker) {
-        ++frequency[compressedMarker->kmerId];
+    for(uint64_t i=0; i<markers.size(); i++) {
+        for(const CompressedMarker& marker: markers[i]) {
+            ++frequency[marker.kmerId];
+        }
     }
 
     ofstream csv("MarkerFrequency.csv");
@@ -207,6 +207,62 @@ void AssemblerOptions::addConfigurableOptions()
         default_value(10000),
         "Read length cutoff.")
 
+        ("Reads.loadBufferSize",
+        value<uint64_t>(&readsOptions.loadBufferSize)->
+        default_value(0),
+        "If not zero, uncompressed input files are read and processed in chunks "
+        "of this many bytes, which bounds the memory used while loading reads. "
+        "If zero, each input file is read into memory in its entirety.")
+
+        ("Reads.concurrentFileCount",
+        value<int>(&readsOptions.concurrentFileCount)->
+        default_value(1),
+        "The maximum number of input files loaded at the same time. "
+        "Values greater than 1 overlap reading and decompression "
+        "of some files with parsing of others. "
+        "ReadIds are always assigned in the order of the input files.")
+
+        ("Reads.cacheDirectory",
+        value<string>(&readsOptions.cacheDirectory)->
+        default_value(""),
+        "If not empty, a directory used to cache preprocessed reads. "
+        "Runs that use the same input files, minReadLength, "
+        "and subsampling options load the reads from the cache instead of the input files.")
+
+        ("Reads.targetCoverage",
+        value<double>(&readsOptions.targetCoverage)->
+        default_value(0.),
+        "If positive, keep only a subset of the reads, selected while loading, "
+        "with approximately this coverage, computed using Reads.genomeSize. "
+        "If zero, all reads are used.")
+
+        ("Reads.genomeSize",
+        value<uint64_t>(&readsOptions.genomeSize)->
+        default_value(0),
+        "The estimated genome size in bases. "
+        "Only used if Reads.targetCoverage is positive.")
+
+        ("Reads.subsamplingMethod",
+        value<string>(&readsOptions.subsamplingMethod)->
+        default_value("hash"),
+        "The method used to select reads when Reads.targetCoverage is positive. "
+        "Can be hash (a deterministic random selection based on a hash of the read name) "
+        "or longest (select the longest reads).")
+
+        ("Reads.compressRepeatCounts",
+        bool_switch(&readsOptions.compressRepeatCounts)->
+        default_value(false),
+        "If set, after loading reads the base repeat counts of the "
+        "run-length representation are stored in a compressed format "
+        "that uses about 2.5 bits per run-length base instead of 8.")
+
+        ("Reads.compressNames",
+        bool_switch(&readsOptions.compressNames)->
+        default_value(false),
+        "If set, after loading reads the read names are stored in a compressed "
+        "format, with UUID read names stored as 16 bytes. "
+        "This also allows looking up reads by name in constant time.")
+
         ("Reads.palindromicReads.maxSkip",
         value<int>(&readsOptions.palindromicReads.maxSkip)->
         default_value(100),
@@ -240,7 +296,8 @@ void AssemblerOptions::addConfigurableOptions()
         ("Kmers.k",
         value<int>(&kmersOptions.k)->
         default_value(10),
-        "Length of marker k-mers (in run-length space).")
+        "Length of marker k-mers (in run-length space). "
+        "At most 16, or 32 for builds with BUILD_LONG_KMERS.")
 
         ("Kmers.probability",
         value<double>(&kmersOptions.probability)->
@@ -261,6 +318,52 @@ void AssemblerOptions::addConfigurableOptions()
         "enrichment threshold above which a k-mer is not considered as a possible marker. "
         "Enrichment is ratio of k-mer frequency in reads to random.")
 
+        ("Kmers.storeStrand0MarkersOnly",
+        bool_switch(&kmersOptions.storeStrand0MarkersOnly)->
+        default_value(false),
+        "If set, only the markers of strand 0 of each read are stored, "
+        "and the markers of strand 1 are computed from them when needed. "
+        "This halves the memory used by markers, at the cost of "
+        "some additional computation when accessing them.")
+
+        ("Kmers.storeSortedMarkers",
+        bool_switch(&kmersOptions.storeSortedMarkers)->
+        default_value(false),
+        "If set, the markers of each oriented read are sorted by k-mer id "
+        "only once, and the result is stored and used by all "
+        "computations of marker alignments. "
+        "This uses 4 additional bytes per marker. "
+        "If Kmers.storeStrand0MarkersOnly is also set, only strand 0 is stored, "
+        "and the markers of strand 1 are still sorted each time they are needed.")
+
+        ("Kmers.storeKmerOccurrences",
+        bool_switch(&kmersOptions.storeKmerOccurrences)->
+        default_value(false),
+        "If set, an index of the occurrences of each marker k-mer "
+        "in the reads is created. It is used by the http server "
+        "and by Python scripts to find the reads that contain a given sequence. "
+        "This uses 8 additional bytes per marker of strand 0 "
+        "plus 8 bytes per possible k-mer. Only available for k <= 14.")
+
+        ("Kmers.minimizerWindow",
+        value<int>(&kmersOptions.minimizerWindow)->
+        default_value(0),
+        "If not zero, the markers of each read are its window minimizers: "
+        "in each window of this number of consecutive k-mers, "
+        "the ones with the lowest hash value are used as markers. "
+        "Only k-mers selected as described by the other Kmers options "
+        "are considered, so Kmers.probability should normally be set to 1 "
+        "when using this option. Marker density is approximately "
+        "2/(minimizerWindow+1).")
+
+        ("Kmers.findMarkersInSinglePass",
+        bool_switch(&kmersOptions.findMarkersInSinglePass)->
+        default_value(false),
+        "If set, markers are found in a single pass over the reads "
+        "instead of two. This is faster, but the markers of strand 0 "
+        "are temporarily kept in memory while the markers are stored, "
+        "which increases peak memory usage.")
+
         ("MinHash.version",
         value<int>(&minHashOptions.version)->
         default_value(0),
@@ -304,6 +407,32 @@ void AssemblerOptions::addConfigurableOptions()
         "candidates with both orientation. This should only be used for experimentation "
         "on very small runs because it is very time consuming.")
 
+        ("MinHash.hashFeaturesOnce",
+        bool_switch(&minHashOptions.hashFeaturesOnce)->
+        default_value(false),
+        "If set, the hash of each MinHash/LowHash feature is computed only once, "
+        "and the hashes used at each iteration are derived from it "
+        "using an inexpensive invertible function. This is faster when using "
+        "many iterations, but uses 8 additional bytes per marker "
+        "and gives different results.")
+
+        ("MinHash.minNewCandidateFraction",
+        value<double>(&minHashOptions.minNewCandidateFraction)->
+        default_value(0., "0"),
+        "If not zero, the LowHash iteration stops when an iteration finds "
+        "new alignment candidates less than this fraction of the ones found so far. "
+        "minHashIterationCount is then the maximum number of iterations. "
+        "Only used with MinHash.version 0.")
+
+        ("MinHash.minCandidatesPerRead",
+        value<int>(&minHashOptions.minCandidatesPerRead)->
+        default_value(0),
+        "If not zero, the LowHash iteration stops when the number of reads "
+        "with less than this number of alignment candidates "
+        "does not decrease during an iteration, or is zero. "
+        "minHashIterationCount is then the maximum number of iterations. "
+        "Only used with MinHash.version 0.")
+
         ("Align.maxSkip",
         value<int>(&alignOptions.maxSkip)->
         default_value(30),
@@ -460,6 +589,16 @@ void AssemblerOptions::ReadsOptions::write(ostream& s) const
 {
     s << "[Reads]\n";
     s << "minReadLength = " << minReadLength << "\n";
+    s << "loadBufferSize = " << loadBufferSize << "\n";
+    s << "concurrentFileCount = " << concurrentFileCount << "\n";
+    s << "cacheDirectory = " << cacheDirectory << "\n";
+    s << "targetCoverage = " << targetCoverage << "\n";
+    s << "genomeSize = " << genomeSize << "\n";
+    s << "subsamplingMethod = " << subsamplingMethod << "\n";
+    s << "compressRepeatCounts = " <<
+        convertBoolToPythonString(compressRepeatCounts) << "\n";
+    s << "compressNames = " <<
+        convertBoolToPythonString(compressNames) << "\n";
     palindromicReads.write(s);
 }
 
@@ -473,6 +612,15 @@ void AssemblerOptions::KmersOptions::write(ostream& s) const
     s << "suppressHighFrequencyMarkers = " <<
         convertBoolToPythonString(suppressHighFrequencyMarkers) << "\n";
     s << "enrichmentThreshold = " << enrichmentThreshold << "\n";
+    s << "storeStrand0MarkersOnly = " <<
+        convertBoolToPythonString(storeStrand0MarkersOnly) << "\n";
+    s << "storeSortedMarkers = " <<
+        convertBoolToPythonString(storeSortedMarkers) << "\n";
+    s << "storeKmerOccurrences = " <<
+        convertBoolToPythonString(storeKmerOccurrences) << "\n";
+    s << "minimizerWindow = " << minimizerWindow << "\n";
+    s << "findMarkersInSinglePass = " <<
+        convertBoolToPythonString(findMarkersInSinglePass) << "\n";
 }
 
 
@@ -489,6 +637,10 @@ void AssemblerOptions::MinHashOptions::write(ostream& s) const
     s << "minFrequency = " << minFrequency << "\n";
     s << "allPairs = " <<
         convertBoolToPythonString(allPairs) << "\n";
+    s << "hashFeaturesOnce = " <<
+        convertBoolToPythonString(hashFeaturesOnce) << "\n";
+    s << "minNewCandidateFraction = " << minNewCandidateFraction << "\n";
+    s << "minCandidatesPerRead = " << minCandidatesPerRead << "\n";
 }
 
 
@@ -46,6 +46,14 @@ public:
     class ReadsOptions {
     public:
         int minReadLength;
+        uint64_t loadBufferSize;
+        int concurrentFileCount;
+        string cacheDirectory;
+        double targetCoverage;
+        uint64_t genomeSize;
+        string subsamplingMethod;
+        bool compressRepeatCounts;
+        bool compressNames;
         class PalindromicReadOptions {
         public:
             int maxSkip;
@@ -73,6 +81,11 @@ public:
         double probability;
         bool suppressHighFrequencyMarkers;
         double enrichmentThreshold;
+        bool storeStrand0MarkersOnly;
+        bool storeSortedMarkers;
+        bool storeKmerOccurrences;
+        int minimizerWindow;
+        bool findMarkersInSinglePass;
         void write(ostream&) const;
     };
     KmersOptions kmersOptions;
@@ -92,6 +105,9 @@ public:
         int maxBucketSize;
         int minFrequency;
         bool allPairs;
+        bool hashFeaturesOnce;
+        double minNewCandidateFraction;
+        int minCandidatesPerRead;
         void write(ostream&) const;
     };
     MinHashOptions minHashOptions;
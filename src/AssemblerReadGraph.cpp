@@ -909,17 +909,18 @@ void Assembler::writeLocalReadGraphReads(
     // Write the fasta file.
     const string fileName = "LocalReadGraph.fasta";
     ofstream fasta(fileName);
+    vector<uint8_t> counts;
     for(const ReadId readId: readsSet) {
 
         // Write the header line with the read name.
-        const auto readName = readNames[readId];
+        const string readName = getReadName(readId);
         fasta << ">" << readId << " ";
         copy(readName.begin(), readName.end(), ostream_iterator<char>(fasta));
         fasta << "\n";
 
         // Write the sequence.
         const auto& sequence = reads[readId];
-        const auto& counts = readRepeatCounts[readId];
+        getReadRepeatCounts(readId, counts);
         const size_t n = sequence.baseCount;
         SHASTA_ASSERT(counts.size() == n);
         for(size_t i=0; i<n; i++) {
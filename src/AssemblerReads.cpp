@@ -1,11 +1,22 @@
 // Shasta.
 #include "Assembler.hpp"
+#include "filesystem.hpp"
+#include "MurmurHash2.hpp"
 #include "OldFastaReadLoader.hpp"
 #include "ReadLoader.hpp"
+#include "ReadSubsampler.hpp"
+#include "timestamp.hpp"
 using namespace shasta;
 
 // Standard libraries.
+#include "chrono.hpp"
+#include <iomanip>
 #include "iterator.hpp"
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
 
@@ -14,16 +25,28 @@ void Assembler::checkReadsAreOpen() const
     if(!reads.isOpen()) {
         throw runtime_error("Reads are not accessible.");
     }
-    if(!readRepeatCounts.isOpen()) {
+    if(!readRepeatCounts.isOpen() and !compressedReadRepeatCounts.isOpen()) {
         throw runtime_error("Read repeat counts are not accessible.");
     }
 }
+void Assembler::checkReadRepeatCountsAreNotCompressed() const
+{
+    if(!readRepeatCounts.isOpen()) {
+        throw runtime_error("Reads cannot be added after read repeat counts are compressed.");
+    }
+}
 void Assembler::checkReadNamesAreOpen() const
 {
-    if(!readNames.isOpen()) {
+    if(!readNames.isOpen() and !compressedReadNames.isOpen()) {
         throw runtime_error("Read names are not accessible.");
     }
 }
+void Assembler::checkReadNamesAreNotCompressed() const
+{
+    if(!readNames.isOpen()) {
+        throw runtime_error("Reads cannot be added after read names are compressed.");
+    }
+}
 void Assembler::checkReadId(ReadId readId) const
 {
     if(readId >= reads.size()) {
@@ -48,6 +71,8 @@ void Assembler::addReadsFromFasta(
 {
     checkReadsAreOpen();
     checkReadNamesAreOpen();
+    checkReadRepeatCountsAreNotCompressed();
+    checkReadNamesAreNotCompressed();
 
     OldFastaReadLoader readLoader(
         fileName,
@@ -83,29 +108,49 @@ void Assembler::addReadsFromFasta(
 void Assembler::addReads(
     const string& fileName,
     size_t minReadLength,
-    const size_t threadCount)
+    const size_t threadCount,
+    uint64_t loadBufferSize,
+    ReadSubsampler* readSubsampler)
 {
     checkReadsAreOpen();
     checkReadNamesAreOpen();
+    checkReadRepeatCountsAreNotCompressed();
+    checkReadNamesAreNotCompressed();
 
     ReadLoader readLoader(
         fileName,
         minReadLength,
         threadCount,
+        loadBufferSize,
         largeDataFileNamePrefix,
         largeDataPageSize,
         reads,
         readNames,
-        readRepeatCounts);
+        readRepeatCounts,
+        cout,
+        readSubsampler);
+
+    storeReadLoaderStatistics(readLoader, fileName, minReadLength, cout);
+}
 
-    cout << "Discarded read statistics for file " << fileName << ":" << endl;
-    cout << "    Discarded " << readLoader.discardedInvalidBaseReadCount <<
+
+
+// Write the discarded read statistics for a file processed by a ReadLoader
+// and add its statistics to those stored in AssemblerInfo.
+void Assembler::storeReadLoaderStatistics(
+    const ReadLoader& readLoader,
+    const string& fileName,
+    size_t minReadLength,
+    ostream& out)
+{
+    out << "Discarded read statistics for file " << fileName << ":" << endl;
+    out << "    Discarded " << readLoader.discardedInvalidBaseReadCount <<
         " reads containing invalid bases for a total " <<
         readLoader.discardedInvalidBaseBaseCount << " valid bases." << endl;
-    cout << "    Discarded " << readLoader.discardedShortReadReadCount <<
+    out << "    Discarded " << readLoader.discardedShortReadReadCount <<
         " reads shorter than " << minReadLength <<
         " bases for a total " << readLoader.discardedShortReadBaseCount << " bases." << endl;
-    cout << "    Discarded " << readLoader.discardedBadRepeatCountReadCount <<
+    out << "    Discarded " << readLoader.discardedBadRepeatCountReadCount <<
         " reads containing repeat counts 256 or more" <<
         " for a total " << readLoader.discardedBadRepeatCountBaseCount << " bases." << endl;
 
@@ -116,6 +161,589 @@ void Assembler::addReads(
     assemblerInfo->discardedShortReadBaseCount += readLoader.discardedShortReadBaseCount;
     assemblerInfo->discardedBadRepeatCountReadCount += readLoader.discardedBadRepeatCountReadCount;
     assemblerInfo->discardedBadRepeatCountBaseCount += readLoader.discardedBadRepeatCountBaseCount;
+
+    // Increment the decompression statistics.
+    assemblerInfo->compressedInputByteCount += readLoader.compressedByteCount;
+    assemblerInfo->decompressedInputByteCount += readLoader.decompressedByteCount;
+    assemblerInfo->inputDecompressionTime += readLoader.decompressionTime;
+}
+
+
+
+// Add reads from several files, loading up to concurrentFileCount
+// files at the same time.
+void Assembler::addReads(
+    const vector<string>& fileNames,
+    size_t minReadLength,
+    size_t threadCount,
+    uint64_t loadBufferSize,
+    size_t concurrentFileCount,
+    const string& cacheDirectory,
+    double targetCoverage,
+    uint64_t genomeSize,
+    const string& subsamplingMethod)
+{
+    checkReadsAreOpen();
+    checkReadNamesAreOpen();
+    checkReadRepeatCountsAreNotCompressed();
+    checkReadNamesAreNotCompressed();
+
+    // Adjust the numbers of threads.
+    if(threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+
+    // If requested, select a subset of the reads while loading them.
+    shared_ptr<ReadSubsampler> readSubsampler;
+    if(targetCoverage > 0.) {
+        readSubsampler = make_shared<ReadSubsampler>(
+            targetCoverage, genomeSize, subsamplingMethod);
+    }
+    const ReadId firstReadId = ReadId(reads.size());
+
+    // The cache describes the complete set of reads,
+    // so it can only be used if no reads are present yet.
+    string cacheKey;
+    string cachePath;
+    if(!cacheDirectory.empty() and reads.size() == 0) {
+        cacheKey = computeReadsCacheKey(fileNames, minReadLength, readSubsampler.get());
+        cachePath = getReadsCachePath(cacheDirectory, cacheKey);
+        if(loadReadsFromCache(cachePath, cacheKey, threadCount)) {
+            return;
+        }
+    }
+    concurrentFileCount = min(concurrentFileCount, fileNames.size());
+    concurrentFileCount = min(concurrentFileCount, threadCount);
+
+    if(concurrentFileCount < 2) {
+
+        // If loading one file at a time, each file can use all threads.
+        for(const string& fileName: fileNames) {
+            addReads(fileName, minReadLength, threadCount, loadBufferSize,
+                readSubsampler.get());
+        }
+
+    } else {
+
+        // Each thread loads one file at a time, using its share of the threads.
+        cout << "Loading up to " << concurrentFileCount << " files at a time." << endl;
+        AddReadsData& data = addReadsData;
+        data.fileNames = &fileNames;
+        data.minReadLength = minReadLength;
+        data.threadCountPerFile = threadCount / concurrentFileCount;
+        data.loadBufferSize = loadBufferSize;
+        data.concurrentFileCount = concurrentFileCount;
+        data.readSubsampler = readSubsampler.get();
+        data.files.clear();
+        data.files.resize(fileNames.size());
+        data.nextFileId = 0;
+        data.reservedFileCount = 0;
+        data.copyingFileCount = 0;
+        data.appendedFileCount = 0;
+        runThreads(&Assembler::addReadsThreadFunction, concurrentFileCount);
+        SHASTA_ASSERT(data.appendedFileCount == fileNames.size());
+        data.files.clear();
+    }
+
+    // Remove the reads that were stored while loading,
+    // but are not part of the final selection.
+    if(readSubsampler) {
+        removeUnselectedReads(*readSubsampler, firstReadId);
+    }
+
+    if(!cachePath.empty()) {
+        storeReadsInCache(cacheDirectory, cachePath, cacheKey);
+    }
+}
+
+
+
+/*******************************************************************************
+
+Cache of preprocessed reads.
+
+When the same reads are used for many runs (for example, while
+optimizing assembly parameters), most of the read loading time
+can be saved by keeping a copy of the reads, read names,
+and read repeat counts, as loaded, in a cache directory.
+
+Each set of input files has its own subdirectory of the cache directory.
+The name of the subdirectory is a hash of a key that contains
+the absolute path, size, and modification time of each input file
+and the minimum read length. The key is also stored in the subdirectory
+and checked when the cache is used, to protect against hash collisions.
+
+A cache subdirectory is created under a temporary name and renamed
+when complete, so an interrupted run never leaves behind
+an incomplete cache subdirectory.
+
+The cache also stores the AssemblerInfo statistics that describe
+the reads (discarded reads and input decompression),
+so they are the same as if the reads had been loaded from the input files.
+
+When loading from the cache, if the reads are stored in files
+(not anonymous memory) on a filesystem that supports it,
+the cached files are cloned into place (FICLONE). This shares the
+data blocks with the cache without copying them, but unlike hard links
+later changes to the reads do not affect the cache.
+Otherwise, the cached files are mapped and copied in parallel.
+
+*******************************************************************************/
+
+// Increment this when the representation of the reads changes,
+// to invalidate all existing caches.
+static const uint64_t readsCacheVersion = 2;
+
+// Names of the files in a cache subdirectory.
+static const string readsCacheKeyName = "Key";
+static const string readsCacheStatisticsName = "Statistics";
+static const string readsCacheReadsName = "Reads";
+static const string readsCacheReadNamesName = "ReadNames";
+static const string readsCacheReadRepeatCountsName = "ReadRepeatCounts";
+
+// The page size used for the cached files.
+static const size_t readsCachePageSize = 4096;
+
+// The files that contain the cached reads, read names,
+// and read repeat counts, relative to their names above.
+static const vector<string> readsCacheFileNames = {
+    readsCacheReadsName + "-BaseCount",
+    readsCacheReadsName + "-Bases.toc",
+    readsCacheReadsName + "-Bases.data",
+    readsCacheReadNamesName + ".toc",
+    readsCacheReadNamesName + ".data",
+    readsCacheReadRepeatCountsName + ".toc",
+    readsCacheReadRepeatCountsName + ".data"
+};
+
+// The AssemblerInfo statistics stored in the cache.
+class ReadsCacheStatistics {
+public:
+    uint64_t discardedInvalidBaseReadCount;
+    uint64_t discardedInvalidBaseBaseCount;
+    uint64_t discardedShortReadReadCount;
+    uint64_t discardedShortReadBaseCount;
+    uint64_t discardedBadRepeatCountReadCount;
+    uint64_t discardedBadRepeatCountBaseCount;
+    uint64_t compressedInputByteCount;
+    uint64_t decompressedInputByteCount;
+    double inputDecompressionTime;
+};
+
+
+
+string Assembler::computeReadsCacheKey(
+    const vector<string>& fileNames,
+    size_t minReadLength,
+    const ReadSubsampler* readSubsampler)
+{
+    std::ostringstream key;
+    key << "Shasta reads cache version " << readsCacheVersion << "\n";
+    key << "minReadLength " << minReadLength << "\n";
+    if(readSubsampler) {
+        key << "subsampling " << readSubsampler->targetCoverage << " " <<
+            readSubsampler->genomeSize << " " << readSubsampler->method << "\n";
+    }
+    for(const string& fileName: fileNames) {
+        struct stat fileInformation;
+        if(::stat(fileName.c_str(), &fileInformation) != 0) {
+            throw runtime_error("Error obtaining file information for " + fileName + ".");
+        }
+        key << filesystem::getAbsolutePath(fileName) << " " <<
+            fileInformation.st_size << " " <<
+            fileInformation.st_mtime << "\n";
+    }
+    return key.str();
+}
+
+
+
+string Assembler::getReadsCachePath(
+    const string& cacheDirectory,
+    const string& cacheKey)
+{
+    const uint64_t hash = MurmurHash64A(cacheKey.data(), int(cacheKey.size()), 759);
+    std::ostringstream s;
+    s << cacheDirectory << "/" << std::hex << std::setfill('0') << std::setw(16) << hash;
+    return s.str();
+}
+
+
+
+// Load the reads from the cache, if available.
+// Returns true if successful.
+bool Assembler::loadReadsFromCache(
+    const string& cachePath,
+    const string& cacheKey,
+    size_t threadCount)
+{
+    // Check that this cache subdirectory exists and has the same key.
+    if(!filesystem::isDirectory(cachePath)) {
+        cout << "The reads cache does not contain these reads." << endl;
+        return false;
+    }
+    {
+        std::ifstream keyFile(cachePath + "/" + readsCacheKeyName);
+        std::ostringstream storedKey;
+        storedKey << keyFile.rdbuf();
+        if(storedKey.str() != cacheKey) {
+            cout << "Reads cache subdirectory " << cachePath <<
+                " is for different reads and will not be used." << endl;
+            return false;
+        }
+    }
+
+    cout << timestamp << "Loading reads from cache " << cachePath << endl;
+    const auto t0 = steady_clock::now();
+
+    // Restore the statistics.
+    {
+        MemoryMapped::Object<ReadsCacheStatistics> statistics;
+        statistics.accessExistingReadOnly(cachePath + "/" + readsCacheStatisticsName);
+        assemblerInfo->discardedInvalidBaseReadCount += statistics->discardedInvalidBaseReadCount;
+        assemblerInfo->discardedInvalidBaseBaseCount += statistics->discardedInvalidBaseBaseCount;
+        assemblerInfo->discardedShortReadReadCount += statistics->discardedShortReadReadCount;
+        assemblerInfo->discardedShortReadBaseCount += statistics->discardedShortReadBaseCount;
+        assemblerInfo->discardedBadRepeatCountReadCount += statistics->discardedBadRepeatCountReadCount;
+        assemblerInfo->discardedBadRepeatCountBaseCount += statistics->discardedBadRepeatCountBaseCount;
+        assemblerInfo->compressedInputByteCount += statistics->compressedInputByteCount;
+        assemblerInfo->decompressedInputByteCount += statistics->decompressedInputByteCount;
+        assemblerInfo->inputDecompressionTime += statistics->inputDecompressionTime;
+    }
+
+    // Clone the cached files into place, if possible.
+    if(cloneReadsFromCache(cachePath)) {
+        const auto t1 = steady_clock::now();
+        cout << timestamp << "Cloned " << reads.size() << " reads from the cache in " <<
+            seconds(t1 - t0) << " s." << endl;
+        return true;
+    }
+
+    // Otherwise, access the cached data and copy it in parallel.
+    LoadReadsFromCacheData& data = loadReadsFromCacheData;
+    data.reads.accessExistingReadOnly(cachePath + "/" + readsCacheReadsName);
+    data.readNames.accessExistingReadOnly(cachePath + "/" + readsCacheReadNamesName);
+    data.readRepeatCounts.accessExistingReadOnly(cachePath + "/" + readsCacheReadRepeatCountsName);
+    SHASTA_ASSERT(data.readNames.size() == data.reads.size());
+    SHASTA_ASSERT(data.readRepeatCounts.size() == data.reads.size());
+    reads.appendUninitialized(data.reads.size(), data.reads.totalWordCount());
+    readNames.appendUninitializedVectors(data.readNames.size(), data.readNames.totalSize());
+    readRepeatCounts.appendUninitializedVectors(
+        data.readRepeatCounts.size(), data.readRepeatCounts.totalSize());
+    setupLoadBalancing(data.reads.size(), 10000);
+    runThreads(&Assembler::loadReadsFromCacheThreadFunction, threadCount);
+    data.reads.close();
+    data.readNames.close();
+    data.readRepeatCounts.close();
+
+    const auto t1 = steady_clock::now();
+    cout << timestamp << "Loaded " << reads.size() << " reads from the cache in " <<
+        seconds(t1 - t0) << " s." << endl;
+    return true;
+}
+
+
+
+// Each thread copies batches of reads from the cache.
+// Reads are stored at the same positions as in the cache,
+// because the cache is only used if no reads are present yet.
+void Assembler::loadReadsFromCacheThreadFunction(size_t threadId)
+{
+    const LoadReadsFromCacheData& data = loadReadsFromCacheData;
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        reads.copySequences(begin, data.reads.wordBegin(begin), data.reads, begin, end);
+        readNames.copyVectors(begin, data.readNames.begin(begin) - data.readNames.begin(),
+            data.readNames, begin, end);
+        readRepeatCounts.copyVectors(begin,
+            data.readRepeatCounts.begin(begin) - data.readRepeatCounts.begin(),
+            data.readRepeatCounts, begin, end);
+    }
+}
+
+
+
+// Clone the cached files into the files that store the reads.
+// This is only possible if the reads are stored in files, with the same
+// page size as the cache, on a filesystem that supports cloning
+// and is the same as the filesystem of the cache.
+// Returns false, without changing the reads, if cloning is not possible.
+bool Assembler::cloneReadsFromCache(const string& cachePath)
+{
+    if(largeDataFileNamePrefix.empty() or largeDataPageSize != readsCachePageSize) {
+        return false;
+    }
+
+    // Clone each of the files to a temporary name.
+    const string temporarySuffix = "-tmp-Clone";
+    vector<string> clonedFileNames;
+    const auto removeClonedFiles = [&clonedFileNames]()
+    {
+        for(const string& clonedFileName: clonedFileNames) {
+            ::unlink(clonedFileName.c_str());
+        }
+    };
+    for(const string& cacheFileName: readsCacheFileNames) {
+        const string sourceFileName = cachePath + "/" + cacheFileName;
+        const string destinationFileName = largeDataName(cacheFileName) + temporarySuffix;
+        const int sourceFileDescriptor = ::open(sourceFileName.c_str(), O_RDONLY);
+        if(sourceFileDescriptor == -1) {
+            removeClonedFiles();
+            throw runtime_error("Error opening " + sourceFileName + " for read.");
+        }
+        const int destinationFileDescriptor = ::open(destinationFileName.c_str(),
+            O_CREAT | O_TRUNC | O_WRONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if(destinationFileDescriptor == -1) {
+            ::close(sourceFileDescriptor);
+            removeClonedFiles();
+            return false;
+        }
+        clonedFileNames.push_back(destinationFileName);
+        const int returnCode = ::ioctl(destinationFileDescriptor, FICLONE, sourceFileDescriptor);
+        ::close(sourceFileDescriptor);
+        ::close(destinationFileDescriptor);
+        if(returnCode == -1) {
+            removeClonedFiles();
+            return false;
+        }
+    }
+
+    // Replace the (empty) reads with the cloned files.
+    reads.remove();
+    readNames.remove();
+    readRepeatCounts.remove();
+    for(const string& cacheFileName: readsCacheFileNames) {
+        const string fileName = largeDataName(cacheFileName);
+        if(::rename((fileName + temporarySuffix).c_str(), fileName.c_str()) != 0) {
+            throw runtime_error("Error renaming " + fileName + temporarySuffix + ".");
+        }
+    }
+    reads.accessExistingReadWrite(largeDataName(readsCacheReadsName));
+    readNames.accessExistingReadWrite(largeDataName(readsCacheReadNamesName));
+    readRepeatCounts.accessExistingReadWrite(largeDataName(readsCacheReadRepeatCountsName));
+    SHASTA_ASSERT(readNames.size() == reads.size());
+    SHASTA_ASSERT(readRepeatCounts.size() == reads.size());
+    return true;
+}
+
+
+
+// Store the reads in the cache.
+void Assembler::storeReadsInCache(
+    const string& cacheDirectory,
+    const string& cachePath,
+    const string& cacheKey)
+{
+    if(!filesystem::isDirectory(cacheDirectory)) {
+        filesystem::createDirectory(cacheDirectory);
+    }
+
+    // Write to a temporary subdirectory.
+    const string temporaryPath = cachePath + "-tmp-" + to_string(::getpid());
+    filesystem::createDirectory(temporaryPath);
+    {
+        std::ofstream keyFile(temporaryPath + "/" + readsCacheKeyName);
+        keyFile << cacheKey;
+        if(!keyFile) {
+            throw runtime_error("Error writing to " + temporaryPath + ".");
+        }
+    }
+    LongBaseSequences cachedReads;
+    MemoryMapped::VectorOfVectors<char, uint64_t> cachedReadNames;
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t> cachedReadRepeatCounts;
+    MemoryMapped::Object<ReadsCacheStatistics> statistics;
+    cachedReads.createNew(temporaryPath + "/" + readsCacheReadsName, readsCachePageSize);
+    cachedReadNames.createNew(temporaryPath + "/" + readsCacheReadNamesName, readsCachePageSize);
+    cachedReadRepeatCounts.createNew(temporaryPath + "/" + readsCacheReadRepeatCountsName, readsCachePageSize);
+    statistics.createNew(temporaryPath + "/" + readsCacheStatisticsName, readsCachePageSize);
+
+    cachedReads.appendUninitialized(reads.size(), reads.totalWordCount());
+    cachedReads.copySequences(0, 0, reads);
+    cachedReadNames.appendUninitializedVectors(readNames.size(), readNames.totalSize());
+    cachedReadNames.copyVectors(0, 0, readNames);
+    cachedReadRepeatCounts.appendUninitializedVectors(
+        readRepeatCounts.size(), readRepeatCounts.totalSize());
+    cachedReadRepeatCounts.copyVectors(0, 0, readRepeatCounts);
+    statistics->discardedInvalidBaseReadCount = assemblerInfo->discardedInvalidBaseReadCount;
+    statistics->discardedInvalidBaseBaseCount = assemblerInfo->discardedInvalidBaseBaseCount;
+    statistics->discardedShortReadReadCount = assemblerInfo->discardedShortReadReadCount;
+    statistics->discardedShortReadBaseCount = assemblerInfo->discardedShortReadBaseCount;
+    statistics->discardedBadRepeatCountReadCount = assemblerInfo->discardedBadRepeatCountReadCount;
+    statistics->discardedBadRepeatCountBaseCount = assemblerInfo->discardedBadRepeatCountBaseCount;
+    statistics->compressedInputByteCount = assemblerInfo->compressedInputByteCount;
+    statistics->decompressedInputByteCount = assemblerInfo->decompressedInputByteCount;
+    statistics->inputDecompressionTime = assemblerInfo->inputDecompressionTime;
+
+    cachedReads.close();
+    cachedReadNames.close();
+    cachedReadRepeatCounts.close();
+    statistics.close();
+
+    // Make it visible. If another run stored the same
+    // reads in the meantime, keep that one.
+    if(::rename(temporaryPath.c_str(), cachePath.c_str()) != 0) {
+        for(const string& path: filesystem::directoryContents(temporaryPath)) {
+            filesystem::remove(path);
+        }
+        ::rmdir(temporaryPath.c_str());
+    } else {
+        cout << "Stored " << reads.size() << " reads in cache " << cachePath << endl;
+    }
+}
+
+
+
+void Assembler::addReadsThreadFunction(size_t threadId)
+{
+    AddReadsData& data = addReadsData;
+    const vector<string>& fileNames = *data.fileNames;
+    const uint64_t fileCount = fileNames.size();
+
+    while(true) {
+
+        // Get the next file to load. To bound memory usage, wait if
+        // concurrentFileCount files are already loaded or being loaded
+        // but not yet appended.
+        uint64_t fileId;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            data.condition.wait(lock, [&data, fileCount]()
+            {
+                return
+                    data.nextFileId == fileCount or
+                    data.nextFileId < data.appendedFileCount + data.concurrentFileCount;
+            });
+            if(data.nextFileId == fileCount) {
+                return;
+            }
+            fileId = data.nextFileId++;
+        }
+        const string& fileName = fileNames[fileId];
+
+        // Load the reads of this file into temporary storage.
+        const shared_ptr<AddReadsData::File> filePointer = make_shared<AddReadsData::File>();
+        AddReadsData::File& file = *filePointer;
+        const string dataNamePrefix =
+            largeDataName("tmp-AddReads-" + to_string(fileId) + "-");
+        const auto dataName = [&dataNamePrefix](const string& name)
+        {
+            return dataNamePrefix.empty() ? string() : (dataNamePrefix + name);
+        };
+        file.reads.createNew(dataName("Reads"), largeDataPageSize);
+        file.readNames.createNew(dataName("ReadNames"), largeDataPageSize);
+        file.readRepeatCounts.createNew(dataName("ReadRepeatCounts"), largeDataPageSize);
+        {
+            ReadLoader readLoader(
+                fileName,
+                data.minReadLength,
+                data.threadCountPerFile,
+                data.loadBufferSize,
+                dataNamePrefix,
+                largeDataPageSize,
+                file.reads,
+                file.readNames,
+                file.readRepeatCounts,
+                file.log,
+                data.readSubsampler);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            storeReadLoaderStatistics(readLoader, fileName, data.minReadLength, file.log);
+            data.files[fileId] = filePointer;
+        }
+
+
+
+        // Append the reads of all loaded files that are next in input order.
+        // Space for them is reserved under the mutex, so files are
+        // appended in input order, but the reads are copied outside the mutex,
+        // so several files can be copied at the same time while
+        // other threads keep loading files.
+        // If reserving space requires reallocating the global data structures,
+        // we must first wait for all copies in progress to complete.
+        while(true) {
+            vector<uint64_t> copyFileIds;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while(data.reservedFileCount < fileCount) {
+                    const shared_ptr<AddReadsData::File>& nextFilePointer =
+                        data.files[data.reservedFileCount];
+                    if(not nextFilePointer) {
+                        break;
+                    }
+                    AddReadsData::File& nextFile = *nextFilePointer;
+                    if(not canAppendReadsInPlace(nextFile)) {
+                        if(not copyFileIds.empty()) {
+                            // Copy the files we already have first.
+                            break;
+                        }
+                        if(data.copyingFileCount != 0) {
+                            data.condition.wait(lock);
+                            continue;
+                        }
+                    }
+                    cout << nextFile.log.str() << flush;
+
+                    // Reserve space for the reads of this file.
+                    nextFile.readBegin = reads.size();
+                    nextFile.readWordBegin = reads.totalWordCount();
+                    nextFile.readNameBegin = readNames.totalSize();
+                    nextFile.readRepeatCountBegin = readRepeatCounts.totalSize();
+                    reads.appendUninitialized(
+                        nextFile.reads.size(), nextFile.reads.totalWordCount());
+                    readNames.appendUninitializedVectors(
+                        nextFile.readNames.size(), nextFile.readNames.totalSize());
+                    readRepeatCounts.appendUninitializedVectors(
+                        nextFile.readRepeatCounts.size(), nextFile.readRepeatCounts.totalSize());
+
+                    copyFileIds.push_back(data.reservedFileCount);
+                    ++data.reservedFileCount;
+                    ++data.copyingFileCount;
+                }
+            }
+            if(copyFileIds.empty()) {
+                break;
+            }
+
+            // Copy the reads of the files we reserved space for.
+            vector<uint64_t> copiedReadCounts;
+            for(const uint64_t copyFileId: copyFileIds) {
+                AddReadsData::File& copyFile = *data.files[copyFileId];
+                copiedReadCounts.push_back(copyFile.reads.size());
+                reads.copySequences(copyFile.readBegin, copyFile.readWordBegin, copyFile.reads);
+                readNames.copyVectors(
+                    copyFile.readBegin, copyFile.readNameBegin, copyFile.readNames);
+                readRepeatCounts.copyVectors(
+                    copyFile.readBegin, copyFile.readRepeatCountBegin, copyFile.readRepeatCounts);
+                copyFile.reads.remove();
+                copyFile.readNames.remove();
+                copyFile.readRepeatCounts.remove();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for(uint64_t i=0; i<copyFileIds.size(); i++) {
+                const uint64_t copyFileId = copyFileIds[i];
+                cout << timestamp << "Appended " << copiedReadCounts[i] << " reads from " <<
+                    fileNames[copyFileId] << endl;
+                data.files[copyFileId].reset();
+            }
+            data.copyingFileCount -= copyFileIds.size();
+            data.appendedFileCount += copyFileIds.size();
+            data.condition.notify_all();
+        }
+    }
+}
+
+
+
+// Return true if space for the reads of a file can be reserved
+// without reallocating the global data structures.
+bool Assembler::canAppendReadsInPlace(const AddReadsData::File& file) const
+{
+    return
+        reads.canAppendInPlace(file.reads.size(), file.reads.totalWordCount()) and
+        readNames.canAppendInPlace(file.readNames.size(), file.readNames.totalSize()) and
+        readRepeatCounts.canAppendInPlace(
+            file.readRepeatCounts.size(), file.readRepeatCounts.totalSize());
 }
 
 
@@ -290,7 +918,7 @@ void Assembler::writeRead(ReadId readId, ostream& file)
     checkReadId(readId);
 
     const auto readSequence = reads[readId];
-    const auto readName = readNames[readId];
+    const string readName = getReadName(readId);
 
     file << ">" << readId;
     file << " " << readSequence.baseCount << " ";
@@ -335,7 +963,7 @@ void Assembler::writeOrientedRead(OrientedReadId orientedReadId, ostream& file)
     checkReadId(readId);
     const Strand strand = orientedReadId.getStrand();
     const auto readSequence = reads[readId];
-    const auto readName = readNames[readId];
+    const string readName = getReadName(readId);
 
     file << ">" << readId << "-" << strand;
     file << " " << readSequence.baseCount << " ";
@@ -385,7 +1013,8 @@ size_t Assembler::getReadRawSequenceLength(ReadId readId)
         // the repeat counts.
         // Don't use std::accumulate to compute the sum,
         // otherwise the sum is computed using uint8_t!
-        const auto& counts = readRepeatCounts[readId];
+        vector<uint8_t> counts;
+        getReadRepeatCounts(readId, counts);
         size_t sum = 0;;
         for(uint8_t count: counts) {
             sum += count;
@@ -403,7 +1032,8 @@ vector<uint32_t> Assembler::getRawPositions(OrientedReadId orientedReadId) const
 {
     const ReadId readId = orientedReadId.getReadId();
     const ReadId strand = orientedReadId.getStrand();
-    const auto repeatCounts = readRepeatCounts[readId];
+    vector<uint8_t> repeatCounts;
+    getReadRepeatCounts(readId, repeatCounts);
     const size_t n = repeatCounts.size();
 
     vector<uint32_t> v;
@@ -437,11 +1067,180 @@ void Assembler::accessReadFlags(bool readWriteAccess)
 
 
 
+// Replace readRepeatCounts with compressedReadRepeatCounts.
+void Assembler::compressReadRepeatCounts()
+{
+    checkReadsAreOpen();
+    checkReadRepeatCountsAreNotCompressed();
+
+    compressedReadRepeatCounts.createNew(
+        largeDataName("CompressedReadRepeatCounts"), largeDataPageSize);
+    compressedReadRepeatCounts.create(readRepeatCounts);
+    SHASTA_ASSERT(compressedReadRepeatCounts.totalSize() == readRepeatCounts.totalSize());
+
+    cout << "Read repeat counts were compressed from " <<
+        readRepeatCounts.totalSize() << " to " <<
+        compressedReadRepeatCounts.byteCount() << " bytes." << endl;
+
+    readRepeatCounts.remove();
+}
+
+
+
+// Get all the repeat counts of a read, as stored (that is, for strand 0).
+void Assembler::getReadRepeatCounts(ReadId readId, vector<uint8_t>& repeatCounts) const
+{
+    if(readRepeatCounts.isOpen()) {
+        repeatCounts.assign(readRepeatCounts.begin(readId), readRepeatCounts.end(readId));
+    } else {
+        compressedReadRepeatCounts.get(readId, repeatCounts);
+    }
+}
+
+
+
+uint64_t Assembler::getReadRepeatCountsTotalSize() const
+{
+    if(readRepeatCounts.isOpen()) {
+        return readRepeatCounts.totalSize();
+    } else {
+        return compressedReadRepeatCounts.totalSize();
+    }
+}
+
+
+
+// Keep only a subset of the reads with total number of raw bases
+// close to targetCoverage * genomeSize. See Assembler.hpp for details.
+void Assembler::subsampleReads(
+    double targetCoverage,
+    uint64_t genomeSize,
+    const string& method)
+{
+    checkReadsAreOpen();
+    checkReadNamesAreOpen();
+    checkReadRepeatCountsAreNotCompressed();
+    checkReadNamesAreNotCompressed();
+
+    // Pass the name and raw length of each read to a ReadSubsampler.
+    ReadSubsampler readSubsampler(targetCoverage, genomeSize, method);
+    for(ReadId readId=0; readId!=reads.size(); readId++) {
+        uint64_t length = 0;
+        for(const uint8_t repeatCount: readRepeatCounts[readId]) {
+            length += repeatCount;
+        }
+        readSubsampler.select(readNames.begin(readId), readNames.end(readId), length);
+    }
+
+    removeUnselectedReads(readSubsampler, 0);
+}
+
+
+
+// Remove the reads, beginning at firstReadId,
+// that are not in the final selection of a ReadSubsampler.
+// This only looks at read names and raw read lengths.
+void Assembler::removeUnselectedReads(
+    const ReadSubsampler& readSubsampler,
+    ReadId firstReadId)
+{
+    const uint64_t totalBaseCount = readSubsampler.totalBaseCount;
+    const uint64_t targetBaseCount = readSubsampler.targetBaseCount;
+    cout << "Read subsampling: the reads contain " << totalBaseCount <<
+        " bases, and the target is " << targetBaseCount << " bases." << endl;
+    if(totalBaseCount <= targetBaseCount) {
+        cout << "All reads will be used." << endl;
+        return;
+    }
+
+    const ReadId readCount = ReadId(reads.size());
+    vector<bool> keep(readCount, true);
+    uint64_t keptReadCount = 0;
+    uint64_t keptBaseCount = 0;
+    for(ReadId readId=firstReadId; readId!=readCount; readId++) {
+        uint64_t length = 0;
+        for(const uint8_t repeatCount: readRepeatCounts[readId]) {
+            length += repeatCount;
+        }
+        if(readSubsampler.isSelected(readNames.begin(readId), readNames.end(readId), length)) {
+            ++keptReadCount;
+            keptBaseCount += length;
+        } else {
+            keep[readId] = false;
+        }
+    }
+
+    // Remove the reads that are not in the final selection.
+    if(keptReadCount != readCount - firstReadId) {
+        reads.keepSequences(keep);
+        readNames.keepVectors(keep);
+        readRepeatCounts.keepVectors(keep);
+    }
+
+    cout << "Kept " << keptReadCount << " reads with " << keptBaseCount <<
+        " bases for an estimated coverage of " <<
+        double(keptBaseCount) / double(readSubsampler.genomeSize) << "." << endl;
+    cout << "Removed " << readSubsampler.totalReadCount - keptReadCount << " reads with " <<
+        totalBaseCount - keptBaseCount << " bases." << endl;
+}
+
+
+
+// Replace readNames with compressedReadNames.
+void Assembler::compressReadNames()
+{
+    checkReadNamesAreOpen();
+    checkReadNamesAreNotCompressed();
+
+    compressedReadNames.createNew(largeDataName("CompressedReadNames"), largeDataPageSize);
+    compressedReadNames.create(readNames);
+    SHASTA_ASSERT(compressedReadNames.size() == readNames.size());
+
+    cout << "Read names were compressed from " <<
+        readNames.totalSize() + readNames.size() * sizeof(uint64_t) << " to " <<
+        compressedReadNames.byteCount() << " bytes." << endl;
+
+    readNames.remove();
+}
+
+
+
+string Assembler::getReadName(ReadId readId) const
+{
+    if(readNames.isOpen()) {
+        return string(readNames.begin(readId), readNames.end(readId));
+    } else {
+        return compressedReadNames.get(readId);
+    }
+}
+
+
+
+// Return the ReadId of the read with the given name,
+// or invalidReadId if there is no such read.
+ReadId Assembler::getReadId(const string& readName) const
+{
+    if(readNames.isOpen()) {
+        for(ReadId readId=0; readId!=readNames.size(); readId++) {
+            const auto name = readNames[readId];
+            if(name.size() == readName.size() and
+                std::equal(name.begin(), name.end(), readName.begin())) {
+                return readId;
+            }
+        }
+        return invalidReadId;
+    } else {
+        return compressedReadNames.getReadId(readName);
+    }
+}
+
+
+
 // Write a csv file with summary information for each read.
 void Assembler::writeReadsSummary()
 {
     SHASTA_ASSERT(reads.isOpen());
-    SHASTA_ASSERT(readNames.isOpen());
+    checkReadNamesAreOpen();
     SHASTA_ASSERT(markers.isOpen());
 
     // Count the number of alignment candidates for each read.
@@ -458,6 +1257,7 @@ void Assembler::writeReadsSummary()
         "Palindromic,Chimeric,"
         "AlignmentCandidates,ReadGraphNeighbors,"
         "VertexCount,VertexDensity,\n";
+    vector<uint8_t> repeatCounts;
     for(ReadId readId=0; readId!=reads.size(); readId++) {
         const OrientedReadId orientedReadId(readId, 0);
 
@@ -465,12 +1265,12 @@ void Assembler::writeReadsSummary()
         csv << readId << ",";
 
         // Read name.
-        const auto readName = readNames[readId];
+        const string readName = getReadName(readId);
         copy(readName.begin(), readName.end(), ostream_iterator<char>(csv));
         csv << ",";
 
         // Number of raw bases.
-        const auto repeatCounts = readRepeatCounts[readId];
+        getReadRepeatCounts(readId, repeatCounts);
         uint64_t rawBaseCount = 0;
         for(const auto repeatCount: repeatCounts) {
             rawBaseCount += repeatCount;
@@ -0,0 +1,260 @@
+#ifndef SHASTA_BUCKET_FILLER_HPP
+#define SHASTA_BUCKET_FILLER_HPP
+
+/*******************************************************************************
+
+Class BucketFiller fills the buckets used by the LowHash algorithms,
+stored in a MemoryMapped::VectorOfVectors indexed by bucket id.
+
+Filling the buckets directly with the usual two pass count/store
+procedure scatters the entries randomly into a large number of buckets.
+With billions of low hash features this is dominated by cache and TLB
+misses, and it does not scale well with the number of threads.
+
+Instead, BucketFiller uses a two level radix partitioning.
+The buckets are grouped into partitions, each consisting of a
+contiguous range of bucket ids, selected by the most significant
+bits of the bucket id.
+
+- Level 1: each thread appends entries to small thread-local buffers,
+  one per partition. When a buffer fills up, it is flushed as a block
+  of contiguous entries into a staging area where all the entries
+  of each partition are stored contiguously.
+  The staging area is written sequentially within each partition.
+- Level 2: each partition is handled by a single thread,
+  which counts and then stores its entries into the buckets.
+  The buckets and data touched by a partition are a contiguous
+  and much smaller range of memory, and no atomic operations are needed.
+
+Usage pattern, with the caller being a MultithreadedObject:
+
+    BucketFiller<Entry> bucketFiller(log2BucketCount, threadCount, ...);
+
+    // For each group of buckets to be created:
+    bucketFiller.beginCount();
+    // In each thread of the caller:
+        bucketFiller.count(threadId, bucketId);
+    bucketFiller.beginStore();
+    // In each thread of the caller:
+        bucketFiller.store(threadId, bucketId, entry);
+        ...
+        bucketFiller.flush(threadId);    // At the end of the thread function.
+    bucketFiller.fill(buckets);
+
+The order of the entries in each bucket is not defined.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MemoryMappedVector.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "MultithreadedObject.hpp"
+#include "SHASTA_ASSERT.hpp"
+
+// Standard library.
+#include "algorithm.hpp"
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    template<class Entry> class BucketFiller;
+}
+
+
+
+template<class Entry> class shasta::BucketFiller :
+    public MultithreadedObject< BucketFiller<Entry> > {
+public:
+
+    BucketFiller(
+        uint64_t log2BucketCount,
+        size_t threadCount,
+        const string& stagedEntriesName,
+        size_t pageSize) :
+        MultithreadedObject< BucketFiller<Entry> >(*this),
+        log2BucketCount(log2BucketCount),
+        log2PartitionCount(min(log2BucketCount, uint64_t(maxLog2PartitionCount))),
+        partitionCount(1ULL << log2PartitionCount),
+        partitionShift(log2BucketCount - log2PartitionCount),
+        bucketOffsetMask((1ULL << partitionShift) - 1ULL),
+        threadCount(threadCount),
+        threadPartitionCounts(threadCount, vector<uint64_t>(partitionCount)),
+        threadBuffers(threadCount),
+        partitionBegin(partitionCount + 1),
+        partitionCursor(partitionCount)
+    {
+        // The offset of a bucket in its partition is stored as a 32 bit integer.
+        SHASTA_ASSERT(partitionShift <= 32);
+        stagedEntries.createNew(stagedEntriesName, pageSize);
+    }
+
+    ~BucketFiller()
+    {
+        if(stagedEntries.isOpen) {
+            stagedEntries.remove();
+        }
+    }
+
+    // Counting phase.
+    void beginCount()
+    {
+        for(vector<uint64_t>& counts: threadPartitionCounts) {
+            std::fill(counts.begin(), counts.end(), 0);
+        }
+    }
+    void count(size_t threadId, uint64_t bucketId)
+    {
+        ++threadPartitionCounts[threadId][bucketId >> partitionShift];
+    }
+
+
+
+    // Storing phase.
+    void beginStore()
+    {
+        partitionBegin[0] = 0;
+        for(uint64_t partition=0; partition<partitionCount; partition++) {
+            uint64_t n = 0;
+            for(const vector<uint64_t>& counts: threadPartitionCounts) {
+                n += counts[partition];
+            }
+            partitionBegin[partition + 1] = partitionBegin[partition] + n;
+            partitionCursor[partition] = partitionBegin[partition];
+        }
+        stagedEntries.resize(partitionBegin.back());
+
+        for(ThreadBuffer& threadBuffer: threadBuffers) {
+            threadBuffer.entries.resize(partitionCount * entriesPerBlock);
+            threadBuffer.sizes.resize(partitionCount);
+            std::fill(threadBuffer.sizes.begin(), threadBuffer.sizes.end(), 0);
+        }
+    }
+    void store(size_t threadId, uint64_t bucketId, const Entry& entry)
+    {
+        ThreadBuffer& threadBuffer = threadBuffers[threadId];
+        const uint64_t partition = bucketId >> partitionShift;
+        uint64_t& size = threadBuffer.sizes[partition];
+        StagedEntry& stagedEntry = threadBuffer.entries[partition * entriesPerBlock + size];
+        stagedEntry.bucketOffset = uint32_t(bucketId & bucketOffsetMask);
+        stagedEntry.entry = entry;
+        if(++size == entriesPerBlock) {
+            flushBlock(threadBuffer, partition);
+        }
+    }
+    void flush(size_t threadId)
+    {
+        ThreadBuffer& threadBuffer = threadBuffers[threadId];
+        for(uint64_t partition=0; partition<partitionCount; partition++) {
+            if(threadBuffer.sizes[partition] > 0) {
+                flushBlock(threadBuffer, partition);
+            }
+        }
+    }
+
+
+
+    // Use the staged entries to fill the buckets,
+    // which must have been created by the caller.
+    void fill(MemoryMapped::VectorOfVectors<Entry, uint64_t>& buckets)
+    {
+        for(uint64_t partition=0; partition<partitionCount; partition++) {
+            SHASTA_ASSERT(partitionCursor[partition] == partitionBegin[partition + 1]);
+        }
+        bucketsPointer = &buckets;
+
+        buckets.clear();
+        buckets.beginPass1(1ULL << log2BucketCount);
+        this->setupLoadBalancing(partitionCount, 1);
+        this->runThreads(&BucketFiller::countThreadFunction, threadCount);
+        buckets.beginPass2();
+        this->setupLoadBalancing(partitionCount, 1);
+        this->runThreads(&BucketFiller::storeThreadFunction, threadCount);
+        buckets.endPass2(false, false);
+    }
+
+private:
+
+    // A staged entry consists of the offset of its bucket
+    // in its partition and the entry to be stored in that bucket.
+    class StagedEntry {
+    public:
+        uint32_t bucketOffset;
+        Entry entry;
+    };
+
+    // The number of partitions is chosen so the thread-local buffers
+    // of a thread fit in a typical L2 cache. Each thread-local buffer
+    // holds a block of entries spanning a few cache lines.
+    static const uint64_t maxLog2PartitionCount = 10;
+    static const uint64_t entriesPerBlock = 16;
+
+    uint64_t log2BucketCount;
+    uint64_t log2PartitionCount;
+    uint64_t partitionCount;
+    uint64_t partitionShift;
+    uint64_t bucketOffsetMask;
+    size_t threadCount;
+
+    // The number of entries in each partition, for each thread.
+    vector< vector<uint64_t> > threadPartitionCounts;
+
+    // The thread-local buffers: one block of entriesPerBlock entries
+    // for each partition, and the number of entries in each block.
+    class ThreadBuffer {
+    public:
+        vector<StagedEntry> entries;
+        vector<uint64_t> sizes;
+    };
+    vector<ThreadBuffer> threadBuffers;
+
+    // The staged entries, grouped by partition.
+    // The entries of a partition begin at partitionBegin[partition],
+    // and partitionCursor[partition] is the position where
+    // the next block of that partition will be stored.
+    MemoryMapped::Vector<StagedEntry> stagedEntries;
+    vector<uint64_t> partitionBegin;
+    vector<uint64_t> partitionCursor;
+
+    void flushBlock(ThreadBuffer& threadBuffer, uint64_t partition)
+    {
+        uint64_t& size = threadBuffer.sizes[partition];
+        const uint64_t position = __sync_fetch_and_add(&partitionCursor[partition], size);
+        SHASTA_ASSERT(position + size <= partitionBegin[partition + 1]);
+        const StagedEntry* blockBegin = threadBuffer.entries.data() + partition * entriesPerBlock;
+        copy(blockBegin, blockBegin + size, stagedEntries.begin() + position);
+        size = 0;
+    }
+
+    // Level 2 thread functions. Each partition is processed by one thread.
+    MemoryMapped::VectorOfVectors<Entry, uint64_t>* bucketsPointer = 0;
+    void countThreadFunction(size_t threadId)
+    {
+        MemoryMapped::VectorOfVectors<Entry, uint64_t>& buckets = *bucketsPointer;
+        uint64_t begin, end;
+        while(this->getNextBatch(begin, end)) {
+            for(uint64_t partition=begin; partition!=end; partition++) {
+                const uint64_t firstBucketId = partition << partitionShift;
+                for(uint64_t i=partitionBegin[partition]; i!=partitionBegin[partition+1]; i++) {
+                    buckets.incrementCount(firstBucketId + stagedEntries[i].bucketOffset);
+                }
+            }
+        }
+    }
+    void storeThreadFunction(size_t threadId)
+    {
+        MemoryMapped::VectorOfVectors<Entry, uint64_t>& buckets = *bucketsPointer;
+        uint64_t begin, end;
+        while(this->getNextBatch(begin, end)) {
+            for(uint64_t partition=begin; partition!=end; partition++) {
+                const uint64_t firstBucketId = partition << partitionShift;
+                for(uint64_t i=partitionBegin[partition]; i!=partitionBegin[partition+1]; i++) {
+                    const StagedEntry& stagedEntry = stagedEntries[i];
+                    buckets.store(firstBucketId + stagedEntry.bucketOffset, stagedEntry.entry);
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "CompressedReadNames.hpp"
+#include "MurmurHash2.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "iostream.hpp"
+#include <random>
+
+
+
+void CompressedReadNames::createNew(const string& name, size_t pageSize)
+{
+    if(name.empty()) {
+        blockBegin.createNew("", pageSize);
+        data.createNew("", pageSize);
+        hashTable.createNew("", pageSize);
+    } else {
+        blockBegin.createNew(name + "-BlockBegin", pageSize);
+        data.createNew(name + "-Data", pageSize);
+        hashTable.createNew(name + "-HashTable", pageSize);
+    }
+    readCount = 0;
+}
+
+
+
+void CompressedReadNames::accessExistingReadOnly(const string& name)
+{
+    blockBegin.accessExistingReadOnly(name + "-BlockBegin");
+    data.accessExistingReadOnly(name + "-Data");
+    hashTable.accessExistingReadOnly(name + "-HashTable");
+    computeReadCount();
+}
+
+
+
+void CompressedReadNames::remove()
+{
+    blockBegin.remove();
+    data.remove();
+    hashTable.remove();
+    readCount = 0;
+}
+
+
+
+// Create from the uncompressed representation.
+void CompressedReadNames::create(const MemoryMapped::VectorOfVectors<char, uint64_t>& readNames)
+{
+    SHASTA_ASSERT(readNames.size() < invalidReadId);
+    readCount = ReadId(readNames.size());
+
+    string previousName;
+    blockBegin.reserve((readCount + namesPerBlock - 1) / namesPerBlock);
+    for(ReadId readId=0; readId!=readCount; readId++) {
+        if((readId % namesPerBlock) == 0) {
+            blockBegin.push_back(data.size());
+            previousName.clear();
+        }
+        const char* begin = readNames.begin(readId);
+        const char* end = readNames.end(readId);
+        append(begin, end, previousName);
+        previousName.assign(begin, end);
+    }
+    blockBegin.unreserve();
+    data.unreserve();
+
+    createHashTable(readNames);
+}
+
+
+
+// Encode a name and append it to data.
+void CompressedReadNames::append(
+    const char* begin,
+    const char* end,
+    const string& previousName)
+{
+    // Names that are UUIDs are stored as 16 bytes.
+    if(isUuid(begin, end)) {
+        data.push_back(uint8_t(uuidFlag));
+        uint8_t byte = 0;
+        uint64_t digitCount = 0;
+        for(const char* it=begin; it!=end; ++it) {
+            const char c = *it;
+            if(c == '-') {
+                continue;
+            }
+            const uint8_t digit = uint8_t((c <= '9') ? (c - '0') : (c - 'a' + 10));
+            byte = uint8_t((byte << 4) | digit);
+            if((++digitCount % 2) == 0) {
+                data.push_back(byte);
+                byte = 0;
+            }
+        }
+        return;
+    }
+
+    // Find the length of the prefix shared with the previous name.
+    const uint64_t length = uint64_t(end - begin);
+    const uint64_t maxLength = min(uint64_t(maxPrefixLength), min(length, uint64_t(previousName.size())));
+    uint64_t prefixLength = 0;
+    while(prefixLength < maxLength and begin[prefixLength] == previousName[prefixLength]) {
+        ++prefixLength;
+    }
+    data.push_back(uint8_t(prefixLength));
+
+    // Store the suffix length, 7 bits per byte.
+    uint64_t suffixLength = length - prefixLength;
+    while(suffixLength >= 128) {
+        data.push_back(uint8_t((suffixLength & 127) | 128));
+        suffixLength >>= 7;
+    }
+    data.push_back(uint8_t(suffixLength));
+
+    // Store the suffix.
+    for(const char* it=begin+prefixLength; it!=end; ++it) {
+        data.push_back(uint8_t(*it));
+    }
+}
+
+
+
+// Decode the record beginning at a given offset, updating the name.
+// Returns the offset of the next record.
+uint64_t CompressedReadNames::decode(uint64_t offset, string& name) const
+{
+    const uint8_t firstByte = data[offset++];
+
+    if(firstByte == uuidFlag) {
+        static const char hexDigits[] = "0123456789abcdef";
+        name.clear();
+        for(uint64_t i=0; i<16; i++) {
+            if(i==4 or i==6 or i==8 or i==10) {
+                name.push_back('-');
+            }
+            const uint8_t byte = data[offset++];
+            name.push_back(hexDigits[byte >> 4]);
+            name.push_back(hexDigits[byte & 15]);
+        }
+        return offset;
+    }
+
+    const uint64_t prefixLength = firstByte;
+    uint64_t suffixLength = 0;
+    for(uint64_t shift=0; ; shift+=7) {
+        const uint8_t byte = data[offset++];
+        suffixLength |= uint64_t(byte & 127) << shift;
+        if((byte & 128) == 0) {
+            break;
+        }
+    }
+    name.resize(prefixLength);
+    const uint8_t* suffix = data.begin() + offset;
+    name.append(suffix, suffix + suffixLength);
+    return offset + suffixLength;
+}
+
+
+
+// Decode the name of a read.
+string CompressedReadNames::get(ReadId readId) const
+{
+    SHASTA_ASSERT(readId < readCount);
+    string name;
+    uint64_t offset = blockBegin[readId / namesPerBlock];
+    for(ReadId i=readId-(readId%namesPerBlock); i<=readId; i++) {
+        offset = decode(offset, name);
+    }
+    return name;
+}
+
+
+
+void CompressedReadNames::computeReadCount()
+{
+    if(blockBegin.size() == 0) {
+        readCount = 0;
+        return;
+    }
+    const uint64_t lastBlock = blockBegin.size() - 1;
+    uint64_t count = lastBlock * namesPerBlock;
+    string name;
+    for(uint64_t offset=blockBegin[lastBlock]; offset!=data.size(); ++count) {
+        offset = decode(offset, name);
+    }
+    readCount = ReadId(count);
+}
+
+
+
+bool CompressedReadNames::isUuid(const char* begin, const char* end)
+{
+    if(uint64_t(end - begin) != uuidLength) {
+        return false;
+    }
+    for(uint64_t i=0; i<uuidLength; i++) {
+        const char c = begin[i];
+        if(i==8 or i==13 or i==18 or i==23) {
+            if(c != '-') {
+                return false;
+            }
+        } else {
+            if(not ((c>='0' and c<='9') or (c>='a' and c<='f'))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+
+uint64_t CompressedReadNames::hash(const char* begin, const char* end)
+{
+    return MurmurHash64A(begin, int(end - begin), 1241);
+}
+
+
+
+void CompressedReadNames::createHashTable(
+    const MemoryMapped::VectorOfVectors<char, uint64_t>& readNames)
+{
+    // Use a power of 2 at least 4/3 of the number of reads,
+    // which keeps the load factor at most 0.75.
+    uint64_t tableSize = 2;
+    while(3 * tableSize < 4 * uint64_t(readCount)) {
+        tableSize *= 2;
+    }
+    const uint64_t mask = tableSize - 1;
+    hashTable.resize(tableSize);
+    fill(hashTable.begin(), hashTable.end(), invalidReadId);
+
+    // Insert in order of increasing ReadId, so a lookup
+    // finds the lowest ReadId for duplicate names.
+    for(ReadId readId=0; readId!=readCount; readId++) {
+        uint64_t slot = hash(readNames.begin(readId), readNames.end(readId)) & mask;
+        while(hashTable[slot] != invalidReadId) {
+            slot = (slot + 1) & mask;
+        }
+        hashTable[slot] = readId;
+    }
+}
+
+
+
+// Return the ReadId of the read with a given name,
+// or invalidReadId if there is no read with that name.
+ReadId CompressedReadNames::getReadId(const string& name) const
+{
+    if(hashTable.size() == 0) {
+        return invalidReadId;
+    }
+    const uint64_t mask = hashTable.size() - 1;
+    for(uint64_t slot = hash(name.data(), name.data() + name.size()) & mask; ;
+        slot = (slot + 1) & mask) {
+        const ReadId readId = hashTable[slot];
+        if(readId == invalidReadId) {
+            return invalidReadId;
+        }
+        if(get(readId) == name) {
+            return readId;
+        }
+    }
+}
+
+
+
+uint64_t CompressedReadNames::byteCount() const
+{
+    return
+        blockBegin.size() * sizeof(uint64_t) +
+        data.size() * sizeof(uint8_t) +
+        hashTable.size() * sizeof(ReadId);
+}
+
+
+
+void shasta::testCompressedReadNames()
+{
+    std::mt19937 randomSource(231);
+    std::uniform_int_distribution<int> hexDistribution(0, 15);
+    std::uniform_int_distribution<int> lengthDistribution(1, 300);
+    const string hexDigits = "0123456789abcdef";
+
+    // Generate a mix of UUIDs, names with shared prefixes,
+    // and names that almost look like UUIDs.
+    const ReadId readCount = 10000;
+    MemoryMapped::VectorOfVectors<char, uint64_t> readNames;
+    readNames.createNew("", 4096);
+    for(ReadId readId=0; readId<readCount; readId++) {
+        string name;
+        switch(readId % 4) {
+        case 0:
+        case 1:
+            for(uint64_t i=0; i<36; i++) {
+                name.push_back((i==8 or i==13 or i==18 or i==23) ?
+                    '-' : hexDigits[hexDistribution(randomSource)]);
+            }
+            if(readId % 4 == 1) {
+                name[3] = 'A';
+            }
+            break;
+        case 2:
+            name = "run1_read_" + to_string(readId);
+            break;
+        case 3:
+            name = string(size_t(lengthDistribution(randomSource)), 'x') + to_string(readId / 8);
+            break;
+        }
+        readNames.appendVector(name.begin(), name.end());
+    }
+
+    CompressedReadNames compressedReadNames;
+    compressedReadNames.createNew("", 4096);
+    compressedReadNames.create(readNames);
+    SHASTA_ASSERT(compressedReadNames.size() == readCount);
+
+    // Check decoding and lookup by name.
+    for(ReadId readId=0; readId<readCount; readId++) {
+        const string name(readNames.begin(readId), readNames.end(readId));
+        SHASTA_ASSERT(compressedReadNames.get(readId) == name);
+        const ReadId foundReadId = compressedReadNames.getReadId(name);
+        SHASTA_ASSERT(foundReadId <= readId);
+        SHASTA_ASSERT(compressedReadNames.get(foundReadId) == name);
+    }
+    SHASTA_ASSERT(compressedReadNames.getReadId("") == invalidReadId);
+    SHASTA_ASSERT(compressedReadNames.getReadId("run1_read_3") == invalidReadId);
+
+    // Check that the number of reads is recomputed correctly.
+    const ReadId savedReadCount = compressedReadNames.readCount;
+    compressedReadNames.computeReadCount();
+    SHASTA_ASSERT(compressedReadNames.readCount == savedReadCount);
+
+    cout << "Compressed " << readNames.totalSize() + readNames.size() * sizeof(uint64_t) <<
+        " bytes of read names to " << compressedReadNames.byteCount() << " bytes." << endl;
+
+    compressedReadNames.remove();
+    readNames.remove();
+}
@@ -0,0 +1,118 @@
+#ifndef SHASTA_COMPRESSED_READ_NAMES_HPP
+#define SHASTA_COMPRESSED_READ_NAMES_HPP
+
+/*******************************************************************************
+
+Class CompressedReadNames stores the names of all reads
+in a compact form that is decoded on demand.
+
+Read names are stored in blocks of 16 consecutive reads.
+Within a block, each name is front coded: it is stored as
+the length of the prefix it shares with the previous name
+in the block, followed by the remaining suffix.
+The first name of each block is stored in full, so decoding
+a name requires decoding at most 16 records.
+
+Oxford Nanopore read names are UUIDs
+(36 lower case hexadecimal characters and dashes),
+which don't share prefixes with each other. These are recognized
+and stored as 16 bytes of binary data.
+
+Each record begins with a byte that gives the length
+of the shared prefix (at most 254 characters),
+or uuidFlag for a name stored as a binary UUID.
+For names not stored as UUIDs, this is followed by
+the length of the suffix (variable length encoded,
+7 bits per byte) and by the suffix characters.
+
+A hash table allows finding the ReadId corresponding
+to a given read name in constant time.
+If more than one read has the same name, the lowest ReadId
+is returned.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MemoryMappedVector.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "ReadId.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+
+namespace shasta {
+    class CompressedReadNames;
+    void testCompressedReadNames();
+}
+
+
+
+class shasta::CompressedReadNames {
+public:
+
+    void createNew(const string& name, size_t pageSize);
+    void accessExistingReadOnly(const string& name);
+    void remove();
+    bool isOpen() const
+    {
+        return blockBegin.isOpen && data.isOpen && hashTable.isOpen;
+    }
+
+    // Create from the uncompressed representation.
+    void create(const MemoryMapped::VectorOfVectors<char, uint64_t>&);
+
+    // The number of reads.
+    ReadId size() const
+    {
+        return readCount;
+    }
+
+    // Decode the name of a read.
+    string get(ReadId) const;
+
+    // Return the ReadId of the read with a given name,
+    // or invalidReadId if there is no read with that name.
+    ReadId getReadId(const string& name) const;
+
+    // The number of bytes used.
+    uint64_t byteCount() const;
+
+private:
+
+    // The offset in data of the first record of each block.
+    MemoryMapped::Vector<uint64_t> blockBegin;
+
+    // The encoded names.
+    MemoryMapped::Vector<uint8_t> data;
+
+    // Open addressing hash table with linear probing,
+    // containing ReadIds, or invalidReadId for empty slots.
+    // Its size is a power of 2.
+    MemoryMapped::Vector<ReadId> hashTable;
+
+    // This is not stored. It is computed when accessing
+    // existing data by counting the records in the last block.
+    ReadId readCount = 0;
+    void computeReadCount();
+
+    static const ReadId namesPerBlock = 16;
+    static const uint8_t uuidFlag = 255;
+    static const uint64_t maxPrefixLength = 254;
+    static const uint64_t uuidLength = 36;
+
+    // Encode a name and append it to data.
+    void append(const char* begin, const char* end, const string& previousName);
+
+    // Decode the record beginning at a given offset, updating the name.
+    // Returns the offset of the next record.
+    uint64_t decode(uint64_t offset, string& name) const;
+
+    static bool isUuid(const char* begin, const char* end);
+    static uint64_t hash(const char* begin, const char* end);
+    void createHashTable(const MemoryMapped::VectorOfVectors<char, uint64_t>&);
+
+    friend void shasta::testCompressedReadNames();
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "CompressedRepeatCounts.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "iostream.hpp"
+#include <random>
+
+
+
+void CompressedRepeatCounts::createNew(const string& name, size_t pageSize)
+{
+    if(name.empty()) {
+        toc.createNew("", pageSize);
+        codes.createNew("", pageSize);
+        blockEscapeBegin.createNew("", pageSize);
+        escapes.createNew("", pageSize);
+    } else {
+        toc.createNew(name + "-Toc", pageSize);
+        codes.createNew(name + "-Codes", pageSize);
+        blockEscapeBegin.createNew(name + "-BlockEscapeBegin", pageSize);
+        escapes.createNew(name + "-Escapes", pageSize);
+    }
+    toc.push_back(0);
+}
+
+
+
+void CompressedRepeatCounts::accessExistingReadOnly(const string& name)
+{
+    toc.accessExistingReadOnly(name + "-Toc");
+    codes.accessExistingReadOnly(name + "-Codes");
+    blockEscapeBegin.accessExistingReadOnly(name + "-BlockEscapeBegin");
+    escapes.accessExistingReadOnly(name + "-Escapes");
+}
+
+
+
+void CompressedRepeatCounts::remove()
+{
+    toc.remove();
+    codes.remove();
+    blockEscapeBegin.remove();
+    escapes.remove();
+}
+
+
+
+// Append the repeat counts of a read.
+void CompressedRepeatCounts::append(const uint8_t* begin, const uint8_t* end)
+{
+    uint64_t i = toc.back();
+    for(const uint8_t* it=begin; it!=end; ++it, ++i) {
+        const uint8_t repeatCount = *it;
+        SHASTA_ASSERT(repeatCount > 0);
+
+        // Start a new word and, if necessary, a new block.
+        if((i % codesPerWord) == 0) {
+            codes.push_back(0);
+        }
+        if((i % codesPerBlock) == 0) {
+            blockEscapeBegin.push_back(escapes.size());
+        }
+
+        // Store the code and, if necessary, the escape.
+        uint64_t code = uint64_t(repeatCount) - 1;
+        if(code >= escapeCode) {
+            code = escapeCode;
+            escapes.push_back(repeatCount);
+        }
+        codes.back() |= code << (2 * (i % codesPerWord));
+    }
+    toc.push_back(i);
+}
+
+
+
+// Create from the uncompressed representation.
+void CompressedRepeatCounts::create(
+    const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& repeatCounts)
+{
+    const uint64_t readCount = repeatCounts.size();
+    toc.reserve(readCount + 1);
+    codes.reserve((repeatCounts.totalSize() + codesPerWord - 1) / codesPerWord);
+    blockEscapeBegin.reserve((repeatCounts.totalSize() + codesPerBlock - 1) / codesPerBlock);
+    for(uint64_t readId=0; readId<readCount; readId++) {
+        append(repeatCounts.begin(readId), repeatCounts.end(readId));
+    }
+    toc.unreserve();
+    codes.unreserve();
+    blockEscapeBegin.unreserve();
+    escapes.unreserve();
+}
+
+
+
+// Decode all the repeat counts of a read.
+void CompressedRepeatCounts::get(uint64_t readId, vector<uint8_t>& repeatCounts) const
+{
+    const uint64_t begin = toc[readId];
+    const uint64_t end = toc[readId + 1];
+    repeatCounts.resize(end - begin);
+    if(begin == end) {
+        return;
+    }
+
+    // Locate the first escape, then decode sequentially.
+    uint64_t escapeIndex = blockEscapeBegin[begin / codesPerBlock];
+    const uint64_t wordIndex = begin / codesPerWord;
+    for(uint64_t j=wordIndex-(wordIndex%wordsPerBlock); j!=wordIndex; j++) {
+        escapeIndex += uint64_t(__builtin_popcountll(escapeBits(codes[j])));
+    }
+    const uint64_t mask = (1ULL << (2 * (begin % codesPerWord))) - 1ULL;
+    escapeIndex += uint64_t(__builtin_popcountll(escapeBits(codes[wordIndex]) & mask));
+
+    for(uint64_t i=begin; i!=end; i++) {
+        const uint64_t code = (codes[i / codesPerWord] >> (2 * (i % codesPerWord))) & 3ULL;
+        if(code == escapeCode) {
+            repeatCounts[i - begin] = escapes[escapeIndex++];
+        } else {
+            repeatCounts[i - begin] = uint8_t(code + 1);
+        }
+    }
+}
+
+
+
+uint64_t CompressedRepeatCounts::byteCount() const
+{
+    return
+        toc.size() * sizeof(uint64_t) +
+        codes.size() * sizeof(uint64_t) +
+        blockEscapeBegin.size() * sizeof(uint64_t) +
+        escapes.size() * sizeof(uint8_t);
+}
+
+
+
+void shasta::testCompressedRepeatCounts()
+{
+    std::mt19937 randomSource(231);
+    std::geometric_distribution<int> distribution(0.6);
+
+    // Generate random repeat counts for some reads.
+    const uint64_t readCount = 1000;
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t> repeatCounts;
+    repeatCounts.createNew("", 4096);
+    for(uint64_t readId=0; readId<readCount; readId++) {
+        const uint64_t n = std::uniform_int_distribution<uint64_t>(0, 2000)(randomSource);
+        repeatCounts.appendVector(n);
+        for(uint64_t i=0; i<n; i++) {
+            repeatCounts.begin(readId)[i] = uint8_t(1 + min(254, distribution(randomSource)));
+        }
+    }
+
+    // Compress them.
+    CompressedRepeatCounts compressedRepeatCounts;
+    compressedRepeatCounts.createNew("", 4096);
+    compressedRepeatCounts.create(repeatCounts);
+    SHASTA_ASSERT(compressedRepeatCounts.size() == readCount);
+    SHASTA_ASSERT(compressedRepeatCounts.totalSize() == repeatCounts.totalSize());
+
+    // Check random access and decoding of entire reads.
+    vector<uint8_t> decoded;
+    for(uint64_t readId=0; readId<readCount; readId++) {
+        const uint64_t n = repeatCounts.size(readId);
+        SHASTA_ASSERT(compressedRepeatCounts.size(readId) == n);
+        for(uint64_t i=0; i<n; i++) {
+            SHASTA_ASSERT(compressedRepeatCounts.get(readId, i) == repeatCounts.begin(readId)[i]);
+        }
+        compressedRepeatCounts.get(readId, decoded);
+        SHASTA_ASSERT(std::equal(decoded.begin(), decoded.end(), repeatCounts.begin(readId)));
+    }
+
+    cout << "Compressed " << repeatCounts.totalSize() << " repeat counts to " <<
+        compressedRepeatCounts.byteCount() << " bytes." << endl;
+
+    compressedRepeatCounts.remove();
+    repeatCounts.remove();
+}
@@ -0,0 +1,140 @@
+#ifndef SHASTA_COMPRESSED_REPEAT_COUNTS_HPP
+#define SHASTA_COMPRESSED_REPEAT_COUNTS_HPP
+
+/*******************************************************************************
+
+Class CompressedRepeatCounts stores the base repeat counts
+of the run-length representation of all reads using
+about 2.5 bits per run-length base instead of 8.
+
+Almost all repeat counts are 1, 2, or 3. Each repeat count is stored
+as a 2-bit code, 32 codes per 64-bit word:
+- Codes 0, 1, 2 represent repeat counts 1, 2, 3.
+- Code 3 is an escape: the repeat count is stored as a
+  byte in a separate escape vector.
+
+To allow random access to individual repeat counts,
+the codes are grouped in blocks of 256 codes (8 words),
+and for each block we store the number of escapes in all
+previous blocks. To locate the escape for a given position
+we then only need to count the escapes preceding it in its block,
+which takes at most 8 population counts.
+
+Positions are global, and the table of contents gives
+the global position of the first repeat count of each read.
+
+*******************************************************************************/
+
+// Shasta.
+#include "MemoryMappedVector.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class CompressedRepeatCounts;
+    void testCompressedRepeatCounts();
+}
+
+
+
+class shasta::CompressedRepeatCounts {
+public:
+
+    void createNew(const string& name, size_t pageSize);
+    void accessExistingReadOnly(const string& name);
+    void remove();
+    bool isOpen() const
+    {
+        return toc.isOpen && codes.isOpen && blockEscapeBegin.isOpen && escapes.isOpen;
+    }
+
+    // Append the repeat counts of a read.
+    // Repeat counts must be at least 1.
+    void append(const uint8_t* begin, const uint8_t* end);
+
+    // Create from the uncompressed representation.
+    void create(const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>&);
+
+    // The number of reads.
+    uint64_t size() const
+    {
+        return toc.size() - 1;
+    }
+
+    // The number of repeat counts stored for a read
+    // (that is, its number of run-length bases).
+    uint64_t size(uint64_t readId) const
+    {
+        return toc[readId + 1] - toc[readId];
+    }
+
+    // The total number of repeat counts stored for all reads.
+    uint64_t totalSize() const
+    {
+        return toc.back();
+    }
+
+    // Return the repeat count at a given position of a read.
+    uint8_t get(uint64_t readId, uint64_t position) const
+    {
+        return getGlobal(toc[readId] + position);
+    }
+
+    // Decode all the repeat counts of a read.
+    void get(uint64_t readId, vector<uint8_t>&) const;
+
+    // The number of bytes used.
+    uint64_t byteCount() const;
+
+private:
+
+    // The global position of the first repeat count of each read.
+    MemoryMapped::Vector<uint64_t> toc;
+
+    // The 2-bit codes. The code for global position i is in
+    // bits 2*(i%32) and 2*(i%32)+1 of word i/32.
+    MemoryMapped::Vector<uint64_t> codes;
+
+    // For each block of 256 codes, the number of escapes in all previous blocks.
+    MemoryMapped::Vector<uint64_t> blockEscapeBegin;
+
+    // The repeat counts that are not represented by a code.
+    MemoryMapped::Vector<uint8_t> escapes;
+
+    static const uint64_t escapeCode = 3;
+    static const uint64_t codesPerWord = 32;
+    static const uint64_t wordsPerBlock = 8;
+    static const uint64_t codesPerBlock = codesPerWord * wordsPerBlock;
+
+    // Return a word with bit 2*i set if code i of the given word is an escape.
+    static uint64_t escapeBits(uint64_t word)
+    {
+        return word & (word >> 1) & 0x5555555555555555ULL;
+    }
+
+    uint8_t getGlobal(uint64_t i) const
+    {
+        const uint64_t wordIndex = i / codesPerWord;
+        const uint64_t word = codes[wordIndex];
+        const uint64_t shift = 2 * (i % codesPerWord);
+        const uint64_t code = (word >> shift) & 3ULL;
+        if(code != escapeCode) {
+            return uint8_t(code + 1);
+        }
+
+        // Count the escapes that precede this one in its block.
+        uint64_t escapeIndex = blockEscapeBegin[i / codesPerBlock];
+        for(uint64_t j=wordIndex-(wordIndex%wordsPerBlock); j!=wordIndex; j++) {
+            escapeIndex += uint64_t(__builtin_popcountll(escapeBits(codes[j])));
+        }
+        const uint64_t mask = (1ULL << shift) - 1ULL;
+        escapeIndex += uint64_t(__builtin_popcountll(escapeBits(word) & mask));
+        return escapes[escapeIndex];
+    }
+};
+
+#endif
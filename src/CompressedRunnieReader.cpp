@@ -1,5 +1,6 @@
 
 #include "CompressedRunnieReader.hpp"
+#include <sys/mman.h>
 
 
 ostream& operator<<(ostream& s, CompressedRunnieIndex& index) {
@@ -24,21 +25,47 @@ CompressedRunnieReader::CompressedRunnieReader(string filePath) {
     this->sequenceFilePath = filePath;
 
     // Open the input file.
-    this->sequenceFileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    const int fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
 
     // Verify it is working
-    if(this->sequenceFileDescriptor == -1) {
+    if(fileDescriptor == -1) {
         throw runtime_error("ERROR: could not read " + filePath);
     }
 
     // Find file size in bytes
-    this->fileLength = lseek(this->sequenceFileDescriptor, 0, SEEK_END);
+    this->fileLength = lseek(fileDescriptor, 0, SEEK_END);
+    if(this->fileLength < off_t(2*sizeof(uint64_t))) {
+        ::close(fileDescriptor);
+        throw runtime_error("ERROR: runnie file is too short: " + filePath);
+    }
+
+    // Map the entire file. The mapping remains valid after the file is closed.
+    void* pointer = ::mmap(0, size_t(this->fileLength), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if(pointer == MAP_FAILED) {
+        throw runtime_error("ERROR: could not map " + filePath);
+    }
+    this->fileData = static_cast<const char*>(pointer);
+
+    // If the file is truncated or corrupt, parsing throws. The destructor
+    // does not run in that case, so release the mapping here.
+    try {
+
+        // Initialize remaining parameters using the file footer data
+        this->readFooter();
+
+        // Read table of contents, needed for indexed reading
+        this->readIndexes();
+
+    } catch(...) {
+        ::munmap(pointer, size_t(this->fileLength));
+        throw;
+    }
+}
 
-    // Initialize remaining parameters using the file footer data
-    this->readFooter();
 
-    // Read table of contents, needed for indexed reading
-    this->readIndexes();
+CompressedRunnieReader::~CompressedRunnieReader() {
+    ::munmap(const_cast<char*>(this->fileData), size_t(this->fileLength));
 }
 
 
@@ -62,32 +89,61 @@ const string& CompressedRunnieReader::getFileName(){
 }
 
 
+const char* CompressedRunnieReader::getSequenceBegin(uint64_t readNumber) const {
+    return this->fileData + this->indexes.at(readNumber).sequenceByteIndex;
+}
+
+
+const uint8_t* CompressedRunnieReader::getEncodingBegin(uint64_t readNumber) const {
+    const CompressedRunnieIndex& index = this->indexes.at(readNumber);
+    return reinterpret_cast<const uint8_t*>(this->fileData + index.sequenceByteIndex + index.sequenceLength);
+}
+
+
 void CompressedRunnieReader::getSequenceData(CompressedRunnieSequence& sequence, uint64_t readNumber){
-    off_t byteIndex = off_t(this->indexes.at(readNumber).sequenceByteIndex);
-    preadStringFromBinary(this->sequenceFileDescriptor, sequence.sequence, this->indexes.at(readNumber).sequenceLength, byteIndex);
-    preadVectorFromBinary(this->sequenceFileDescriptor, sequence.encoding, this->indexes.at(readNumber).sequenceLength, byteIndex);
+    const uint64_t length = this->indexes.at(readNumber).sequenceLength;
+    const char* sequenceBegin = this->getSequenceBegin(readNumber);
+    const uint8_t* encodingBegin = this->getEncodingBegin(readNumber);
+    sequence.sequence.assign(sequenceBegin, sequenceBegin + length);
+    sequence.encoding.assign(encodingBegin, encodingBegin + length);
 }
 
 void CompressedRunnieReader::getSequenceData(NamedCompressedRunnieSequence& sequence, uint64_t readNumber){
     sequence.name = this->indexes.at(readNumber).name;
-    off_t byteIndex = off_t(this->indexes.at(readNumber).sequenceByteIndex);
-    preadStringFromBinary(this->sequenceFileDescriptor, sequence.sequence, this->indexes.at(readNumber).sequenceLength, byteIndex);
-    preadVectorFromBinary(this->sequenceFileDescriptor, sequence.encoding, this->indexes.at(readNumber).sequenceLength, byteIndex);
+    this->getSequenceData(static_cast<CompressedRunnieSequence&>(sequence), readNumber);
 }
 
 
-void CompressedRunnieReader::readIndexEntry(CompressedRunnieIndex& indexElement, off_t& byteIndex){
-    preadValueFromBinary(this->sequenceFileDescriptor, indexElement.sequenceByteIndex, byteIndex);
-    preadValueFromBinary(this->sequenceFileDescriptor, indexElement.sequenceLength, byteIndex);
-    preadValueFromBinary(this->sequenceFileDescriptor, indexElement.nameLength, byteIndex);
-    preadStringFromBinary(this->sequenceFileDescriptor, indexElement.name, indexElement.nameLength, byteIndex);
+void CompressedRunnieReader::checkByteRange(uint64_t byteIndex, uint64_t byteCount) const {
+    if(byteIndex > uint64_t(this->fileLength) or byteCount > uint64_t(this->fileLength) - byteIndex) {
+        throw runtime_error("ERROR: unexpected end of runnie file: " + this->sequenceFilePath);
+    }
+}
+
+
+void CompressedRunnieReader::readString(string& s, uint64_t length, uint64_t& byteIndex) const {
+    this->checkByteRange(byteIndex, length);
+    s.assign(this->fileData + byteIndex, length);
+    byteIndex += length;
+}
+
+
+void CompressedRunnieReader::readIndexEntry(CompressedRunnieIndex& indexElement, uint64_t& byteIndex){
+    this->readValue(indexElement.sequenceByteIndex, byteIndex);
+    this->readValue(indexElement.sequenceLength, byteIndex);
+    this->readValue(indexElement.nameLength, byteIndex);
+    this->readString(indexElement.name, indexElement.nameLength, byteIndex);
+
+    // Both the sequence and its encoding must be in the file.
+    this->checkByteRange(indexElement.sequenceByteIndex, indexElement.sequenceLength);
+    this->checkByteRange(indexElement.sequenceByteIndex + indexElement.sequenceLength, indexElement.sequenceLength);
 }
 
 
 void CompressedRunnieReader::readIndexes(){
-    off_t byteIndex = off_t(this->indexesStartPosition);
+    uint64_t byteIndex = this->indexesStartPosition;
 
-    while (byteIndex > 0 and uint64_t(byteIndex) < this->channelMetadataStartPosition){
+    while (byteIndex > 0 and byteIndex < this->channelMetadataStartPosition){
         CompressedRunnieIndex indexElement;
         this->readIndexEntry(indexElement, byteIndex);
         this->indexes.emplace_back(indexElement);
@@ -107,20 +163,20 @@ void CompressedRunnieReader::readChannelMetadata(){
     /// Read the description of the channels that accompany the nucleotide sequence. Not currently used for initializing
     /// data vectors, since CompressedRunnieSequence.encodings specifies the data type.
     ///
-    off_t byteIndex = off_t(this->channelMetadataStartPosition);
-    preadValueFromBinary(this->sequenceFileDescriptor, this->nChannels, byteIndex);
+    uint64_t byteIndex = this->channelMetadataStartPosition;
+    this->readValue(this->nChannels, byteIndex);
     this->channelSizes.resize(nChannels);
 
     for (uint64_t i=0; i<this->nChannels; i++) {
-        preadValueFromBinary(this->sequenceFileDescriptor, this->channelSizes.at(i), byteIndex);
+        this->readValue(this->channelSizes.at(i), byteIndex);
     }
 }
 
 
 void CompressedRunnieReader::readFooter(){
-    off_t byteIndex = off_t(this->fileLength - 2*sizeof(uint64_t));
-    preadValueFromBinary(this->sequenceFileDescriptor, this->indexesStartPosition, byteIndex);
-    preadValueFromBinary(this->sequenceFileDescriptor, this->channelMetadataStartPosition, byteIndex);
+    uint64_t byteIndex = uint64_t(this->fileLength) - 2*sizeof(uint64_t);
+    this->readValue(this->indexesStartPosition, byteIndex);
+    this->readValue(this->channelMetadataStartPosition, byteIndex);
 
     this-> readChannelMetadata();
 }
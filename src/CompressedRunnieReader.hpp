@@ -53,6 +53,11 @@ public:
 };
 
 
+// The file is mapped read-only in its entirety. The index is parsed
+// once, in the constructor, and all the functions that access
+// sequences work directly on the mapping, without any shared
+// stream or file position state, so they can be called
+// concurrently from multiple threads.
 class CompressedRunnieReader{
 public:
 
@@ -60,6 +65,11 @@ public:
 
     // Initialize the class with a file path
     CompressedRunnieReader(string filePath);
+    ~CompressedRunnieReader();
+
+    // The file mapping is owned by this object.
+    CompressedRunnieReader(const CompressedRunnieReader&) = delete;
+    CompressedRunnieReader& operator=(const CompressedRunnieReader&) = delete;
 
     // Fetch the name of a read based on its number (ordering in file, 0-based)
     const string& getReadName(uint64_t readNumber);
@@ -73,6 +83,12 @@ public:
     // Fetch sequence data, and the 'name' field is also filled in.
     void getSequenceData(NamedCompressedRunnieSequence& sequence, uint64_t readNumber);
 
+    // Direct access to the sequence and encoding of a read
+    // in the file mapping, without copying.
+    // Each points to getLength(readNumber) bytes.
+    const char* getSequenceBegin(uint64_t readNumber) const;
+    const uint8_t* getEncodingBegin(uint64_t readNumber) const;
+
     // Fetch the number of reads in the file
     size_t getReadCount();
 
@@ -83,7 +99,9 @@ private:
 
     /// Attributes ///
     string sequenceFilePath;
-    int sequenceFileDescriptor;
+
+    // The read-only mapping of the entire file.
+    const char* fileData;
 
     uint64_t indexesStartPosition;
     uint64_t channelMetadataStartPosition;
@@ -99,7 +117,19 @@ private:
     void readFooter();
     void readChannelMetadata();
     void readIndexes();
-    void readIndexEntry(CompressedRunnieIndex& indexElement, off_t& byteIndex);
+    void readIndexEntry(CompressedRunnieIndex& indexElement, uint64_t& byteIndex);
+
+    // Check that the given number of bytes starting at byteIndex is in the file.
+    void checkByteRange(uint64_t byteIndex, uint64_t byteCount) const;
+
+    // Read a value or string from the mapping and advance byteIndex.
+    template<class T> void readValue(T& v, uint64_t& byteIndex) const
+    {
+        this->checkByteRange(byteIndex, sizeof(T));
+        std::memcpy(&v, this->fileData + byteIndex, sizeof(T));
+        byteIndex += sizeof(T);
+    }
+    void readString(string& s, uint64_t length, uint64_t& byteIndex) const;
 
     vector<CompressedRunnieIndex> indexes;
     unordered_map<string,size_t> indexMap;
@@ -0,0 +1,111 @@
+// Shasta.
+#include "FeatureHashes.hpp"
+#include "MurmurHash2.hpp"
+#include "ReadFlags.hpp"
+#include "timestamp.hpp"
+using namespace shasta;
+
+
+
+FeatureHashes::FeatureHashes(
+    size_t m,
+    size_t threadCount,
+    const MemoryMapped::Vector<ReadFlags>& readFlags,
+    const Markers& markers,
+    const string& name,
+    size_t pageSize) :
+    MultithreadedObject(*this),
+    m(m),
+    readFlags(readFlags),
+    markers(markers)
+{
+    cout << timestamp << "Computing feature hashes." << endl;
+
+    // Each oriented read has one feature for each
+    // group of m consecutive markers.
+    const uint64_t orientedReadCount = markers.size();
+    baseHashes.createNew(name, pageSize);
+    baseHashes.beginPass1(orientedReadCount);
+    for(uint64_t i=0; i<orientedReadCount; i++) {
+        const ReadId readId = OrientedReadId(OrientedReadId::Int(i)).getReadId();
+        const uint64_t markerCount = markers.size(i);
+        if((not readFlags[readId].isPalindromic) and markerCount >= m) {
+            baseHashes.incrementCount(i, markerCount - m + 1);
+        }
+    }
+    baseHashes.beginPass2();
+    baseHashes.endPass2(false);
+
+    setupLoadBalancing(orientedReadCount, 1000);
+    runThreads(&FeatureHashes::computeBaseHashes, threadCount);
+    cout << timestamp << "Computed " << baseHashes.totalSize() << " feature hashes." << endl;
+}
+
+
+
+FeatureHashes::~FeatureHashes()
+{
+    if(baseHashes.isOpen()) {
+        baseHashes.remove();
+    }
+}
+
+
+
+void FeatureHashes::computeBaseHashes(size_t threadId)
+{
+    const int featureByteCount = int(m * sizeof(KmerId));
+
+    // Used by getKmerIds if the k-mer ids of
+    // the markers of an oriented read are not stored.
+    vector<KmerId> kmerIdsBuffer;
+
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+
+        // Loop over oriented reads assigned to this batch.
+        for(uint64_t i=begin; i!=end; i++) {
+            const uint64_t featureCount = baseHashes.size(i);
+            if(featureCount == 0) {
+                continue;
+            }
+            const KmerId* kmerIdsPointer = markers.getKmerIds(i, kmerIdsBuffer);
+            uint64_t* hashes = baseHashes.begin(i);
+            for(uint64_t j=0; j<featureCount; j++, kmerIdsPointer++) {
+                hashes[j] = MurmurHash64A(kmerIdsPointer, featureByteCount, 231);
+            }
+        }
+    }
+}
+
+
+
+// Compute the hashes of the features of an oriented read
+// for a given iteration.
+void FeatureHashes::getHashes(
+    OrientedReadId orientedReadId,
+    uint64_t iteration,
+    vector<uint64_t>& hashes) const
+{
+    const auto orientedReadBaseHashes = baseHashes[orientedReadId.getValue()];
+    const uint64_t featureCount = orientedReadBaseHashes.size();
+    hashes.resize(featureCount);
+
+    // The key for this iteration.
+    const uint64_t key = (iteration + 1) * 0x9E3779B97F4A7C15ULL;
+
+    // Combine each base hash with the key, then apply the
+    // MurmurHash3 finalizer. Each step is invertible.
+    const uint64_t* baseHashPointer = orientedReadBaseHashes.begin();
+    uint64_t* hashPointer = hashes.data();
+    for(uint64_t j=0; j<featureCount; j++) {
+        uint64_t x = baseHashPointer[j] ^ key;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDULL;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ULL;
+        x ^= x >> 33;
+        hashPointer[j] = x;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef SHASTA_FEATURE_HASHES_HPP
+#define SHASTA_FEATURE_HASHES_HPP
+
+/*******************************************************************************
+
+Class FeatureHashes is used by the LowHash algorithms to avoid
+recomputing the hash of each feature (sequence of m consecutive markers)
+at each LowHash iteration.
+
+The constructor computes a 64 bit base hash of each feature
+of each oriented read, using MurmurHash64A, and stores it.
+At each iteration, the hash of a feature is then obtained from
+its base hash by combining it with a key that depends on the iteration,
+followed by the 64 bit finalizer of MurmurHash3.
+This mix is invertible, so two features with distinct base hashes
+also have distinct hashes at each iteration.
+It only uses shifts, xors, and multiplications, and it is applied
+in a simple loop over all the features of an oriented read,
+which the compiler can vectorize.
+
+This uses 8 bytes per feature, or approximately 8 bytes per marker
+on both strands.
+
+*******************************************************************************/
+
+// Shasta.
+#include "Markers.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "MultithreadedObject.hpp"
+#include "ReadId.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class FeatureHashes;
+    class ReadFlags;
+}
+
+
+
+class shasta::FeatureHashes :
+    public MultithreadedObject<FeatureHashes> {
+public:
+
+    // The constructor computes the base hashes.
+    // Palindromic reads get no features.
+    FeatureHashes(
+        size_t m,                       // Number of consecutive markers that define a feature.
+        size_t threadCount,
+        const MemoryMapped::Vector<ReadFlags>&,
+        const Markers&,
+        const string& name,
+        size_t pageSize);
+    ~FeatureHashes();
+
+    // Compute the hashes of the features of an oriented read
+    // for a given iteration.
+    void getHashes(
+        OrientedReadId,
+        uint64_t iteration,
+        vector<uint64_t>& hashes) const;
+
+private:
+
+    size_t m;
+    const MemoryMapped::Vector<ReadFlags>& readFlags;
+    const Markers& markers;
+
+    // The base hashes of the features of each oriented read.
+    // Indexed by OrientedReadId::getValue().
+    MemoryMapped::VectorOfVectors<uint64_t, uint64_t> baseHashes;
+    void computeBaseHashes(size_t threadId);
+};
+
+#endif
@@ -434,6 +434,25 @@ string HttpServer::urlEncode(const string& s)
 
 
 
+string HttpServer::htmlEscape(const string& s)
+{
+    string escaped;
+    escaped.reserve(s.size());
+    for(const char c: s) {
+        switch(c) {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        case '\'': escaped += "&#39;"; break;
+        default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+
+
 
 ostream& HttpServer::writeJQuery(ostream& html)
 {
@@ -145,6 +145,10 @@ protected:
     // https://stackoverflow.com/questions/154536/encode-decode-urls-in-c
     static string urlEncode(const string&);
 
+    // Function to do HTML escaping.
+    // This is necessary when we write user supplied text into a page.
+    static string htmlEscape(const string&);
+
 
 protected:
 
@@ -1,6 +1,7 @@
 #ifndef SHASTA_KMER_HPP
 #define SHASTA_KMER_HPP
 
+#include "MurmurHash2.hpp"
 #include "ShortBaseSequence.hpp"
 #include <limits>
 
@@ -8,8 +9,16 @@ namespace shasta {
 
     // Types used to represent a k-mer and a k-mer id.
     // These limit the maximum k-mer length that can be used.
+    // The default build allows k up to 16.
+    // Building with SHASTA_LONG_KMERS (cmake option BUILD_LONG_KMERS)
+    // allows k up to 32, at the cost of 4 additional bytes per marker.
+#ifdef SHASTA_LONG_KMERS
+    using Kmer = ShortBaseSequence32;
+    using KmerId = uint64_t;
+#else
     using Kmer = ShortBaseSequence16;
     using KmerId = uint32_t;
+#endif
 
     // Check for consistency of these two types.
     static_assert(
@@ -17,6 +26,27 @@ namespace shasta {
         "Kmer and KmerId types are inconsistent.");
 
     class KmerInfo;
+
+    // The k-mer table (Assembler::kmerTable) has 4^k entries,
+    // so it is only used for k up to this value.
+    // For longer k-mers, the k-mer table is empty and marker k-mers
+    // are selected by hashing, using isHashedMarkerKmer.
+    const uint64_t maxKmerTableK = 16;
+
+    // When the k-mer table is not used, a k-mer is a marker
+    // if the hash of the lower of its KmerId and the KmerId of its
+    // reverse complement is at most a given threshold.
+    // This way a k-mer is a marker if and only if its
+    // reverse complement is a marker.
+    inline bool isHashedMarkerKmer(
+        KmerId kmerId,
+        KmerId reverseComplementedKmerId,
+        uint64_t hashThreshold)
+    {
+        const KmerId canonicalKmerId = (kmerId < reverseComplementedKmerId) ?
+            kmerId : reverseComplementedKmerId;
+        return MurmurHash64A(&canonicalKmerId, sizeof(canonicalKmerId), 759) <= hashThreshold;
+    }
 }
 
 
@@ -0,0 +1,102 @@
+#include "KmerIterator.hpp"
+#include "SHASTA_ASSERT.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <chrono>
+#include "iostream.hpp"
+#include <random>
+#include "vector.hpp"
+
+
+
+// Check that KmerIterator generates the same KmerIds
+// as the base by base loop previously used in MarkerFinder,
+// and compare the time taken by the two methods.
+void shasta::testKmerIterator()
+{
+    std::mt19937 randomSource(231);
+    std::uniform_int_distribution<int> baseDistribution(0, 3);
+
+    // Generate some random sequences of varying length.
+    vector<LongBaseSequence> sequences;
+    uint64_t totalBaseCount = 0;
+    for(uint64_t baseCount=0; baseCount<200; baseCount++) {
+        sequences.push_back(LongBaseSequence(baseCount));
+    }
+    for(uint64_t i=0; i<100; i++) {
+        sequences.push_back(LongBaseSequence(100000 + 37 * i));
+    }
+    for(LongBaseSequence& sequence: sequences) {
+        for(uint64_t i=0; i<sequence.baseCount; i++) {
+            sequence.set(i, Base::fromInteger(uint8_t(baseDistribution(randomSource))));
+        }
+        totalBaseCount += sequence.baseCount;
+    }
+
+    // Also test the longest k-mers allowed by the build.
+    vector<uint64_t> kValues = {1, 2, 10, 15, 16};
+    if(Kmer::capacity > 16) {
+        kValues.push_back(uint64_t(Kmer::capacity) - 1);
+        kValues.push_back(uint64_t(Kmer::capacity));
+    }
+
+    for(const uint64_t k: kValues) {
+
+        // Generate the KmerIds base by base.
+        const auto t0 = std::chrono::steady_clock::now();
+        uint64_t checkSum0 = 0;
+        for(const LongBaseSequence& sequence: sequences) {
+            if(sequence.baseCount < k) {
+                continue;
+            }
+            Kmer kmer;
+            for(size_t position=0; position<k; position++) {
+                kmer.set(position, sequence[position]);
+            }
+            for(uint64_t position=0; ; position++) {
+                checkSum0 += kmer.id(k);
+                if(position+k == sequence.baseCount) {
+                    break;
+                }
+                kmer.shiftLeft();
+                kmer.set(k-1, sequence[position+k]);
+            }
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+
+        // Generate them with the KmerIterator.
+        uint64_t checkSum1 = 0;
+        for(const LongBaseSequence& sequence: sequences) {
+            for(KmerIterator it(sequence, k); it.isValid(); ++it) {
+                checkSum1 += it.kmerId();
+            }
+        }
+        const auto t2 = std::chrono::steady_clock::now();
+        SHASTA_ASSERT(checkSum0 == checkSum1);
+
+        // Check each KmerId and its reverse complement.
+        for(const LongBaseSequence& sequence: sequences) {
+            uint64_t kmerCount = 0;
+            for(KmerIterator it(sequence, k); it.isValid(); ++it) {
+                const uint64_t position = it.position();
+                SHASTA_ASSERT(position == kmerCount);
+                Kmer kmer;
+                for(uint64_t i=0; i<k; i++) {
+                    kmer.set(i, sequence[position + i]);
+                }
+                SHASTA_ASSERT(it.kmerId() == KmerId(kmer.id(k)));
+                SHASTA_ASSERT(it.reverseComplementedKmerId() ==
+                    KmerId(kmer.reverseComplement(k).id(k)));
+                ++kmerCount;
+            }
+            SHASTA_ASSERT(kmerCount == ((sequence.baseCount >= k) ? (sequence.baseCount - k + 1) : 0));
+        }
+
+        const double tBaseByBase = 1.e-9 * double((std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)).count());
+        const double tIterator = 1.e-9 * double((std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1)).count());
+        cout << "k=" << k << ": generated the k-mers of " << totalBaseCount << " bases in " <<
+            tBaseByBase << " s base by base and in " <<
+            tIterator << " s using KmerIterator." << endl;
+    }
+}
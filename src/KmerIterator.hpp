@@ -0,0 +1,153 @@
+#ifndef SHASTA_KMER_ITERATOR_HPP
+#define SHASTA_KMER_ITERATOR_HPP
+
+/*******************************************************************************
+
+Class KmerIterator generates the KmerIds of all k-mers of a
+LongBaseSequenceView, in order of increasing position,
+together with the KmerIds of their reverse complements.
+
+A KmerId is the concatenation of the MSB bits of the k bases
+followed by the LSB bits of the k bases, with base 0
+corresponding to the most significant bit of each group
+(see ShortBaseSequence::id).
+
+The LongBaseSequenceView stores the LSB bits and MSB bits of
+each block of 64 bases in two separate words, with base 0 of the block
+in the most significant bit. So the iterator keeps a copy of the two
+words of the current block and, for each new base, shifts one bit
+out of each of them and into the two halves of the KmerId.
+The words of a block are only loaded once, and no
+per-base index computation is required.
+
+The reverse complemented KmerId is maintained at the same time:
+the new base is complemented (which flips both of its bits)
+and enters at the opposite end.
+
+Usage:
+
+for(KmerIterator it(read, k); it.isValid(); ++it) {
+    const uint32_t position = it.position();
+    const KmerId kmerId = it.kmerId();
+    ...
+}
+
+*******************************************************************************/
+
+// Shasta.
+#include "Kmer.hpp"
+#include "LongBaseSequence.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+
+namespace shasta {
+    class KmerIterator;
+    void testKmerIterator();
+}
+
+
+
+class shasta::KmerIterator {
+public:
+
+    KmerIterator(const LongBaseSequenceView& sequence, uint64_t k) :
+        begin(sequence.begin),
+        baseCount(sequence.baseCount),
+        k(k),
+        mask((1ULL << k) - 1ULL),
+        reverseComplementShift(k - 1ULL)
+    {
+        if(baseCount >= k) {
+            for(uint64_t i=0; i<k; i++) {
+                shiftIn();
+            }
+        }
+    }
+
+    // Return true if the iterator points to a k-mer,
+    // false if it moved past the end of the sequence.
+    bool isValid() const
+    {
+        return currentPosition + k <= baseCount;
+    }
+
+    // Move to the next k-mer.
+    KmerIterator& operator++()
+    {
+        ++currentPosition;
+        if(isValid()) {
+            shiftIn();
+        }
+        return *this;
+    }
+
+    // The position of the first base of the current k-mer.
+    uint32_t position() const
+    {
+        return uint32_t(currentPosition);
+    }
+
+    // The KmerId of the current k-mer.
+    KmerId kmerId() const
+    {
+        return KmerId((msb << k) | lsb);
+    }
+
+    // The KmerId of the reverse complement of the current k-mer.
+    KmerId reverseComplementedKmerId() const
+    {
+        return KmerId((reverseComplementedMsb << k) | reverseComplementedLsb);
+    }
+
+private:
+
+    // The sequence.
+    const uint64_t* begin;
+    uint64_t baseCount;
+
+    uint64_t k;
+    uint64_t mask;
+    uint64_t reverseComplementShift;
+
+    // The position of the current k-mer, and the position
+    // of the next base to be shifted in.
+    uint64_t currentPosition = 0;
+    uint64_t nextBasePosition = 0;
+
+    // The bits of the current block that were not yet shifted in,
+    // with the next base in the most significant bit.
+    uint64_t word0 = 0; // LSB bits.
+    uint64_t word1 = 0; // MSB bits.
+
+    // The two halves of the KmerId of the current k-mer
+    // and of its reverse complement.
+    uint64_t lsb = 0;
+    uint64_t msb = 0;
+    uint64_t reverseComplementedLsb = 0;
+    uint64_t reverseComplementedMsb = 0;
+
+    // Add the next base of the sequence to the right end
+    // of the k-mer, dropping its leftmost base.
+    void shiftIn()
+    {
+        // At the beginning of a block of 64 bases, load its two words.
+        if((nextBasePosition & 63ULL) == 0) {
+            const uint64_t* blockBegin = begin + ((nextBasePosition >> 6ULL) << 1ULL);
+            word0 = blockBegin[0];
+            word1 = blockBegin[1];
+        }
+        const uint64_t bit0 = word0 >> 63ULL;
+        const uint64_t bit1 = word1 >> 63ULL;
+        word0 <<= 1ULL;
+        word1 <<= 1ULL;
+        ++nextBasePosition;
+
+        lsb = ((lsb << 1ULL) | bit0) & mask;
+        msb = ((msb << 1ULL) | bit1) & mask;
+        reverseComplementedLsb = (reverseComplementedLsb >> 1ULL) | ((bit0 ^ 1ULL) << reverseComplementShift);
+        reverseComplementedMsb = (reverseComplementedMsb >> 1ULL) | ((bit1 ^ 1ULL) << reverseComplementShift);
+    }
+};
+
+#endif
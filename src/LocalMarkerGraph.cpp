@@ -16,13 +16,15 @@ LocalMarkerGraph::LocalMarkerGraph(
     uint32_t k,
     LongBaseSequences& reads,
     const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts,
-    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    const CompressedRepeatCounts& compressedReadRepeatCounts,
+    const Markers& markers,
     const MemoryMapped::Vector<MarkerGraph::CompressedVertexId>& globalMarkerGraphVertex,
     const ConsensusCaller& consensusCaller
     ) :
     k(k),
     reads(reads),
     readRepeatCounts(readRepeatCounts),
+    compressedReadRepeatCounts(compressedReadRepeatCounts),
     markers(markers),
     globalMarkerGraphVertex(globalMarkerGraphVertex),
     consensusCaller(consensusCaller)
@@ -85,13 +87,13 @@ KmerId LocalMarkerGraph::getKmerId(vertex_descriptor v) const
     const LocalMarkerGraphVertex& vertex = (*this)[v];
     SHASTA_ASSERT(!vertex.markerInfos.empty());
     const MarkerId firstMarkerId = vertex.markerInfos.front().markerId;
-    const CompressedMarker& firstMarker = markers.begin()[firstMarkerId];
+    const CompressedMarker& firstMarker = markers.get(firstMarkerId);
     const KmerId kmerId = firstMarker.kmerId;
 
     // Sanity check that all markers have the same kmerId.
     // At some point this can be removed.
     for(const auto& markerInfo: vertex.markerInfos){
-        const CompressedMarker& marker = markers.begin()[markerInfo.markerId];
+        const CompressedMarker& marker = markers.get(markerInfo.markerId);
         SHASTA_ASSERT(marker.kmerId == kmerId);
     }
 
@@ -107,16 +109,16 @@ vector<uint8_t> LocalMarkerGraph::getRepeatCounts(
     const OrientedReadId orientedReadId = markerInfo.orientedReadId;
     const ReadId readId = orientedReadId.getReadId();
     const Strand strand = orientedReadId.getStrand();
-    const CompressedMarker& marker = markers.begin()[markerInfo.markerId];
+    const CompressedMarker& marker = markers.get(markerInfo.markerId);
 
-    const auto& counts = readRepeatCounts[readId];
+    const uint32_t readLength = uint32_t(reads[readId].baseCount);
 
     vector<uint8_t> v(k);
-    for(size_t i=0; i<k; i++) {
+    for(uint32_t i=0; i<k; i++) {
         if(strand == 0) {
-            v[i] = counts[marker.position + i];
+            v[i] = getReadRepeatCount(readId, marker.position + i);
         } else {
-            v[i] = counts[counts.size() - 1 - marker.position - i];
+            v[i] = getReadRepeatCount(readId, readLength - 1 - marker.position - i);
         }
     }
 
@@ -179,22 +181,23 @@ void LocalMarkerGraph::storeEdgeInfo(
     // Map to store the oriented read ids and ordinals, grouped by sequence.
     std::map<LocalMarkerGraphEdge::Sequence, vector<MarkerIntervalWithRepeatCounts> > sequenceTable;
     for(const MarkerInterval& interval: intervals) {
-        const CompressedMarker& marker0 = markers.begin(interval.orientedReadId.getValue())[interval.ordinals[0]];
-        const CompressedMarker& marker1 = markers.begin(interval.orientedReadId.getValue())[interval.ordinals[1]];
+        const CompressedMarker& marker0 = markers[interval.orientedReadId.getValue()][interval.ordinals[0]];
+        const CompressedMarker& marker1 = markers[interval.orientedReadId.getValue()][interval.ordinals[1]];
 
         // Fill in the sequence information and, if necessary, the base repeat counts.
         LocalMarkerGraphEdge::Sequence sequence;
         MarkerIntervalWithRepeatCounts intervalWithRepeatCounts(interval);
         if(marker1.position <= marker0.position + k) {
             sequence.overlappingBaseCount = uint8_t(marker0.position + k - marker1.position);
-            const auto& repeatCounts = readRepeatCounts[interval.orientedReadId.getReadId()];
+            const ReadId readId = interval.orientedReadId.getReadId();
+            const uint32_t readLength = uint32_t(reads[readId].baseCount);
             for(uint32_t i=0; i<sequence.overlappingBaseCount; i++) {
                 uint32_t position = marker1.position + i;
                 uint8_t repeatCount = 0;
                 if(interval.orientedReadId.getStrand() == 0) {
-                    repeatCount = repeatCounts[position];
+                    repeatCount = getReadRepeatCount(readId, position);
                 } else {
-                    repeatCount = repeatCounts[repeatCounts.size() - 1 - position];
+                    repeatCount = getReadRepeatCount(readId, readLength - 1 - position);
                 }
                 intervalWithRepeatCounts.repeatCounts.push_back(repeatCount);
             }
@@ -212,13 +215,13 @@ void LocalMarkerGraph::storeEdgeInfo(
                 }
                 sequence.sequence.push_back(base);
             }
-            const auto repeatCounts = readRepeatCounts[interval.orientedReadId.getReadId()];
+            const ReadId readId = interval.orientedReadId.getReadId();
             for(uint32_t position=marker0.position+k;  position!=marker1.position; position++) {
                 uint8_t repeatCount;
                 if(interval.orientedReadId.getStrand() == 0) {
-                    repeatCount = repeatCounts[position];
+                    repeatCount = getReadRepeatCount(readId, position);
                 } else {
-                    repeatCount = repeatCounts[readLength - 1 - position];
+                    repeatCount = getReadRepeatCount(readId, readLength - 1 - position);
                 }
                 intervalWithRepeatCounts.repeatCounts.push_back(repeatCount);
             }
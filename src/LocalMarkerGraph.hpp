@@ -17,8 +17,10 @@ a group of aligned markers.
 
 // Shasta.
 #include "AssemblyGraph.hpp"
+#include "CompressedRepeatCounts.hpp"
 #include "Kmer.hpp"
 #include "MarkerGraph.hpp"
+#include "Markers.hpp"
 
 // Boost libraries.
 #include <boost/graph/adjacency_list.hpp>
@@ -190,7 +192,8 @@ public:
         uint32_t k,
         LongBaseSequences& reads,
         const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts,
-        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        const CompressedRepeatCounts& compressedReadRepeatCounts,
+        const Markers& markers,
         const MemoryMapped::Vector<MarkerGraph::CompressedVertexId>& globalMarkerGraphVertex,
         const ConsensusCaller&
         );
@@ -264,8 +267,19 @@ private:
     // Reference to the global data structure containing all reads and markers
     // (not just those in this local marker graph).
     LongBaseSequences& reads;
+    // Only one of readRepeatCounts and compressedReadRepeatCounts is open.
+    // Access repeat counts via getReadRepeatCount.
     const MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts;
-    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
+    const CompressedRepeatCounts& compressedReadRepeatCounts;
+    const Markers& markers;
+    uint8_t getReadRepeatCount(ReadId readId, uint32_t position) const
+    {
+        if(readRepeatCounts.isOpen()) {
+            return readRepeatCounts.begin(readId)[position];
+        } else {
+            return compressedReadRepeatCounts.get(readId, position);
+        }
+    }
 
     // A reference to the vector containing the global marker graph vertex id
     // corresponding to each marker.
@@ -86,6 +86,53 @@ void LongBaseSequences::append(size_t baseCountArgument)
 
 
 
+// Functions used to append the sequences of several other
+// LongBaseSequences in parallel.
+void LongBaseSequences::appendUninitialized(uint64_t sequenceCount, uint64_t wordCount)
+{
+    baseCount.resize(baseCount.size() + sequenceCount);
+    data.appendUninitializedVectors(sequenceCount, wordCount);
+    SHASTA_ASSERT(baseCount.size() == data.size());
+}
+void LongBaseSequences::copySequences(
+    uint64_t sequenceBegin,
+    uint64_t wordBegin,
+    const LongBaseSequences& that)
+{
+    copySequences(sequenceBegin, wordBegin, that, 0, that.size());
+}
+void LongBaseSequences::copySequences(
+    uint64_t sequenceBegin,
+    uint64_t wordBegin,
+    const LongBaseSequences& that,
+    uint64_t thatSequenceBegin,
+    uint64_t thatSequenceEnd)
+{
+    copy(
+        that.baseCount.begin() + thatSequenceBegin,
+        that.baseCount.begin() + thatSequenceEnd,
+        baseCount.begin() + sequenceBegin);
+    data.copyVectors(sequenceBegin, wordBegin, that.data, thatSequenceBegin, thatSequenceEnd);
+}
+
+
+
+// Remove, in place, the sequences for which keep is false.
+void LongBaseSequences::keepSequences(const vector<bool>& keep)
+{
+    SHASTA_ASSERT(keep.size() == baseCount.size());
+    uint64_t newSequenceCount = 0;
+    for(uint64_t i=0; i<keep.size(); i++) {
+        if(keep[i]) {
+            baseCount[newSequenceCount++] = baseCount[i];
+        }
+    }
+    baseCount.resize(newSequenceCount);
+    data.keepVectors(keep);
+}
+
+
+
 void shasta::testLongBaseSequence()
 {
 
@@ -272,6 +272,43 @@ public:
     void append(const vector<Base>&);
     void append(size_t baseCount);
 
+    // The total number of words used by all the sequences.
+    uint64_t totalWordCount() const
+    {
+        return data.totalSize();
+    }
+
+    // The index of the first word used by a sequence.
+    uint64_t wordBegin(uint64_t i) const
+    {
+        return data.begin(i) - data.begin();
+    }
+
+    // Functions used to append the sequences of several other
+    // LongBaseSequences in parallel.
+    // See VectorOfVectors::appendUninitializedVectors
+    // and VectorOfVectors::copyVectors.
+    void appendUninitialized(uint64_t sequenceCount, uint64_t wordCount);
+    bool canAppendInPlace(uint64_t sequenceCount, uint64_t wordCount) const
+    {
+        return
+            baseCount.size() + sequenceCount <= baseCount.capacity() and
+            data.canAppendInPlace(sequenceCount, wordCount);
+    }
+    void copySequences(
+        uint64_t sequenceBegin,
+        uint64_t wordBegin,
+        const LongBaseSequences&);
+    void copySequences(
+        uint64_t sequenceBegin,
+        uint64_t wordBegin,
+        const LongBaseSequences&,
+        uint64_t thatSequenceBegin,
+        uint64_t thatSequenceEnd);
+
+    // Remove, in place, the sequences for which keep is false.
+    void keepSequences(const vector<bool>& keep);
+
 private:
 
     // The number of bases of each of the sequences.
@@ -1,5 +1,7 @@
 // Shasta.
 #include "LowHash0.hpp"
+#include "BucketFiller.hpp"
+#include "FeatureHashes.hpp"
 #include "ReadFlags.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
@@ -19,15 +21,18 @@ using namespace shasta;
 LowHash0::LowHash0(
     size_t m,                       // Number of consecutive markers that define a feature.
     double hashFraction,
-    size_t minHashIterationCount,   // Number of minHash iterations.
+    size_t minHashIterationCount,   // Number of minHash iterations, or maximum number if adaptive.
     size_t log2MinHashBucketCount,  // Base 2 log of number of buckets for minHash.
     size_t minBucketSize,           // The minimum size for a bucket to be used.
     size_t maxBucketSize,           // The maximum size for a bucket to be used.
     size_t minFrequency,            // Minimum number of minHash hits for a pair to be considered a candidate.
+    bool hashFeaturesOnce,
+    double minNewCandidateFraction,
+    size_t minCandidatesPerRead,
     size_t threadCountArgument,
     const MemoryMapped::Vector<KmerInfo>& kmerTable,
     const MemoryMapped::Vector<ReadFlags>& readFlags,
-    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    const Markers& markers,
     MemoryMapped::Vector<OrientedReadPair>& candidateAlignments,
     MemoryMapped::Vector< array<uint64_t, 3> >& readLowHashStatistics,
     const string& largeDataFileNamePrefix,
@@ -39,6 +44,8 @@ LowHash0::LowHash0(
     minBucketSize(minBucketSize),
     maxBucketSize(maxBucketSize),
     minFrequency(minFrequency),
+    minNewCandidateFraction(minNewCandidateFraction),
+    minCandidatesPerRead(minCandidatesPerRead),
     threadCount(threadCountArgument),
     kmerTable(kmerTable),
     readFlags(readFlags),
@@ -92,11 +99,6 @@ LowHash0::LowHash0(
 
 
 
-    // Create vectors containing only the k-mer ids of all markers.
-    // This is used to speed up the computation of hash functions.
-    cout << timestamp << "Creating kmer ids for oriented reads." << endl;
-    createKmerIds();
-
     // Compute the threshold for a hash value to be considered low.
     hashThreshold = uint64_t(double(hashFraction) * double(std::numeric_limits<uint64_t>::max()));
 
@@ -112,8 +114,20 @@ LowHash0::LowHash0(
     buckets.createNew(
         largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-Buckets"),
         largeDataPageSize);
+    BucketFiller<BucketEntry> bucketFiller(
+        log2MinHashBucketCount, threadCount,
+        largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-StagedBucketEntries"),
+        largeDataPageSize);
+    bucketFillerPointer = &bucketFiller;
+    if(hashFeaturesOnce) {
+        featureHashes = make_shared<FeatureHashes>(
+            m, threadCount, readFlags, markers,
+            largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-FeatureHashes"),
+            largeDataPageSize);
+    }
     lowHashes.resize(orientedReadCount);
     candidates.resize(readCount);
+    readCandidateCount.resize(readCount, 0);
     threadStatistics.resize(threadCount);
     readLowHashStatistics.resize(readCount);
     fill(readLowHashStatistics.begin(), readLowHashStatistics.end(),
@@ -124,24 +138,38 @@ LowHash0::LowHash0(
 
 
 
+    // In adaptive mode, minHashIterationCount is the maximum
+    // number of iterations, and we stop as soon as
+    // additional iterations are no longer useful.
+    const bool isAdaptive = (minNewCandidateFraction > 0.) or (minCandidatesPerRead > 0);
+    if(isAdaptive) {
+        cout << "LowHash0 will use adaptive mode with at most " <<
+            minHashIterationCount << " iterations." << endl;
+    }
+    uint64_t previousHighFrequency = 0;
+
+
+
     // LowHash0 iteration loop.
     for(iteration=0; iteration<minHashIterationCount; iteration++) {
         cout << timestamp << "LowHash0 iteration " << iteration << " begins." << endl;
 
         // Pass1: compute the low hashes for each oriented read
         // and prepare the buckets for filling.
-        buckets.clear();
-        buckets.beginPass1(bucketCount);
+        bucketFiller.beginCount();
         size_t batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash0::pass1ThreadFunction, threadCount);
 
         // Pass 2: fill the buckets.
-        buckets.beginPass2();
+        // The BucketFiller first partitions the bucket entries
+        // by the most significant bits of the bucket id,
+        // then fills each partition of the buckets independently.
+        bucketFiller.beginStore();
         batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash0::pass2ThreadFunction, threadCount);
-        buckets.endPass2(false, false);
+        bucketFiller.fill(buckets);
         computeBucketHistogram();
 
         // Pass 3: inspect the buckets to find candidates.
@@ -162,6 +190,17 @@ LowHash0::LowHash0(
         cout << ": high frequency " << highFrequency;
         cout << ", total " << total;
         cout << ", capacity " << capacity << "." << endl;
+
+        // Number of candidates that reached minFrequency at this iteration.
+        const uint64_t newCandidateCount = highFrequency - previousHighFrequency;
+        previousHighFrequency = highFrequency;
+        cout << "New alignment candidates at iteration " << iteration <<
+            ": " << newCandidateCount << endl;
+
+        if(isAdaptive and isSaturated(newCandidateCount, highFrequency)) {
+            cout << "LowHash0 stopping after " << iteration + 1 << " iterations." << endl;
+            break;
+        }
     }
 
 
@@ -169,17 +208,29 @@ LowHash0::LowHash0(
     // Create the candidate alignments.
     cout << timestamp << "Storing candidate alignments." << endl;
     SHASTA_ASSERT(orientedReadCount == 2*readCount);
+    vector<Candidate> candidates0;
     for(ReadId readId0=0; readId0<readCount; readId0++) {
-        const auto& candidates0 = candidates[readId0];
-        for(const Candidate& candidate: candidates0) {
-            if(candidate.frequency >= minFrequency) {
-                const ReadId readId1 = candidate.readId1;
-                SHASTA_ASSERT(readId0 < readId1);
-                candidateAlignments.push_back(
-                    OrientedReadPair(readId0, readId1, candidate.strand==0));
+
+        // Gather the candidates with sufficient frequency and sort them.
+        candidates0.clear();
+        for(const Candidate& candidate: candidates[readId0].slots) {
+            if(candidate.frequency != 0 and candidate.frequency >= minFrequency) {
+                candidates0.push_back(candidate);
             }
         }
+        sort(candidates0.begin(), candidates0.end());
+
+        for(const Candidate& candidate: candidates0) {
+            const ReadId readId1 = candidate.readId1;
+            SHASTA_ASSERT(readId0 < readId1);
+            candidateAlignments.push_back(
+                OrientedReadPair(readId0, readId1, candidate.strand==0));
+        }
     }
+    candidates.clear();
+    candidates.shrink_to_fit();
+    readCandidateCount.clear();
+    readCandidateCount.shrink_to_fit();
     cout << "Found " << candidateAlignments.size() << " alignment candidates."<< endl;
     cout << "Average number of alignment candidates per oriented read is ";
     cout << (2.* double(candidateAlignments.size())) / double(orientedReadCount)  << "." << endl;
@@ -214,7 +265,8 @@ LowHash0::LowHash0(
 
     // Clean up work areas.
     buckets.remove();
-    kmerIds.remove();
+    bucketFillerPointer = 0;
+    featureHashes = 0;
 
 
 
@@ -226,57 +278,6 @@ LowHash0::LowHash0(
 
 
 
-void LowHash0::createKmerIds()
-{
-    kmerIds.createNew(
-    	largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash0-Markers"),
-        largeDataPageSize);
-    const ReadId orientedReadCount = ReadId(markers.size());
-    const ReadId readCount = orientedReadCount / 2;
-    kmerIds.beginPass1(orientedReadCount);
-    for(ReadId readId=0; readId!=readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const auto markerCount = markers.size(orientedReadId.getValue());
-            kmerIds.incrementCount(orientedReadId.getValue(), markerCount);
-        }
-    }
-    kmerIds.beginPass2();
-    kmerIds.endPass2(false);
-    const size_t batchSize = 10000;
-    setupLoadBalancing(readCount, batchSize);
-    runThreads(&LowHash0::createKmerIds, threadCount);
-}
-
-
-
-// Thread function for createKmerIds.
-void LowHash0::createKmerIds(size_t threadId)
-{
-
-    // Loop over batches assigned to this thread.
-    uint64_t begin, end;
-    while(getNextBatch(begin, end)) {
-
-        // Loop over reads assigned to this batch.
-        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
-            for(Strand strand=0; strand<2; strand++) {
-                const OrientedReadId orientedReadId(readId, strand);
-                const auto orientedReadMarkers = markers[orientedReadId.getValue()];
-
-                SHASTA_ASSERT(kmerIds.size(orientedReadId.getValue()) == orientedReadMarkers.size());
-
-                auto pointer = kmerIds.begin(orientedReadId.getValue());
-                for(const CompressedMarker& marker: orientedReadMarkers) {
-                    *pointer++ = marker.kmerId;
-                }
-            }
-        }
-    }
-}
-
-
-
 // Pass1: compute the low hashes for each oriented read
 // and prepare the buckets for filling.
 void LowHash0::pass1ThreadFunction(size_t threadId)
@@ -284,6 +285,13 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
     const int featureByteCount = int(m * sizeof(KmerId));
     const uint64_t seed = iteration * 37;
 
+    // Used by getKmerIds if the k-mer ids of
+    // the markers of an oriented read are not stored.
+    vector<KmerId> kmerIdsBuffer;
+
+    // The hashes of the features of one oriented read.
+    vector<uint64_t> hashes;
+
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -298,7 +306,7 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
 
                 vector<uint64_t>& orientedReadLowHashes = lowHashes[orientedReadId.getValue()];
                 orientedReadLowHashes.clear();
-                const size_t markerCount = kmerIds.size(orientedReadId.getValue());
+                const size_t markerCount = markers.size(orientedReadId.getValue());
 
                 // Handle the pathological case where there are fewer than m markers.
                 // This oriented read ends up in no bucket.
@@ -307,18 +315,27 @@ void LowHash0::pass1ThreadFunction(size_t threadId)
                 }
 
 
-                // Get the markers for this oriented read.
-                KmerId* kmerIdsPointer = kmerIds.begin(orientedReadId.getValue());
+                // Compute the hashes of the features of this oriented read.
+                // Features are sequences of m consecutive markers.
                 const size_t featureCount = markerCount - m + 1;
+                if(featureHashes) {
+                    featureHashes->getHashes(orientedReadId, iteration, hashes);
+                } else {
+                    const KmerId* kmerIdsPointer = markers.getKmerIds(orientedReadId.getValue(), kmerIdsBuffer);
+                    hashes.resize(featureCount);
+                    for(size_t j=0; j<featureCount; j++, kmerIdsPointer++) {
+                        hashes[j] = MurmurHash64A(kmerIdsPointer, featureByteCount, seed);
+                    }
+                }
+                SHASTA_ASSERT(hashes.size() == featureCount);
 
                 // Loop over features of this oriented read.
-                // Features are sequences of m consecutive markers.
-                for(size_t j=0; j<featureCount; j++, kmerIdsPointer++) {
-                    const uint64_t hash = MurmurHash64A(kmerIdsPointer, featureByteCount, seed);
+                for(size_t j=0; j<featureCount; j++) {
+                    const uint64_t hash = hashes[j];
                     if(hash < hashThreshold) {
                         orientedReadLowHashes.push_back(hash);
                         const uint64_t bucketId = hash & mask;
-                        buckets.incrementCountMultithreaded(bucketId);
+                        bucketFillerPointer->count(threadId, bucketId);
                     }
                 }
             }
@@ -348,21 +365,12 @@ void LowHash0::pass2ThreadFunction(size_t threadId)
 
                 for(const uint64_t hash: orientedReadLowHashes) {
                     const uint64_t bucketId = hash & mask;
-                    buckets.storeMultithreaded(bucketId, BucketEntry(orientedReadId, hash));
-
-                    // Update statistics for this read.
-                    const uint64_t bucketSize = buckets.size(bucketId);
-                    if(bucketSize < minBucketSize) {
-                        ++readLowHashStatistics[readId][0];
-                    } else if(bucketSize > maxBucketSize) {
-                        ++readLowHashStatistics[readId][2];
-                    } else {
-                        ++readLowHashStatistics[readId][1];
-                    }
+                    bucketFillerPointer->store(threadId, bucketId, BucketEntry(orientedReadId, hash));
                 }
             }
         }
     }
+    bucketFillerPointer->flush(threadId);
 }
 
 
@@ -371,12 +379,6 @@ void LowHash0::pass2ThreadFunction(size_t threadId)
 void LowHash0::pass3ThreadFunction(size_t threadId)
 {
 
-    // The alignment candidates found at this iteration for a single read.
-    vector<Candidate> newCandidates;
-
-    // The merged candidates for a single readId0.
-    vector<Candidate> mergedCandidates;
-
     ThreadStatistics& thisThreadStatistics = threadStatistics[threadId];
     thisThreadStatistics.clear();
 
@@ -386,7 +388,7 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
 
         // Loop over reads assigned to this batch.
         for(ReadId readId0=ReadId(begin); readId0!=ReadId(end); readId0++) {
-            newCandidates.clear();
+            CandidateTable& candidateTable = candidates[readId0];
 
             // Loop over two strands.
             for(Strand strand0=0; strand0<2; strand0++) {
@@ -401,6 +403,16 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
                     // Loop over oriented read ids in the bucket corresponding to this hash.
                     const uint64_t bucketId = hash & mask;
                     const MemoryAsContainer<BucketEntry> bucket = buckets[bucketId];
+
+                    // Update statistics for this read.
+                    if(bucket.size() < minBucketSize) {
+                        ++readLowHashStatistics[readId0][0];
+                    } else if(bucket.size() > maxBucketSize) {
+                        ++readLowHashStatistics[readId0][2];
+                    } else {
+                        ++readLowHashStatistics[readId0][1];
+                    }
+
                     if(bucket.size() < max(size_t(2), minBucketSize)) {
                         continue;
                     }
@@ -419,126 +431,136 @@ void LowHash0::pass3ThreadFunction(size_t threadId)
                             continue;
                         }
 
-                        // Add it to our work area.
+                        // Add it to the candidates of this read.
                         const bool isSameStrand = orientedReadId1.getStrand() == strand0;
-                        newCandidates.push_back(Candidate(readId1, isSameStrand? 0 : 1));
+                        if(candidateTable.add(readId1, isSameStrand? 0 : 1, minFrequency)) {
+                            __sync_fetch_and_add(&readCandidateCount[readId0], 1);
+                            __sync_fetch_and_add(&readCandidateCount[readId1], 1);
+                        }
                     }
                 }
             }
 
-            // Sort the candidates found during this iteration.
-            sort(newCandidates.begin(), newCandidates.end());
+            // Update thread statistics.
+            thisThreadStatistics.total += candidateTable.size;
+            thisThreadStatistics.capacity += candidateTable.slots.size();
+            thisThreadStatistics.highFrequency += candidateTable.highFrequencyCount;
+        }
+    }
+}
 
-            // Merge the contents of the work area
-            // with the candidates previously stored.
-            vector<Candidate>& storedCandidates = candidates[readId0];
-            mergedCandidates.clear();
-            merge(storedCandidates, newCandidates, mergedCandidates);
 
-            // Store the merged candidates in place of the old ones.
-            storedCandidates.resize(mergedCandidates.size());
-            copy(mergedCandidates.begin(), mergedCandidates.end(), storedCandidates.begin());
 
-            // Update thread statistics.
-            thisThreadStatistics.total += storedCandidates.size();
-            thisThreadStatistics.capacity += storedCandidates.capacity();
-            for(const Candidate& candidate: storedCandidates) {
-                if(candidate.frequency >= minFrequency) {
-                    ++thisThreadStatistics.highFrequency;
-                }
-            }
-        }
+// Add a candidate to a CandidateTable, or increment its frequency
+// if already present.
+bool LowHash0::CandidateTable::add(ReadId readId1, Strand strand, size_t minFrequency)
+{
+    // Keep the load factor at most 3/4.
+    if(4 * (uint64_t(size) + 1) > 3 * slots.size()) {
+        grow();
     }
+
+    Candidate& candidate = slots[findSlot(readId1, strand)];
+    if(candidate.frequency == 0) {
+        candidate = Candidate(readId1, strand);
+        ++size;
+    } else if(candidate.frequency < std::numeric_limits<uint16_t>::max()) {
+        ++candidate.frequency;
+    } else {
+        return false;
+    }
+    if(candidate.frequency == max(minFrequency, size_t(1))) {
+        ++highFrequencyCount;
+        return true;
+    }
+    return false;
 }
 
 
 
-// Merge two sorted vectors of candidates into a third one.
-// The input vectors can be sorted but can have duplicates.
-// During merging, when two candidates with the same readId1
-// and strand are found, they are combined, adding up their frequency.
-// This is used by pass4ThreadFunction.
-void LowHash0::merge(
-    const vector<LowHash0::Candidate>& x0,
-    const vector<LowHash0::Candidate>& x1,
-    vector<LowHash0::Candidate>& y
-    )
+// Adaptive mode: decide whether to stop after the current iteration.
+// We stop if the marginal yield of this iteration, that is
+// the fraction of the candidates found so far that were found
+// at this iteration, is less than minNewCandidateFraction,
+// or if the number of reads with less than minCandidatesPerRead
+// candidates did not decrease during this iteration (or is zero).
+// Some reads never reach minCandidatesPerRead (contaminants, junk,
+// or reads that overlap nothing), so waiting for all reads
+// to reach it would never stop.
+// Reads that cannot have candidates (palindromic reads and reads
+// with fewer than m markers) are ignored.
+// Iterations before the first candidates are found
+// (the first minFrequency-1 iterations) are not used for this check.
+bool LowHash0::isSaturated(uint64_t newCandidateCount, uint64_t highFrequency)
 {
-    using Iterator = vector<LowHash0::Candidate>::const_iterator;
-    Iterator begin0 = x0.begin();
-    Iterator begin1 = x1.begin();
-    Iterator end0 = x0.end();
-    Iterator end1 = x1.end();
-
-
-
-    // Merge loop..
-    // At each step, we find the lowest of the two candidates
-    // currently pointed by the two iterators (ties allowed and are ok).
-    // If the merged vector is not empty and ends with an entry that compares equal,
-    // increment its frequency. Otherwise, just create a new entry in the merged vector.
-    Iterator it0 = begin0;
-    Iterator it1 = begin1;
-    while(true) {
-
-        // If we reached the end of x0, process the remaining portion of x1,
-        // then exit the merge loop.
-        if(it0 == end0) {
-            for(; it1!=end1; ++it1) {
-                if(!y.empty() && y.back() == *it1) {
-                    ++y.back().frequency = uint16_t(y.back().frequency + it1->frequency);
-                } else {
-                    y.push_back(*it1);
-                }
-            }
-            break;
+    if(minNewCandidateFraction > 0. and highFrequency > 0) {
+        const double newCandidateFraction = double(newCandidateCount) / double(highFrequency);
+        cout << "Fraction of new alignment candidates at this iteration: " <<
+            newCandidateFraction << endl;
+        if(newCandidateFraction < minNewCandidateFraction) {
+            cout << "This is less than minNewCandidateFraction " <<
+                minNewCandidateFraction << "." << endl;
+            return true;
         }
+    }
 
-        // If we reached the end of x1, process the remaining portion of x0,
-        // then exit the merge loop.
-        if(it1 == end1) {
-            for(; it0!=end0; ++it0) {
-                if(!y.empty() && y.back() == *it0) {
-                    ++y.back().frequency = uint16_t(y.back().frequency + it0->frequency);
-                } else {
-                    y.push_back(*it0);
-                }
+    if(minCandidatesPerRead > 0 and highFrequency > 0) {
+        uint64_t readsBelowTarget = 0;
+        for(ReadId readId=0; readId<ReadId(readCandidateCount.size()); readId++) {
+            if(readFlags[readId].isPalindromic) {
+                continue;
             }
-            break;
-        }
-
-        // If we get here, neither iterator is at its end.
-        // Both iterators can be safely dereferenced.
-        SHASTA_ASSERT(it0 != end0);
-        SHASTA_ASSERT(it1 != end1);
-
-        // If the current x1 entry is not less than the current x0 entry,
-        // process the current x0 entry.
-        if(!(*it1 < *it0)) {
-            if(!y.empty() && y.back() == *it0) {
-                y.back().frequency  = uint16_t(y.back().frequency + it0->frequency);
-            } else {
-                y.push_back(*it0);
+            if(markers.size(OrientedReadId(readId, 0).getValue()) < m) {
+                continue;
             }
-            ++it0;
-        }
-
-        // If the current x0 entry is not less than the current x1 entry,
-        // process the current x1 entry.
-        else if(!(*it0 < *it1)) {
-            if(!y.empty() && y.back() == *it1) {
-                ++y.back().frequency = uint16_t(y.back().frequency + it1->frequency);
-            } else {
-                y.push_back(*it1);
+            if(readCandidateCount[readId] < minCandidatesPerRead) {
+                ++readsBelowTarget;
             }
-            ++it1;
         }
+        cout << "Number of reads with less than " << minCandidatesPerRead <<
+            " alignment candidates: " << readsBelowTarget << endl;
+        if(readsBelowTarget == 0) {
+            return true;
+        }
+        if(readsBelowTarget >= previousReadsBelowTarget) {
+            cout << "This did not decrease during this iteration." << endl;
+            return true;
+        }
+        previousReadsBelowTarget = readsBelowTarget;
+    }
+
+    return false;
+}
 
-        // The above covers all cases.
-        else {
-            SHASTA_ASSERT(0);
+
+
+// Find the slot containing a candidate, or the empty slot
+// where it should be stored if not present.
+uint64_t LowHash0::CandidateTable::findSlot(ReadId readId1, Strand strand) const
+{
+    const uint64_t mask = slots.size() - 1;
+    const uint64_t key = (uint64_t(readId1) << 1) | uint64_t(strand);
+    for(uint64_t slot = (key * 0x9E3779B97F4A7C15ULL) >> 32; ; ++slot) {
+        slot &= mask;
+        const Candidate& candidate = slots[slot];
+        if(candidate.frequency == 0 or
+            (candidate.readId1 == readId1 and candidate.strand == strand)) {
+            return slot;
         }
+    }
+}
+
 
+
+// Double the number of slots and reinsert the candidates.
+void LowHash0::CandidateTable::grow()
+{
+    vector<Candidate> oldSlots(max(size_t(8), 2 * slots.size()));
+    oldSlots.swap(slots);
+    for(const Candidate& candidate: oldSlots) {
+        if(candidate.frequency != 0) {
+            slots[findSlot(candidate.readId1, candidate.strand)] = candidate;
+        }
     }
 }
 
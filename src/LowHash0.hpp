@@ -2,13 +2,19 @@
 #define SHASTA_LOW_HASH0_HPP
 
 // Shasta
-#include "Marker.hpp"
+#include "Markers.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
 #include "OrientedReadPair.hpp"
 #include "ReadId.hpp"
 
+// Standard library.
+#include <limits>
+#include "memory.hpp"
+
 namespace shasta {
+    template<class Entry> class BucketFiller;
+    class FeatureHashes;
     class LowHash0;
     class ReadFlags;
 }
@@ -26,15 +32,18 @@ public:
     LowHash0(
         size_t m,                       // Number of consecutive markers that define a feature.
         double hashFraction,
-        size_t minHashIterationCount,   // Number of minHash iterations.
+        size_t minHashIterationCount,   // Number of minHash iterations, or maximum number if adaptive.
         size_t log2MinHashBucketCount,  // Base 2 log of number of buckets for minHash.
         size_t minBucketSize,           // The minimum size for a bucket to be used.
         size_t maxBucketSize,           // The maximum size for a bucket to be used.
         size_t minFrequency,            // Minimum number of minHash hits for a pair to be considered a candidate.
+        bool hashFeaturesOnce,          // If set, use FeatureHashes to compute feature hashes only once.
+        double minNewCandidateFraction, // Adaptive mode: stop when an iteration finds fewer new candidates than this fraction.
+        size_t minCandidatesPerRead,    // Adaptive mode: stop when the number of reads with fewer candidates stops decreasing.
         size_t threadCount,
         const MemoryMapped::Vector<KmerInfo>& kmerTable,
         const MemoryMapped::Vector<ReadFlags>& readFlags,
-        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>&,
+        const Markers&,
         MemoryMapped::Vector<OrientedReadPair>&,
         MemoryMapped::Vector< array<uint64_t, 3> >& readLowHashStatistics,
         const string& largeDataFileNamePrefix,
@@ -49,27 +58,25 @@ private:
     size_t minBucketSize;           // The minimum size for a bucket to be used.
     size_t maxBucketSize;           // The maximum size for a bucket to be used.
     size_t minFrequency;            // Minimum number of minHash hits for a pair to be considered a candidate.
+    double minNewCandidateFraction;
+    size_t minCandidatesPerRead;
     size_t threadCount;
     const MemoryMapped::Vector<KmerInfo>& kmerTable;
     const MemoryMapped::Vector<ReadFlags>& readFlags;
-    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
+    const Markers& markers;
     MemoryMapped::Vector< array<uint64_t, 3> > &readLowHashStatistics;
     const string& largeDataFileNamePrefix;
     size_t largeDataPageSize;
 
-    // Vectors containing only the k-mer ids of all markers
-    // for all oriented reads.
-    // Indexed by OrientedReadId.getValue().
-    // This is used to speed up the computation of hash functions.
-    MemoryMapped::VectorOfVectors<KmerId, uint64_t> kmerIds;
-    void createKmerIds();
-    void createKmerIds(size_t threadId);
-
     // The current MinHash iteration.
     // This is used to compute a different MurmurHash function
     // at each iteration.
     size_t iteration;
 
+    // If not null, the base hashes of all features, computed once
+    // and used to compute the feature hashes at each iteration.
+    shared_ptr<FeatureHashes> featureHashes;
+
     // The low hashes of each oriented read, at the current LowHash0 iteration.
     // Indexed by OrientedReadId::getValue().
     uint64_t hashThreshold;
@@ -96,6 +103,10 @@ private:
     };
     MemoryMapped::VectorOfVectors<BucketEntry, uint64_t> buckets;
 
+    // The BucketFiller used to fill the buckets.
+    // It is created by the constructor and used by the thread functions.
+    BucketFiller<BucketEntry>* bucketFillerPointer = 0;
+
 
 
     // Class used to store candidate pairs.
@@ -111,7 +122,9 @@ private:
             Strand strand) :
             readId1(readId1), strand(uint8_t(strand)), frequency(1) {}
 
-        Candidate() {}
+        // A default constructed candidate has frequency 0
+        // and is used to mark empty slots in a CandidateTable.
+        Candidate() : readId1(0), strand(0), frequency(0) {}
 
         // Comparison operators.
         bool operator==(const Candidate& that) const
@@ -127,24 +140,55 @@ private:
 
 
 
-    // Merge two sorted vectors of candidates into a third one.
-    // The input vectors can be sorted but can have duplicates.
-    // During merging, when two candidates with the same readId1
-    // and strand are found, they are combined, adding up their frequency.
-    // This is used by pass4ThreadFunction.
-    static void merge(
-        const vector<Candidate>&,
-        const vector<Candidate>&,
-        vector<Candidate>&
-        );
-
-
-
     // The alignment candidates for each read.
     // Indexed by readId0, the read id of the lower numbered read in the pair.
     // We only store pairs with readId1>readId0.
-    // For each readId0, this is kept sorted.
-    vector< vector<Candidate> > candidates;
+    // The candidates of each readId0 are stored in an open addressing
+    // hash table with linear probing, keyed by (readId1, strand).
+    // The frequency of a candidate is incremented in place
+    // each time it is found, and the candidates are only sorted
+    // once, when the final candidate alignments are stored.
+    // During pass 3 each readId0 is processed by a single thread,
+    // so no locking is needed.
+    class CandidateTable {
+    public:
+
+        // Add a candidate, or increment its frequency if already present.
+        // Also keeps track of the number of candidates
+        // with frequency at least minFrequency.
+        // Returns true if the frequency of the candidate
+        // just reached minFrequency.
+        bool add(ReadId readId1, Strand strand, size_t minFrequency);
+
+        // The slots of the hash table. The number of slots
+        // is zero or a power of 2. Empty slots have frequency 0.
+        vector<Candidate> slots;
+
+        // The number of candidates stored.
+        uint32_t size = 0;
+
+        // The number of candidates with frequency at least minFrequency.
+        uint32_t highFrequencyCount = 0;
+
+    private:
+        uint64_t findSlot(ReadId readId1, Strand strand) const;
+        void grow();
+    };
+    vector<CandidateTable> candidates;
+
+    // The number of candidates with frequency at least minFrequency
+    // involving each read, counting pairs where it is readId0 or readId1.
+    // Indexed by ReadId. Updated atomically during pass 3.
+    // This is used to decide when to stop iterating in adaptive mode.
+    vector<uint32_t> readCandidateCount;
+
+    // The number of reads with less than minCandidatesPerRead candidates
+    // after the last iteration that found any candidates.
+    uint64_t previousReadsBelowTarget = std::numeric_limits<uint64_t>::max();
+
+    // Return true if the LowHash0 iteration loop should stop
+    // after the current iteration. Only used in adaptive mode.
+    bool isSaturated(uint64_t newCandidateCount, uint64_t highFrequency);
 
 
 
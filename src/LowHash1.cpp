@@ -1,6 +1,8 @@
 // Shasta.
 #include "LowHash1.hpp"
 #include "AlignmentCandidates.hpp"
+#include "BucketFiller.hpp"
+#include "FeatureHashes.hpp"
 #include "Marker.hpp"
 using namespace shasta;
 
@@ -18,10 +20,11 @@ LowHash1::LowHash1(
     size_t minBucketSize,           // The minimum size for a bucket to be used.
     size_t maxBucketSize,           // The maximum size for a bucket to be used.
     size_t minFrequency,            // Minimum number of minHash hits for a pair to be considered a candidate.
+    bool hashFeaturesOnce,
     size_t threadCountArgument,
     const MemoryMapped::Vector<KmerInfo>& kmerTable,
     const MemoryMapped::Vector<ReadFlags>& readFlags,
-    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    const Markers& markers,
     AlignmentCandidates& candidates,
     const string& largeDataFileNamePrefix,
     size_t largeDataPageSize
@@ -78,11 +81,6 @@ LowHash1::LowHash1(
     cout << "Estimated number of low hashes per iteration " << totalLowHashCountEstimate << endl;
     cout << "Estimated load factor " << double(totalLowHashCountEstimate)/double(bucketCount) << endl;
 
-    // Create vectors containing only the k-mer ids of all markers.
-    // This is used to speed up the computation of hash functions.
-    cout << timestamp << "Creating kmer ids for oriented reads." << endl;
-    createKmerIds();
-
     // Compute the threshold for a hash value to be considered low.
     hashThreshold = uint64_t(hashFraction * double(std::numeric_limits<uint64_t>::max()));
 
@@ -95,6 +93,17 @@ LowHash1::LowHash1(
     buckets.createNew(
             largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash-Buckets"),
             largeDataPageSize);
+    BucketFiller<BucketEntry> bucketFiller(
+        log2MinHashBucketCount, threadCount,
+        largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash-StagedBucketEntries"),
+        largeDataPageSize);
+    bucketFillerPointer = &bucketFiller;
+    if(hashFeaturesOnce) {
+        featureHashes = make_shared<FeatureHashes>(
+            m, threadCount, readFlags, markers,
+            largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash-FeatureHashes"),
+            largeDataPageSize);
+    }
     lowHashes.resize(orientedReadCount);
     threadCommonFeatures.resize(threadCount);
     for(size_t threadId=0; threadId!=threadCount; threadId++) {
@@ -114,17 +123,19 @@ LowHash1::LowHash1(
 
         // Compute the low hashes for each oriented read
         // and count the number of low hash features in each bucket.
-        buckets.clear();
-        buckets.beginPass1(bucketCount);
+        bucketFiller.beginCount();
         size_t batchSize = 10000;
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash1::computeHashesThreadFunction, threadCount);
 
         // Fill the buckets.
-        buckets.beginPass2();
+        // The BucketFiller first partitions the bucket entries
+        // by the most significant bits of the bucket id,
+        // then fills each partition of the buckets independently.
+        bucketFiller.beginStore();
         setupLoadBalancing(readCount, batchSize);
         runThreads(&LowHash1::fillBucketsThreadFunction, threadCount);
-        buckets.endPass2(false, false);
+        bucketFiller.fill(buckets);
         cout << "Load factor at this iteration " <<
             double(buckets.totalSize()) / double(buckets.size()) << endl;
         computeBucketHistogram();
@@ -163,7 +174,8 @@ LowHash1::LowHash1(
 
     // Clean up.
     buckets.remove();
-    kmerIds.remove();
+    bucketFillerPointer = 0;
+    featureHashes = 0;
     lowHashes.clear();
     commonFeatures.remove();
 
@@ -175,57 +187,6 @@ LowHash1::LowHash1(
 
 
 
-void LowHash1::createKmerIds()
-{
-    kmerIds.createNew(
-        largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-LowHash-Markers"),
-        largeDataPageSize);
-    const ReadId orientedReadCount = ReadId(markers.size());
-    const ReadId readCount = orientedReadCount / 2;
-    kmerIds.beginPass1(orientedReadCount);
-    for(ReadId readId=0; readId!=readCount; readId++) {
-        for(Strand strand=0; strand<2; strand++) {
-            const OrientedReadId orientedReadId(readId, strand);
-            const auto markerCount = markers.size(orientedReadId.getValue());
-            kmerIds.incrementCount(orientedReadId.getValue(), markerCount);
-        }
-    }
-    kmerIds.beginPass2();
-    kmerIds.endPass2(false);
-    const size_t batchSize = 10000;
-    setupLoadBalancing(readCount, batchSize);
-    runThreads(&LowHash1::createKmerIds, threadCount);
-}
-
-
-
-// Thread function for createKmerIds.
-void LowHash1::createKmerIds(size_t threadId)
-{
-
-    // Loop over batches assigned to this thread.
-    uint64_t begin, end;
-    while(getNextBatch(begin, end)) {
-
-        // Loop over reads assigned to this batch.
-        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
-            for(Strand strand=0; strand<2; strand++) {
-                const OrientedReadId orientedReadId(readId, strand);
-                const auto orientedReadMarkers = markers[orientedReadId.getValue()];
-
-                SHASTA_ASSERT(kmerIds.size(orientedReadId.getValue()) == orientedReadMarkers.size());
-
-                auto pointer = kmerIds.begin(orientedReadId.getValue());
-                for(const CompressedMarker& marker: orientedReadMarkers) {
-                    *pointer++ = marker.kmerId;
-                }
-            }
-        }
-    }
-}
-
-
-
 // Thread function to compute the low hashes for each oriented read
 // and count the number of entries in each bucket.
 void LowHash1::computeHashesThreadFunction(size_t threadId)
@@ -233,6 +194,13 @@ void LowHash1::computeHashesThreadFunction(size_t threadId)
     const int featureByteCount = int(m * sizeof(KmerId));
     const uint64_t seed = iteration * 37;
 
+    // Used by getKmerIds if the k-mer ids of
+    // the markers of an oriented read are not stored.
+    vector<KmerId> kmerIdsBuffer;
+
+    // The hashes of the features of one oriented read.
+    vector<uint64_t> hashes;
+
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -247,7 +215,7 @@ void LowHash1::computeHashesThreadFunction(size_t threadId)
 
                 vector< pair<uint64_t, uint32_t> >& orientedReadLowHashes = lowHashes[orientedReadId.getValue()];
                 orientedReadLowHashes.clear();
-                const size_t markerCount = kmerIds.size(orientedReadId.getValue());
+                const size_t markerCount = markers.size(orientedReadId.getValue());
 
                 // Handle the pathological case where there are fewer than m markers.
                 // This oriented read ends up in no bucket.
@@ -255,18 +223,27 @@ void LowHash1::computeHashesThreadFunction(size_t threadId)
                     continue;
                 }
 
-                // Get the markers for this oriented read.
-                KmerId* kmerIdsPointer = kmerIds.begin(orientedReadId.getValue());
+                // Compute the hashes of the features of this oriented read.
+                // Features are sequences of m consecutive markers.
                 const size_t featureCount = markerCount - m + 1;
+                if(featureHashes) {
+                    featureHashes->getHashes(orientedReadId, iteration, hashes);
+                } else {
+                    const KmerId* kmerIdsPointer = markers.getKmerIds(orientedReadId.getValue(), kmerIdsBuffer);
+                    hashes.resize(featureCount);
+                    for(size_t j=0; j<featureCount; j++, kmerIdsPointer++) {
+                        hashes[j] = MurmurHash64A(kmerIdsPointer, featureByteCount, seed);
+                    }
+                }
+                SHASTA_ASSERT(hashes.size() == featureCount);
 
                 // Loop over features of this oriented read.
-                // Features are sequences of m consecutive markers.
-                for(size_t j=0; j<featureCount; j++, kmerIdsPointer++) {
-                    const uint64_t hash = MurmurHash64A(kmerIdsPointer, featureByteCount, seed);
+                for(size_t j=0; j<featureCount; j++) {
+                    const uint64_t hash = hashes[j];
                     if(hash < hashThreshold) {
                         orientedReadLowHashes.push_back(make_pair(hash, j));
                         const uint64_t bucketId = hash & mask;
-                        buckets.incrementCountMultithreaded(bucketId);
+                        bucketFillerPointer->count(threadId, bucketId);
                     }
                 }
             }
@@ -298,11 +275,12 @@ void LowHash1::fillBucketsThreadFunction(size_t threadId)
                     const uint64_t hash = p.first;
                     const uint64_t bucketId = hash & mask;
                     const uint32_t ordinal = p.second;
-                    buckets.storeMultithreaded(bucketId, BucketEntry(orientedReadId, ordinal));
+                    bucketFillerPointer->store(threadId, bucketId, BucketEntry(orientedReadId, ordinal));
                 }
             }
         }
     }
+    bucketFillerPointer->flush(threadId);
 }
 
 
@@ -367,6 +345,11 @@ void LowHash1::scanBucketsThreadFunction(size_t threadId)
 
     const uint64_t mLocal = uint64_t(m);
 
+    // Used by getKmerIds if the k-mer ids of
+    // the markers of an oriented read are not stored.
+    vector<KmerId> kmerIdsBuffer0;
+    vector<KmerId> kmerIdsBuffer1;
+
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
@@ -389,9 +372,9 @@ void LowHash1::scanBucketsThreadFunction(size_t threadId)
                 const ReadId readId0 = orientedReadId0.getReadId();
                 const Strand strand0 = orientedReadId0.getStrand();
                 const uint32_t ordinal0 = feature0.ordinal;
-                const auto allKmerIds0 = kmerIds[orientedReadId0.getValue()];
-                const auto featureKmerIds0 = allKmerIds0.begin() + ordinal0;
-                const uint32_t markerCount0 = uint32_t(allKmerIds0.size());
+                const KmerId* featureKmerIds0 =
+                    markers.getKmerIds(orientedReadId0.getValue(), ordinal0, mLocal, kmerIdsBuffer0);
+                const uint32_t markerCount0 = uint32_t(markers.size(orientedReadId0.getValue()));
 
                 for(const BucketEntry& feature1: bucket) {
                     const OrientedReadId orientedReadId1 = feature1.orientedReadId;
@@ -404,9 +387,9 @@ void LowHash1::scanBucketsThreadFunction(size_t threadId)
 
                     const Strand strand1 = orientedReadId1.getStrand();
                     const uint32_t ordinal1 = feature1.ordinal;
-                    const auto allKmerIds1 = kmerIds[orientedReadId1.getValue()];
-                    const auto featureKmerIds1 = allKmerIds1.begin() + ordinal1;
-                    const uint32_t markerCount1 = uint32_t(allKmerIds1.size());
+                    const KmerId* featureKmerIds1 =
+                        markers.getKmerIds(orientedReadId1.getValue(), ordinal1, mLocal, kmerIdsBuffer1);
+                    const uint32_t markerCount1 = uint32_t(markers.size(orientedReadId1.getValue()));
 
                     // If the k-mers are not the same, this is a collision. Discard.
                     if(not std::equal(featureKmerIds0, featureKmerIds0+mLocal, featureKmerIds1)) {
@@ -454,7 +437,7 @@ void LowHash1::gatherCommonFeatures()
     commonFeatures.createNew(
             largeDataFileNamePrefix.empty() ? "" : (largeDataFileNamePrefix + "tmp-CommonFeatures"),
             largeDataPageSize);
-    commonFeatures.beginPass1(kmerIds.size()/2);
+    commonFeatures.beginPass1(markers.size()/2);
     runThreads(&LowHash1::gatherCommonFeaturesPass1, threadCount);
     commonFeatures.beginPass2();
     runThreads(&LowHash1::gatherCommonFeaturesPass2, threadCount);
@@ -489,7 +472,7 @@ void LowHash1::gatherCommonFeaturesPass2(size_t threadId)
 // Each thread stores the alignment candidates it finds in its own vector.
 void LowHash1::processCommonFeatures()
 {
-    const uint64_t readCount = kmerIds.size() / 2;
+    const uint64_t readCount = markers.size() / 2;
     const uint64_t batchSize = 1000;
 
     // Prepare areas where each thread will store what it finds.
@@ -660,8 +643,8 @@ void LowHash1::processCommonFeaturesThreadFunction(size_t threadId)
                         int32_t(feature.ordinals[1]) - int32_t(feature.ordinals[0]) << "\n";
                 }
                 cout << "Marker count " <<
-                    kmerIds[OrientedReadId(readId0, 0).getValue()].size() << " " <<
-                    kmerIds[OrientedReadId(readId1, 0).getValue()].size() << ":\n";
+                    markers.size(OrientedReadId(readId0, 0).getValue()) << " " <<
+                    markers.size(OrientedReadId(readId1, 0).getValue()) << ":\n";
                 */
 
                 // This streak generates an alignment candidate
@@ -3,6 +3,7 @@
 
 // Shasta
 #include "Kmer.hpp"
+#include "Markers.hpp"
 #include "MemoryMappedVectorOfVectors.hpp"
 #include "MultithreadedObject.hpp"
 #include "OrientedReadPair.hpp"
@@ -13,6 +14,8 @@
 
 namespace shasta {
     class AlignmentCandidates;
+    template<class Entry> class BucketFiller;
+    class FeatureHashes;
     class LowHash1;
     class CompressedMarker;
     class OrientedReadPair;
@@ -35,10 +38,11 @@ public:
         size_t minBucketSize,           // The minimum size for a bucket to be used.
         size_t maxBucketSize,           // The maximum size for a bucket to be used.
         size_t minFrequency,            // Minimum number of minHash hits for a pair to be considered a candidate.
+        bool hashFeaturesOnce,          // If set, use FeatureHashes to compute feature hashes only once.
         size_t threadCount,
         const MemoryMapped::Vector<KmerInfo>& kmerTable,
         const MemoryMapped::Vector<ReadFlags>& readFlags,
-        const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>&,
+        const Markers&,
         AlignmentCandidates& candidates,
         const string& largeDataFileNamePrefix,
         size_t largeDataPageSize
@@ -55,19 +59,11 @@ private:
     size_t threadCount;
     const MemoryMapped::Vector<KmerInfo>& kmerTable;
     const MemoryMapped::Vector<ReadFlags>& readFlags;
-    const MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
+    const Markers& markers;
     AlignmentCandidates& candidates;
     const string& largeDataFileNamePrefix;
     size_t largeDataPageSize;
 
-    // Vectors containing only the k-mer ids of all markers
-    // for all oriented reads.
-    // Indexed by OrientedReadId.getValue().
-    // This is used to speed up the computation of hash functions.
-    MemoryMapped::VectorOfVectors<KmerId, uint64_t> kmerIds;
-    void createKmerIds();
-    void createKmerIds(size_t threadId);
-
     // The mask used to compute to compute the bucket
     // corresponding to a hash value.
     uint64_t mask;
@@ -80,6 +76,10 @@ private:
     // at each iteration.
     size_t iteration;
 
+    // If not null, the base hashes of all features, computed once
+    // and used to compute the feature hashes at each iteration.
+    shared_ptr<FeatureHashes> featureHashes;
+
     // The low hashes of each oriented read and the ordinals at
     // which the corresponding feature occurs.
     // This is recomputed at each iteration.
@@ -103,6 +103,10 @@ private:
     };
     MemoryMapped::VectorOfVectors<BucketEntry, uint64_t> buckets;
 
+    // The BucketFiller used to fill the buckets.
+    // It is created by the constructor and used by the thread functions.
+    BucketFiller<BucketEntry>* bucketFillerPointer = 0;
+
 
     // Compute a histogram of the number of entries in each histogram.
     void computeBucketHistogram();
@@ -1,6 +1,8 @@
 // shasta.
 #include "MarkerFinder.hpp"
-#include "LongBaseSequence.hpp"
+#include "KmerIterator.hpp"
+#include "Markers.hpp"
+#include "MurmurHash2.hpp"
 #include "ReadId.hpp"
 #include "timestamp.hpp"
 using namespace shasta;
@@ -14,13 +16,21 @@ MarkerFinder::MarkerFinder(
     size_t k,
     const MemoryMapped::Vector<KmerInfo>& kmerTable,
     LongBaseSequences& reads,
-    MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+    Markers& markers,
+    bool storeStrand1,
+    uint64_t minimizerWindow,
+    uint64_t markerHashThreshold,
+    bool singlePass,
     size_t threadCountArgument) :
     MultithreadedObject(*this),
     k(k),
     kmerTable(kmerTable),
     reads(reads),
     markers(markers),
+    storeStrand1(storeStrand1),
+    minimizerWindow(minimizerWindow),
+    markerHashThreshold(markerHashThreshold),
+    singlePass(singlePass),
     threadCount(threadCountArgument)
 {
     // Initial message.
@@ -32,16 +42,44 @@ MarkerFinder::MarkerFinder(
         threadCount = std::thread::hardware_concurrency();
     }
 
-    const size_t batchSize = 100000;
-    markers.beginPass1(2 * reads.size());
-    setupLoadBalancing(reads.size(), batchSize);
-    pass = 1;
-    runThreads(&MarkerFinder::threadFunction, threadCount);
-    markers.beginPass2();
-    markers.endPass2(false);
-    setupLoadBalancing(reads.size(), batchSize);
-    pass = 2;
-    runThreads(&MarkerFinder::threadFunction, threadCount);
+    batchSize = 10000;
+    markers.kmerIds.beginPass1((storeStrand1 ? 2 : 1) * reads.size());
+    markers.positionOffset.resize(reads.size());
+
+    if(singlePass) {
+
+        // Find the markers of each batch of reads.
+        const uint64_t batchCount = (reads.size() + batchSize - 1) / batchSize;
+        batchMarkers.resize(batchCount);
+        setupLoadBalancing(reads.size(), batchSize);
+        runThreads(&MarkerFinder::findMarkersThreadFunction, threadCount);
+
+        // Allocate space for the markers of all oriented reads
+        // and copy them into place.
+        markers.kmerIds.beginPass2();
+        markers.kmerIds.endPass2(false);
+        markers.positions.resize(markers.kmerIds.totalSize());
+        setupLoadBalancing(batchCount, 1);
+        runThreads(&MarkerFinder::storeMarkersThreadFunction, threadCount);
+        batchMarkers.clear();
+        batchMarkers.shrink_to_fit();
+
+    } else {
+
+        // Pass 1: count the markers of each read.
+        pass = 1;
+        setupLoadBalancing(reads.size(), batchSize);
+        runThreads(&MarkerFinder::threadFunction, threadCount);
+
+        // Pass 2: allocate space for the markers of all oriented reads,
+        // then find the markers again and store them.
+        markers.kmerIds.beginPass2();
+        markers.kmerIds.endPass2(false);
+        markers.positions.resize(markers.kmerIds.totalSize());
+        pass = 2;
+        setupLoadBalancing(reads.size(), batchSize);
+        runThreads(&MarkerFinder::threadFunction, threadCount);
+    }
 
     // Final message.
     const auto tEnd = std::chrono::steady_clock::now();
@@ -54,70 +92,260 @@ MarkerFinder::MarkerFinder(
 void MarkerFinder::threadFunction(size_t threadId)
 {
 
+    // Work areas for the markers of a single read.
+    vector<CompressedMarker> readMarkers;
+    MinimizerWorkArea minimizerWorkArea;
+
     // Loop over batches assigned to this thread.
     uint64_t begin, end;
     while(getNextBatch(begin, end)) {
 
         // Loop over reads of this batch.
         for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
-
-            const LongBaseSequenceView read = reads[readId];
-            size_t markerCount = 0; // For this read.
-            CompressedMarker* markerPointerStrand0 = 0;
-            CompressedMarker* markerPointerStrand1 = 0;
-            if(pass == 2) {
-                markerPointerStrand0 = markers.begin(OrientedReadId(readId, 0).getValue());
-                markerPointerStrand1 = markers.end(OrientedReadId(readId, 1).getValue()) - 1ULL;
+            readMarkers.clear();
+            const uint64_t markerCount = findReadMarkers(readId, readMarkers, minimizerWorkArea);
+            if(pass == 1) {
+                countReadMarkers(readId, markerCount);
+            } else {
+                SHASTA_ASSERT(markers.kmerIds.size(storeStrand1 ?
+                    OrientedReadId(readId, 0).getValue() : readId) == markerCount);
+                storeReadMarkers(readId, readMarkers.data());
             }
+        }
+    }
+
+}
+
+
+
+void MarkerFinder::findMarkersThreadFunction(size_t threadId)
+{
+
+    // Work area used when finding minimizer markers.
+    MinimizerWorkArea minimizerWorkArea;
+
+    // Loop over batches assigned to this thread.
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        vector<CompressedMarker>& thisBatchMarkers = batchMarkers[begin / batchSize];
+
+        // Loop over reads of this batch.
+        for(ReadId readId=ReadId(begin); readId!=ReadId(end); readId++) {
+            const uint64_t markerCount = findReadMarkers(readId, thisBatchMarkers, minimizerWorkArea);
+            countReadMarkers(readId, markerCount);
+        }
+    }
+
+}
+
+
+
+uint64_t MarkerFinder::findReadMarkers(
+    ReadId readId,
+    vector<CompressedMarker>& readMarkers,
+    MinimizerWorkArea& minimizerWorkArea) const
+{
+    const LongBaseSequenceView read = reads[readId];
+
+    if(minimizerWindow) {
+        return findMinimizerMarkers(read, readMarkers, minimizerWorkArea);
+    }
+
+    // Loop over k-mers of this read.
+    uint64_t markerCount = 0;
+    for(KmerIterator it(read, k); it.isValid(); ++it) {
+        const KmerId kmerId = it.kmerId();
+        if(isMarker(kmerId, it.reverseComplementedKmerId())) {
+            // This k-mer is a marker.
+            CompressedMarker marker;
+            marker.kmerId = kmerId;
+            marker.position = it.position();
+            readMarkers.push_back(marker);
+            ++markerCount;
+        }
+    }
+    return markerCount;
+}
+
+
+
+void MarkerFinder::countReadMarkers(ReadId readId, uint64_t markerCount)
+{
+    if(storeStrand1) {
+        markers.kmerIds.incrementCount(OrientedReadId(readId, 0).getValue(), markerCount);
+        markers.kmerIds.incrementCount(OrientedReadId(readId, 1).getValue(), markerCount);
+    } else {
+        markers.kmerIds.incrementCount(readId, markerCount);
+    }
+    const uint64_t baseCount = reads[readId].baseCount;
+    markers.positionOffset[readId] =
+        (baseCount >= k) ? uint32_t(baseCount - k) : 0;
+}
+
+
+
+// Find the window minimizers of a read, append them
+// to the given vector, and return their number.
+uint64_t MarkerFinder::findMinimizerMarkers(
+    const LongBaseSequenceView& read,
+    vector<CompressedMarker>& markerVector,
+    MinimizerWorkArea& workArea) const
+{
+    vector<KmerId>& kmerIds = workArea.kmerIds;
+    vector<uint64_t>& hashes = workArea.hashes;
+    vector<uint64_t>& windowMinima = workArea.windowMinima;
+    std::deque<uint64_t>& queue = workArea.queue;
 
-            if(read.baseCount >= k) {   // Avoid pathological case.
-
-                // Loop over k-mers of this read.
-                Kmer kmer;
-                for(size_t position=0; position<k; position++) {
-                    kmer.set(position, read[position]);
-                }
-                for(uint32_t position=0; /*The check is done later */; position++) {
-                    const KmerId kmerId = KmerId(kmer.id(k));
-                    if(kmerTable[kmerId].isMarker) {
-                        // This k-mer is a marker.
-
-                        if(pass == 1) {
-                            ++markerCount;
-                        } else {
-                            // Strand 0.
-                            markerPointerStrand0->kmerId = kmerId;
-                            markerPointerStrand0->position = position;
-                            ++markerPointerStrand0;
-
-                            // Strand 1.
-                            markerPointerStrand1->kmerId = kmerTable[kmerId].reverseComplementedKmerId;
-                            markerPointerStrand1->position = uint32_t(read.baseCount - k - position);
-                            --markerPointerStrand1;
-
-                        }
-                    }
-
-                    if(position+k == read.baseCount) {
-                        break;
-                    }
-
-                    // Update the k-mer.
-                    kmer.shiftLeft();
-                    kmer.set(k-1, read[position+k]);
-                }
+    // Compute the hash of each k-mer.
+    // K-mers not flagged as markers get the maximum
+    // hash value and are never selected.
+    const uint64_t notEligible = std::numeric_limits<uint64_t>::max();
+    kmerIds.clear();
+    hashes.clear();
+    for(KmerIterator it(read, k); it.isValid(); ++it) {
+        const KmerId kmerId = it.kmerId();
+        const KmerId reverseComplementedKmerId = it.reverseComplementedKmerId();
+        kmerIds.push_back(kmerId);
+        if(isMarker(kmerId, reverseComplementedKmerId)) {
+            const KmerId canonicalKmerId = min(kmerId, reverseComplementedKmerId);
+            hashes.push_back(min(notEligible - 1,
+                MurmurHash64A(&canonicalKmerId, sizeof(canonicalKmerId), 231)));
+        } else {
+            hashes.push_back(notEligible);
+        }
+    }
+    const uint64_t n = hashes.size();
+    if(n == 0) {
+        return 0;
+    }
+
+    // A read with fewer k-mers than the window size
+    // is treated as a single window.
+    const uint64_t w = min(minimizerWindow, n);
+    const uint64_t windowCount = n - w + 1;
+
+    // Compute the minimum hash in each window,
+    // keeping in the queue the positions that can still
+    // be the minimum of a window, with increasing hashes.
+    windowMinima.resize(windowCount);
+    queue.clear();
+    for(uint64_t position=0; position<n; position++) {
+        while(not queue.empty() and hashes[queue.back()] >= hashes[position]) {
+            queue.pop_back();
+        }
+        queue.push_back(position);
+        if(queue.front() + w <= position) {
+            queue.pop_front();
+        }
+        if(position + 1 >= w) {
+            windowMinima[position + 1 - w] = hashes[queue.front()];
+        }
+    }
+
+    // A k-mer is a minimizer if its hash is the minimum
+    // of at least one of the windows that contain it,
+    // that is, if it is equal to the largest of their minima.
+    // Compute that with a second sliding window, this time
+    // keeping the windows with decreasing minima in the queue.
+    queue.clear();
+    uint64_t markerCount = 0;
+    for(uint64_t position=0; position<n; position++) {
+        if(position < windowCount) {
+            while(not queue.empty() and windowMinima[queue.back()] <= windowMinima[position]) {
+                queue.pop_back();
             }
+            queue.push_back(position);
+        }
+        if(queue.front() + w <= position) {
+            queue.pop_front();
+        }
+        const uint64_t hash = hashes[position];
+        if(hash != notEligible and hash == windowMinima[queue.front()]) {
+            CompressedMarker marker;
+            marker.kmerId = kmerIds[position];
+            marker.position = uint32_t(position);
+            markerVector.push_back(marker);
+            ++markerCount;
+        }
+    }
 
-            if(pass == 1) {
-                markers.incrementCount(OrientedReadId(readId, 0).getValue(), markerCount);
-                markers.incrementCount(OrientedReadId(readId, 1).getValue(), markerCount);
-            } else {
-                SHASTA_ASSERT(markerPointerStrand0 ==
-                    markers.end(OrientedReadId(readId, 0).getValue()));
-                SHASTA_ASSERT(markerPointerStrand1 ==
-                    markers.begin(OrientedReadId(readId, 1).getValue()) - 1ULL);
+    return markerCount;
+}
+
+
+
+void MarkerFinder::storeMarkersThreadFunction(size_t threadId)
+{
+
+    // Loop over batches assigned to this thread.
+    // Each batch of this pass corresponds to a batch of reads
+    // processed by findMarkersThreadFunction.
+    uint64_t batchBegin, batchEnd;
+    while(getNextBatch(batchBegin, batchEnd)) {
+        for(uint64_t batchId=batchBegin; batchId!=batchEnd; batchId++) {
+            vector<CompressedMarker>& thisBatchMarkers = batchMarkers[batchId];
+            const CompressedMarker* batchMarkerPointer = thisBatchMarkers.data();
+
+            // Loop over reads of this batch.
+            const ReadId readBegin = ReadId(batchId * batchSize);
+            const ReadId readEnd = ReadId(min(uint64_t(reads.size()), (batchId + 1) * batchSize));
+            for(ReadId readId=readBegin; readId!=readEnd; readId++) {
+                storeReadMarkers(readId, batchMarkerPointer);
+                batchMarkerPointer += markers.kmerIds.size(
+                    storeStrand1 ? OrientedReadId(readId, 0).getValue() : readId);
             }
+            SHASTA_ASSERT(batchMarkerPointer == thisBatchMarkers.data() + thisBatchMarkers.size());
+
+            // Free the memory used by this batch.
+            thisBatchMarkers.clear();
+            thisBatchMarkers.shrink_to_fit();
+        }
+    }
+
+}
+
+
+
+void MarkerFinder::storeReadMarkers(
+    ReadId readId,
+    const CompressedMarker* readMarkers)
+{
+
+    // If only strand 0 is stored, just copy the markers.
+    if(not storeStrand1) {
+        KmerId* kmerIdPointer = markers.kmerIds.begin(readId);
+        Uint24* positionPointer = markers.positions.begin() + markers.dataBegin(readId);
+        const uint64_t markerCount = markers.kmerIds.size(readId);
+        for(uint64_t i=0; i<markerCount; i++) {
+            const CompressedMarker& marker = *readMarkers++;
+            *kmerIdPointer++ = marker.kmerId;
+            *positionPointer++ = marker.position;
         }
+        return;
     }
 
+    const uint32_t positionOffset = markers.positionOffset[readId];
+    const uint64_t strand0Index = OrientedReadId(readId, 0).getValue();
+    const uint64_t strand1Index = OrientedReadId(readId, 1).getValue();
+    const uint64_t markerCount = markers.kmerIds.size(strand0Index);
+    SHASTA_ASSERT(markers.kmerIds.size(strand1Index) == markerCount);
+
+    // Strand 0 markers are stored in order,
+    // strand 1 markers in reverse order.
+    KmerId* kmerIdPointerStrand0 = markers.kmerIds.begin(strand0Index);
+    Uint24* positionPointerStrand0 = markers.positions.begin() + markers.dataBegin(strand0Index);
+    KmerId* kmerIdPointerStrand1 = markers.kmerIds.end(strand1Index) - 1ULL;
+    Uint24* positionPointerStrand1 = markers.positions.begin() + markers.dataBegin(strand1Index) + markerCount - 1ULL;
+
+    for(uint64_t i=0; i<markerCount; i++) {
+        const CompressedMarker& marker = *readMarkers++;
+
+        // Strand 0.
+        *kmerIdPointerStrand0++ = marker.kmerId;
+        *positionPointerStrand0++ = marker.position;
+
+        // Strand 1.
+        *kmerIdPointerStrand1-- = Markers::reverseComplementKmerId(marker.kmerId, k);
+        *positionPointerStrand1-- = positionOffset - uint32_t(marker.position);
+    }
 }
@@ -2,16 +2,18 @@
 #define SHASTA_MARKER_FINDER_HPP
 
 #include "Marker.hpp"
+#include "MemoryMappedVector.hpp"
 #include "MultithreadedObject.hpp"
+#include "ReadId.hpp"
+#include "cstdint.hpp"
+#include <deque>
+#include "vector.hpp"
 
 namespace shasta {
     class MarkerFinder;
     class LongBaseSequences;
-
-    namespace MemoryMapped {
-        template<class T> class Vector;
-        template<class Int, class T> class VectorOfVectors;
-    }
+    class LongBaseSequenceView;
+    class Markers;
 }
 
 
@@ -25,7 +27,11 @@ public:
         size_t k,
         const MemoryMapped::Vector<KmerInfo>& kmerTable,
         LongBaseSequences& reads,
-        MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers,
+        Markers& markers,
+        bool storeStrand1,
+        uint64_t minimizerWindow,
+        uint64_t markerHashThreshold,
+        bool singlePass,
         size_t threadCount);
 
 private:
@@ -34,15 +40,82 @@ private:
     size_t k;
     const MemoryMapped::Vector<KmerInfo>& kmerTable;
     LongBaseSequences& reads;
-    MemoryMapped::VectorOfVectors<CompressedMarker, uint64_t>& markers;
+    Markers& markers;
+    bool storeStrand1;
+    uint64_t minimizerWindow;
+    uint64_t markerHashThreshold;
+    bool singlePass;
     size_t threadCount;
 
-    void threadFunction(size_t threadId);
+    // Return true if a k-mer is a marker k-mer.
+    // If k is too large for a k-mer table, the k-mer table is empty,
+    // and markers are selected by hashing instead.
+    bool isMarker(KmerId kmerId, KmerId reverseComplementedKmerId) const
+    {
+        if(k > maxKmerTableK) {
+            return isHashedMarkerKmer(kmerId, reverseComplementedKmerId, markerHashThreshold);
+        } else {
+            return kmerTable[kmerId].isMarker;
+        }
+    }
 
-    // In pass 1, we count the number of markers for each
-    // read and call reads.incrementCountMultithreaded.
-    // In pass 2, we store the markers.
+    // By default, markers are found in two passes over the reads.
+    // Pass 1 only counts the markers of each read.
+    // Pass 2 finds them again and stores them directly
+    // into their final location, so no additional memory is used.
+    size_t batchSize;
     size_t pass;
+    void threadFunction(size_t threadId);
+
+    // If singlePass is true, markers are found in a single pass
+    // over the reads instead. Each batch of reads stores the strand 0
+    // markers of its reads in its own buffer.
+    // Once all batches are done, the layout of the markers is
+    // known and the buffers are copied into place.
+    // This avoids finding the markers twice, at the cost of
+    // keeping all strand 0 markers in memory while the markers
+    // are allocated and stored.
+    vector< vector<CompressedMarker> > batchMarkers;
+    void findMarkersThreadFunction(size_t threadId);
+    void storeMarkersThreadFunction(size_t threadId);
+
+    // If minimizerWindow is not zero, the markers of a read are its
+    // window minimizers: in each window of minimizerWindow consecutive
+    // k-mers, the k-mers with the lowest hash value are markers.
+    // Only k-mers flagged as markers in the k-mer table are considered.
+    // The hash of a k-mer is the hash of the lowest of its KmerId
+    // and the KmerId of its reverse complement, and all k-mers
+    // tied for the lowest hash in a window are selected. So the markers
+    // found on the reverse complement of a read are the reverse
+    // complements of the markers found on the read, as required.
+    // The distance between consecutive markers is at most minimizerWindow
+    // k-mers, except in regions without any k-mers flagged as markers.
+    class MinimizerWorkArea {
+    public:
+        vector<KmerId> kmerIds;
+        vector<uint64_t> hashes;
+        vector<uint64_t> windowMinima;
+        std::deque<uint64_t> queue;
+    };
+    uint64_t findMinimizerMarkers(
+        const LongBaseSequenceView&,
+        vector<CompressedMarker>&,
+        MinimizerWorkArea&) const;
+
+    // Find the strand 0 markers of a read, append them
+    // to the given vector, and return their number.
+    uint64_t findReadMarkers(
+        ReadId,
+        vector<CompressedMarker>&,
+        MinimizerWorkArea&) const;
+
+    // Store the markers of a read, found by findReadMarkers,
+    // into their final location, generating the
+    // strand 1 markers at the same time if storeStrand1 is true.
+    void storeReadMarkers(ReadId, const CompressedMarker*);
+
+    // Record the number of markers of a read with incrementCount.
+    void countReadMarkers(ReadId, uint64_t markerCount);
 
 };
 
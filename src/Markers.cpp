@@ -0,0 +1,68 @@
+#include "Markers.hpp"
+using namespace shasta;
+
+// Standard library.
+#include "algorithm.hpp"
+
+
+
+void Markers::createNew(const string& name, size_t pageSize, uint64_t kArgument)
+{
+    k = kArgument;
+    if(name.empty()) {
+        kmerIds.createNew("", pageSize);
+        positions.createNew("", pageSize);
+        positionOffset.createNew("", pageSize);
+    } else {
+        kmerIds.createNew(name + "-KmerIds", pageSize);
+        positions.createNew(name + "-Positions", pageSize);
+        positionOffset.createNew(name + "-PositionOffset", pageSize);
+    }
+}
+
+
+
+void Markers::accessExistingReadOnly(const string& name, uint64_t kArgument)
+{
+    k = kArgument;
+    kmerIds.accessExistingReadOnly(name + "-KmerIds");
+    positions.accessExistingReadOnly(name + "-Positions");
+    positionOffset.accessExistingReadOnly(name + "-PositionOffset");
+    SHASTA_ASSERT(kmerIds.size() == positionOffset.size() or kmerIds.size() == 2 * positionOffset.size());
+    SHASTA_ASSERT(positions.size() == kmerIds.totalSize());
+}
+
+
+
+void Markers::remove()
+{
+    kmerIds.remove();
+    positions.remove();
+    positionOffset.remove();
+}
+
+
+
+// Given a global marker id, return its OrientedReadId and ordinal.
+// This requires a binary search.
+pair<OrientedReadId, uint32_t> Markers::findMarkerId(MarkerId markerId) const
+{
+    if(storesStrand1()) {
+        const pair<uint64_t, uint64_t> p = kmerIds.find(markerId);
+        return make_pair(OrientedReadId(OrientedReadId::Int(p.first)), uint32_t(p.second));
+    }
+
+    // Only the markers of strand 0 are stored.
+    // The markers of read i have global marker ids beginning at
+    // twice the index in kmerIds of its first marker,
+    // first on strand 0 and then on strand 1.
+    const pair<uint64_t, uint64_t> p = kmerIds.find(markerId / 2);
+    const ReadId readId = ReadId(p.first);
+    const uint64_t markerCount = kmerIds.size(readId);
+    const uint64_t offset = markerId - 2 * dataBegin(readId);
+    if(offset < markerCount) {
+        return make_pair(OrientedReadId(readId, 0), uint32_t(offset));
+    } else {
+        return make_pair(OrientedReadId(readId, 1), uint32_t(offset - markerCount));
+    }
+}
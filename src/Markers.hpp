@@ -0,0 +1,378 @@
+#ifndef SHASTA_MARKERS_HPP
+#define SHASTA_MARKERS_HPP
+
+/*******************************************************************************
+
+Class Markers stores the markers of all oriented reads.
+
+The markers of strand 1 of a read are fully determined by the
+markers of strand 0: they appear in reverse order,
+their k-mers are reverse complemented, and a marker at position p
+on strand 0 is at position baseCount-k-p on strand 1.
+So class Markers can optionally store only the markers
+of strand 0 of each read, and generate the markers of strand 1 on the fly.
+This reduces by half the memory used by markers.
+
+In either case, the markers of an oriented read are accessed
+via operator[], which returns an OrientedReadMarkers object
+that behaves like a read-only container of CompressedMarker
+objects, returned by value.
+
+The markers are stored as a structure of arrays:
+the k-mer ids of all markers are stored contiguously
+and aligned, and the positions are stored in a separate
+array of 3-byte integers. This uses the same amount of memory
+as storing CompressedMarker objects, and code that only
+needs k-mer ids (for example LowHash) can scan them
+directly via getKmerIds, without making a copy.
+
+Global marker ids (MarkerId) are the same in both cases.
+The markers of each oriented read are numbered consecutively,
+in order of increasing OrientedReadId::getValue()
+and then increasing ordinal.
+
+*******************************************************************************/
+
+// Shasta.
+#include "Marker.hpp"
+#include "MarkerGraph.hpp"
+#include "MemoryMappedVector.hpp"
+#include "MemoryMappedVectorOfVectors.hpp"
+#include "ReadId.hpp"
+#include "SHASTA_ASSERT.hpp"
+
+// Standard library.
+#include "cstdint.hpp"
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class Markers;
+    class MarkersSortedByKmerId;
+    class MarkerFinder;
+}
+
+
+
+class shasta::Markers {
+public:
+
+    // The read-only markers of one oriented read.
+    class OrientedReadMarkers {
+    public:
+
+        uint64_t size() const
+        {
+            return markerCount;
+        }
+        bool empty() const
+        {
+            return markerCount == 0;
+        }
+
+        CompressedMarker operator[](uint64_t ordinal) const
+        {
+            CompressedMarker marker;
+            if(not isReverseComplemented) {
+                marker.kmerId = kmerIdBegin[ordinal];
+                marker.position = positionBegin[ordinal];
+            } else {
+                const uint64_t strand0Ordinal = markerCount - 1 - ordinal;
+                marker.kmerId = reverseComplementKmerId(kmerIdBegin[strand0Ordinal], k);
+                marker.position = positionOffset - uint32_t(positionBegin[strand0Ordinal]);
+            }
+            return marker;
+        }
+
+        class const_iterator {
+        public:
+            const_iterator(const OrientedReadMarkers& orientedReadMarkers, uint64_t ordinal) :
+                orientedReadMarkers(&orientedReadMarkers), ordinal(ordinal) {}
+            CompressedMarker operator*() const
+            {
+                return (*orientedReadMarkers)[ordinal];
+            }
+            const_iterator& operator++()
+            {
+                ++ordinal;
+                return *this;
+            }
+            bool operator!=(const const_iterator& that) const
+            {
+                return ordinal != that.ordinal;
+            }
+        private:
+            const OrientedReadMarkers* orientedReadMarkers;
+            uint64_t ordinal;
+        };
+        const_iterator begin() const
+        {
+            return const_iterator(*this, 0);
+        }
+        const_iterator end() const
+        {
+            return const_iterator(*this, markerCount);
+        }
+
+    private:
+        const KmerId* kmerIdBegin;
+        const Uint24* positionBegin;
+        uint64_t markerCount;
+        bool isReverseComplemented;
+        uint64_t k;
+        uint32_t positionOffset;
+        friend class Markers;
+    };
+
+
+
+    void createNew(const string& name, size_t pageSize, uint64_t k);
+    void accessExistingReadOnly(const string& name, uint64_t k);
+    void remove();
+    bool isOpen() const
+    {
+        return kmerIds.isOpen() && positions.isOpen && positionOffset.isOpen;
+    }
+
+    // Return true if the markers of strand 1 are stored,
+    // false if they are generated on the fly from the markers of strand 0.
+    bool storesStrand1() const
+    {
+        return kmerIds.size() != positionOffset.size();
+    }
+
+    // The number of oriented reads.
+    uint64_t size() const
+    {
+        return 2 * positionOffset.size();
+    }
+
+    // The number of markers of an oriented read.
+    uint64_t size(uint64_t orientedReadIdValue) const
+    {
+        return kmerIds.size(dataIndex(orientedReadIdValue));
+    }
+
+    // The total number of markers on all oriented reads.
+    uint64_t totalSize() const
+    {
+        return storesStrand1() ? kmerIds.totalSize() : 2 * kmerIds.totalSize();
+    }
+
+    // The number of bytes used.
+    uint64_t byteCount() const
+    {
+        return
+            (kmerIds.size() + 1) * sizeof(uint64_t) +
+            kmerIds.totalSize() * sizeof(KmerId) +
+            positions.size() * sizeof(Uint24) +
+            positionOffset.size() * sizeof(uint32_t);
+    }
+
+    // Access the markers of an oriented read.
+    OrientedReadMarkers operator[](uint64_t orientedReadIdValue) const
+    {
+        const uint64_t i = dataIndex(orientedReadIdValue);
+        OrientedReadMarkers orientedReadMarkers;
+        orientedReadMarkers.kmerIdBegin = kmerIds.begin(i);
+        orientedReadMarkers.positionBegin = positions.begin() + dataBegin(i);
+        orientedReadMarkers.markerCount = kmerIds.size(i);
+        orientedReadMarkers.isReverseComplemented =
+            (not storesStrand1()) and ((orientedReadIdValue & 1ULL) == 1ULL);
+        orientedReadMarkers.k = k;
+        orientedReadMarkers.positionOffset = positionOffset[orientedReadIdValue >> 1ULL];
+        return orientedReadMarkers;
+    }
+
+    // Access a marker given its global marker id.
+    // If only the markers of strand 0 are stored,
+    // this requires a binary search.
+    CompressedMarker get(MarkerId markerId) const
+    {
+        if(storesStrand1()) {
+            CompressedMarker marker;
+            marker.kmerId = kmerIds.begin()[markerId];
+            marker.position = positions[markerId];
+            return marker;
+        }
+        const pair<OrientedReadId, uint32_t> p = findMarkerId(markerId);
+        return (*this)[p.first.getValue()][p.second];
+    }
+
+    // Given a marker by its OrientedReadId and ordinal,
+    // return the corresponding global marker id.
+    MarkerId getMarkerId(OrientedReadId orientedReadId, uint32_t ordinal) const
+    {
+        const uint64_t i = dataIndex(orientedReadId.getValue());
+        if(storesStrand1()) {
+            return dataBegin(i) + ordinal;
+        } else {
+            return 2 * dataBegin(i) + orientedReadId.getStrand() * kmerIds.size(i) + ordinal;
+        }
+    }
+
+    // Return a pointer to the k-mer ids of the markers of an oriented read.
+    // If they are stored, this points directly to the stored k-mer ids.
+    // Otherwise, they are computed and stored in the vector
+    // passed as an argument, and the returned pointer points to its data.
+    const KmerId* getKmerIds(uint64_t orientedReadIdValue, vector<KmerId>& buffer) const
+    {
+        const uint64_t i = dataIndex(orientedReadIdValue);
+        const KmerId* begin = kmerIds.begin(i);
+        if(storesStrand1() or ((orientedReadIdValue & 1ULL) == 0)) {
+            return begin;
+        }
+        const uint64_t n = kmerIds.size(i);
+        buffer.resize(n);
+        for(uint64_t j=0; j<n; j++) {
+            buffer[j] = reverseComplementKmerId(begin[n - 1 - j], k);
+        }
+        return buffer.data();
+    }
+
+    // Same as above, but only for count markers beginning at a given ordinal.
+    // This avoids computing the k-mer ids of all markers of the oriented read
+    // when only a few are needed.
+    const KmerId* getKmerIds(
+        uint64_t orientedReadIdValue,
+        uint64_t ordinal,
+        uint64_t count,
+        vector<KmerId>& buffer) const
+    {
+        const uint64_t i = dataIndex(orientedReadIdValue);
+        const KmerId* begin = kmerIds.begin(i);
+        if(storesStrand1() or ((orientedReadIdValue & 1ULL) == 0)) {
+            return begin + ordinal;
+        }
+        const uint64_t n = kmerIds.size(i);
+        SHASTA_ASSERT(ordinal + count <= n);
+        buffer.resize(count);
+        for(uint64_t j=0; j<count; j++) {
+            buffer[j] = reverseComplementKmerId(begin[n - 1 - ordinal - j], k);
+        }
+        return buffer.data();
+    }
+
+    // Inverse of the above: given a global marker id,
+    // return its OrientedReadId and ordinal.
+    // This requires a binary search.
+    pair<OrientedReadId, uint32_t> findMarkerId(MarkerId) const;
+
+    // Compute the KmerId of the reverse complement of a k-mer.
+    static KmerId reverseComplementKmerId(KmerId kmerId, uint64_t k)
+    {
+        // Each of the two halves of the KmerId contains one bit
+        // of each base, with base 0 in the most significant bit.
+        // Reverse the order of the bases and complement them.
+        const uint64_t mask = (1ULL << k) - 1ULL;
+        const uint64_t lsb = uint64_t(kmerId) & mask;
+        const uint64_t msb = (uint64_t(kmerId) >> k) & mask;
+        const uint64_t shift = 64ULL - k;
+        return KmerId(
+            (((reverseBits(msb) >> shift) ^ mask) << k) |
+            ((reverseBits(lsb) >> shift) ^ mask));
+    }
+
+private:
+
+    // The k-mer ids of the markers of each oriented read if storesStrand1() is true,
+    // otherwise only those of the markers of strand 0 of each read.
+    MemoryMapped::VectorOfVectors<KmerId, uint64_t> kmerIds;
+
+    // The positions of the same markers, in the same order.
+    // This shares the table of contents of kmerIds.
+    MemoryMapped::Vector<Uint24> positions;
+
+    // For each read, its number of bases minus k,
+    // or 0 if it has less than k bases.
+    // The position of a marker on strand 1 is
+    // this minus its position on strand 0.
+    MemoryMapped::Vector<uint32_t> positionOffset;
+
+    uint64_t k;
+
+    // The index in kmerIds of the markers of an oriented read.
+    uint64_t dataIndex(uint64_t orientedReadIdValue) const
+    {
+        return storesStrand1() ? orientedReadIdValue : (orientedReadIdValue >> 1ULL);
+    }
+
+    // The global index in kmerIds and positions
+    // of the first marker of entry i of kmerIds.
+    uint64_t dataBegin(uint64_t i) const
+    {
+        return uint64_t(kmerIds.begin(i) - kmerIds.begin());
+    }
+
+    static uint64_t reverseBits(uint64_t x)
+    {
+        x = ((x >> 1ULL) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1ULL);
+        x = ((x >> 2ULL) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2ULL);
+        x = ((x >> 4ULL) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4ULL);
+        return __builtin_bswap64(x);
+    }
+
+    // MarkerFinder fills in the markers.
+    friend class MarkerFinder;
+};
+
+
+
+// A read-only view of the markers of an oriented read sorted by KmerId,
+// returned by Assembler::getMarkersSortedByKmerId.
+// It either follows a permutation of the ordinals of the markers,
+// without copying them, or it points to a vector of MarkerWithOrdinal
+// that was explicitly sorted.
+// In either case, the view does not own any data and is only valid
+// as long as the data it points to.
+class shasta::MarkersSortedByKmerId {
+public:
+
+    // A view that follows a permutation of the ordinals of the markers.
+    MarkersSortedByKmerId(
+        const Markers::OrientedReadMarkers& orientedReadMarkers,
+        const uint32_t* ordinals) :
+        orientedReadMarkers(orientedReadMarkers),
+        ordinals(ordinals),
+        markerCount(orientedReadMarkers.size())
+    {}
+
+    // A view of markers already sorted by KmerId.
+    explicit MarkersSortedByKmerId(const vector<MarkerWithOrdinal>& sortedMarkers) :
+        sortedMarkers(sortedMarkers.data()),
+        markerCount(sortedMarkers.size())
+    {}
+
+    MarkersSortedByKmerId() {}
+
+    uint64_t size() const
+    {
+        return markerCount;
+    }
+
+    MarkerWithOrdinal operator[](uint64_t i) const
+    {
+        if(sortedMarkers) {
+            return sortedMarkers[i];
+        }
+        const uint32_t ordinal = ordinals[i];
+        return MarkerWithOrdinal(orientedReadMarkers[ordinal], ordinal);
+    }
+
+    KmerId kmerId(uint64_t i) const
+    {
+        if(sortedMarkers) {
+            return sortedMarkers[i].kmerId;
+        }
+        return orientedReadMarkers[ordinals[i]].kmerId;
+    }
+
+private:
+    Markers::OrientedReadMarkers orientedReadMarkers;
+    const uint32_t* ordinals = 0;
+    const MarkerWithOrdinal* sortedMarkers = 0;
+    uint64_t markerCount = 0;
+};
+
+#endif
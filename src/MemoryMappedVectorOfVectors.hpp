@@ -210,6 +210,84 @@ public:
 
 
 
+    // Functions used to append the vectors of several other VectorOfVectors
+    // in parallel.
+    // First, appendUninitializedVectors makes space at the end
+    // for all of them at once.
+    // Then copyVectors copies each of them into place,
+    // starting at the specified vector and element.
+    // copyVectors can be called in parallel for non-overlapping ranges.
+    // It writes toc entries vectorBegin+1 through vectorBegin+that.size(),
+    // so entry vectorBegin must be set by the preceding copy,
+    // or already be set if this is the first one.
+    // If canAppendInPlace returns true, appendUninitializedVectors
+    // does not reallocate, so it can be called while copyVectors
+    // is still running for vectors appended previously.
+    bool canAppendInPlace(Int vectorCount, Int elementCount) const
+    {
+        return
+            toc.size() + vectorCount <= toc.capacity() and
+            data.size() + elementCount <= data.capacity();
+    }
+    void appendUninitializedVectors(Int vectorCount, Int elementCount)
+    {
+        const Int newElementCount = Int(data.size()) + elementCount;
+        toc.resize(toc.size() + vectorCount);
+        toc.back() = newElementCount;
+        data.resize(newElementCount);
+    }
+    void copyVectors(
+        Int vectorBegin,
+        Int elementBegin,
+        const VectorOfVectors<T, Int>& that)
+    {
+        copyVectors(vectorBegin, elementBegin, that, 0, Int(that.size()));
+    }
+
+    // Same, but only copy vectors thatVectorBegin through thatVectorEnd-1
+    // of that, so a large copy can be split between threads.
+    void copyVectors(
+        Int vectorBegin,
+        Int elementBegin,
+        const VectorOfVectors<T, Int>& that,
+        Int thatVectorBegin,
+        Int thatVectorEnd)
+    {
+        const Int thatElementBegin = that.toc[thatVectorBegin];
+        for(Int i=thatVectorBegin; i<thatVectorEnd; i++) {
+            toc[vectorBegin + (i - thatVectorBegin) + 1] =
+                elementBegin + (that.toc[i + 1] - thatElementBegin);
+        }
+        copy(
+            that.data.begin() + thatElementBegin,
+            that.data.begin() + that.toc[thatVectorEnd],
+            data.begin() + elementBegin);
+    }
+
+    // Remove, in place, the vectors for which keep is false.
+    // The vectors that are kept remain in the same order.
+    void keepVectors(const vector<bool>& keep)
+    {
+        const Int n = Int(size());
+        SHASTA_ASSERT(keep.size() == n);
+        Int newVectorCount = 0;
+        Int newElementCount = 0;
+        Int oldBegin = toc[0];
+        for(Int i=0; i<n; i++) {
+            const Int oldEnd = toc[i + 1];
+            if(keep[i]) {
+                copy(data.begin() + oldBegin, data.begin() + oldEnd, data.begin() + newElementCount);
+                newElementCount += oldEnd - oldBegin;
+                toc[++newVectorCount] = newElementCount;
+            }
+            oldBegin = oldEnd;
+        }
+        toc.resize(newVectorCount + 1);
+        data.resize(newElementCount);
+    }
+
+
+
     // Operator[] return a MemoryAsContainer object.
     MemoryAsContainer<T> operator[](Int i)
     {
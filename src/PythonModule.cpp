@@ -4,8 +4,12 @@
 #include "Assembler.hpp"
 #include "Base.hpp"
 #include "CompactUndirectedGraph.hpp"
+#include "CompressedReadNames.hpp"
+#include "CompressedRepeatCounts.hpp"
+#include "computeRunLengthRepresentation.hpp"
 #include "deduplicate.hpp"
 #include "dset64Test.hpp"
+#include "KmerIterator.hpp"
 #include "LongBaseSequence.hpp"
 #include "mappedCopy.hpp"
 #include "MultithreadedObject.hpp"
@@ -45,6 +49,22 @@ PYBIND11_MODULE(shasta, module)
 
 
 
+    {
+        // Class used by Assembler::findSequenceInReads.
+        using Hit = Assembler::SequenceHit;
+        class_<Hit>(module, "SequenceHit")
+            .def_readwrite("readId", &Hit::readId)
+            .def_readwrite("strand", &Hit::strand)
+            .def_readwrite("markerCount", &Hit::markerCount)
+            .def_readwrite("queryBegin", &Hit::queryBegin)
+            .def_readwrite("queryEnd", &Hit::queryEnd)
+            .def_readwrite("readBegin", &Hit::readBegin)
+            .def_readwrite("readEnd", &Hit::readEnd)
+            ;
+    }
+
+
+
     // Expose class OrientedReadPair to Python.
     class_<OrientedReadPair>(module, "OrientedReadPair")
         .def_readonly("readIds", &OrientedReadPair::readIds)
@@ -104,6 +124,17 @@ PYBIND11_MODULE(shasta, module)
             arg("readId"),
             arg("strand"),
             arg("fileName"))
+        .def("compressReadRepeatCounts",
+            &Assembler::compressReadRepeatCounts)
+        .def("subsampleReads",
+            &Assembler::subsampleReads,
+            arg("targetCoverage"),
+            arg("genomeSize"),
+            arg("method") = "hash")
+        .def("compressReadNames",
+            &Assembler::compressReadNames)
+        .def("getReadId",
+            &Assembler::getReadId)
         .def("initializeReadFlags",
             &Assembler::initializeReadFlags)
         .def("accessReadFlags",
@@ -139,7 +170,28 @@ PYBIND11_MODULE(shasta, module)
         .def("findMarkers",
             &Assembler::findMarkers,
             "Find markers in reads.",
+            arg("threadCount") = 0,
+            arg("storeStrand1") = true,
+            arg("minimizerWindow") = 0,
+            arg("singlePass") = false)
+        .def("computeSortedMarkers",
+            &Assembler::computeSortedMarkers,
+            "Sort the markers of each oriented read by k-mer id.",
+            arg("threadCount") = 0)
+        .def("accessSortedMarkers",
+            &Assembler::accessSortedMarkers)
+        .def("computeKmerOccurrences",
+            &Assembler::computeKmerOccurrences,
+            "Create the index of the occurrences of each marker k-mer.",
             arg("threadCount") = 0)
+        .def("accessKmerOccurrences",
+            &Assembler::accessKmerOccurrences)
+        .def("findSequenceInReads",
+            &Assembler::findSequenceInReads,
+            "Find the oriented reads that contain a sequence.",
+            arg("sequence"),
+            arg("minMarkerCount") = 3,
+            arg("maxDrift") = 30)
         .def("writeMarkers",
             (
                 void (Assembler::*)
@@ -167,7 +219,10 @@ PYBIND11_MODULE(shasta, module)
             arg("minBucketSize"),
             arg("maxBucketSize"),
             arg("minFrequency"),
-            arg("threadCount") = 0)
+            arg("threadCount") = 0,
+            arg("hashFeaturesOnce") = false,
+            arg("minNewCandidateFraction") = 0.,
+            arg("minCandidatesPerRead") = 0)
         .def("findAlignmentCandidatesLowHash1",
             &Assembler::findAlignmentCandidatesLowHash1,
             arg("m"),
@@ -177,7 +232,8 @@ PYBIND11_MODULE(shasta, module)
             arg("minBucketSize"),
             arg("maxBucketSize"),
             arg("minFrequency"),
-            arg("threadCount") = 0)
+            arg("threadCount") = 0,
+            arg("hashFeaturesOnce") = false)
         .def("accessAlignmentCandidates",
             &Assembler::accessAlignmentCandidates)
         .def("getAlignmentCandidates",
@@ -545,6 +601,18 @@ PYBIND11_MODULE(shasta, module)
     module.def("testLongBaseSequence",
         testLongBaseSequence
         );
+    module.def("testKmerIterator",
+        testKmerIterator
+        );
+    module.def("testComputeRunLengthRepresentation",
+        testComputeRunLengthRepresentation
+        );
+    module.def("testCompressedReadNames",
+        testCompressedReadNames
+        );
+    module.def("testCompressedRepeatCounts",
+        testCompressedRepeatCounts
+        );
     module.def("testSplitRange",
         testSplitRange
         );
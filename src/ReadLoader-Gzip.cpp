@@ -0,0 +1,378 @@
+// Decompression of gzip compressed input files for class ReadLoader.
+
+// Shasta.
+#include "ReadLoader.hpp"
+using namespace shasta;
+
+// Zlib.
+#include <zlib.h>
+
+// Standard library.
+#include "array.hpp"
+#include "chrono.hpp"
+#include <cstring>
+#include <limits>
+
+
+
+// Decompress a gzip compressed file into the buffer.
+// Files in BGZF format are decompressed by all threads in parallel,
+// otherwise we use a two-thread pipeline.
+void ReadLoader::readGzipFile()
+{
+    const auto t0 = std::chrono::steady_clock::now();
+    compressedByteCount = filesystem::fileSize(fileName);
+
+    if(isBgzf()) {
+        out << "Input file is in BGZF format and will be decompressed using " <<
+            threadCount << " threads." << endl;
+        readBgzfFile();
+    } else {
+        out << "Input file is gzip compressed and will be decompressed "
+            "by a single stream." << endl;
+        readPlainGzipFile();
+    }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    decompressedByteCount = buffer.size();
+    decompressionTime = seconds(t1 - t0);
+
+    out << "Compressed file size: " << compressedByteCount << " bytes." << endl;
+    out << "Decompressed size: " << decompressedByteCount << " bytes." << endl;
+    out << "Read and decompression time: " << decompressionTime << " s." << endl;
+    out << "Decompression rate: " << double(decompressedByteCount) / decompressionTime <<
+        " decompressed bytes/s." << endl;
+}
+
+
+
+// Return true if the first gzip block of the file has the
+// "BC" extra subfield that identifies BGZF format.
+// We only check the standard layout written by bgzip and htslib.
+// If later blocks turn out not to be BGZF, readBgzfFile
+// falls back to plain gzip decompression.
+bool ReadLoader::isBgzf() const
+{
+    const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + " for read.");
+    }
+    array<unsigned char, 16> header;
+    const ssize_t bytesRead = ::pread(fileDescriptor, header.data(), header.size(), 0);
+    ::close(fileDescriptor);
+    if(bytesRead != ssize_t(header.size())) {
+        return false;
+    }
+    return
+        header[0] == 31 and header[1] == 139 and    // Gzip magic number.
+        header[2] == 8 and                          // Deflate.
+        (header[3] & 4) and                         // FEXTRA.
+        header[12] == 'B' and header[13] == 'C' and // BGZF subfield.
+        header[14] == 2 and header[15] == 0;
+}
+
+
+
+void ReadLoader::readBgzfFile()
+{
+    // Read the entire compressed file.
+    int64_t bytesToRead = int64_t(compressedByteCount);
+    compressedBuffer.createNew(dataName("tmp-CompressedBuffer"), pageSize);
+    compressedBuffer.resize(compressedByteCount);
+    const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + " for read.");
+    }
+    char* bufferPointer = compressedBuffer.begin();
+    while(bytesToRead) {
+        const int64_t bytesRead = ::read(fileDescriptor, bufferPointer, bytesToRead);
+        if(bytesRead <= 0) {
+            ::close(fileDescriptor);
+            throw runtime_error("Error reading from " + fileName + " near offset " +
+                to_string(compressedBuffer.size()-bytesToRead));
+        }
+        bufferPointer += bytesRead;
+        bytesToRead -= bytesRead;
+    }
+    ::close(fileDescriptor);
+
+    // Locate the blocks. If this fails the file is not BGZF
+    // after all, so we decompress it as a plain gzip file.
+    if(not findBgzfBlocks()) {
+        out << "Input file is not entirely in BGZF format. "
+            "Reverting to single stream decompression." << endl;
+        compressedBuffer.remove();
+        bgzfBlocks.clear();
+        readPlainGzipFile();
+        return;
+    }
+    out << "Found " << bgzfBlocks.size() << " BGZF blocks." << endl;
+
+    // Allocate the buffer for the decompressed data.
+    const uint64_t decompressedSize = bgzfBlocks.empty() ? 0 :
+        bgzfBlocks.back().decompressedBegin + bgzfBlocks.back().decompressedSize;
+    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    buffer.reserveAndResize(decompressedSize);
+
+    // Each thread decompresses batches of blocks.
+    setupLoadBalancing(bgzfBlocks.size(), 16);
+    runThreads(&ReadLoader::readBgzfFileThreadFunction, threadCount);
+
+    compressedBuffer.remove();
+    bgzfBlocks.clear();
+}
+
+
+
+// Fill in bgzfBlocks using the BSIZE stored in the header
+// and the CRC32 and ISIZE stored in the footer of each block.
+// Returns false if a block is found that is not in BGZF format.
+bool ReadLoader::findBgzfBlocks()
+{
+    const unsigned char* data =
+        reinterpret_cast<const unsigned char*>(compressedBuffer.begin());
+    const uint64_t n = compressedBuffer.size();
+    const auto get16 = [](const unsigned char* p) -> uint32_t
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8);
+    };
+    const auto get32 = [](const unsigned char* p) -> uint32_t
+    {
+        return
+            uint32_t(p[0])        | (uint32_t(p[1]) << 8) |
+            (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    };
+
+    bgzfBlocks.clear();
+    uint64_t decompressedBegin = 0;
+    for(uint64_t offset=0; offset<n; ) {
+        const unsigned char* p = data + offset;
+        if(n - offset < 18) {
+            return false;
+        }
+        if(p[0]!=31 or p[1]!=139 or p[2]!=8 or !(p[3] & 4)) {
+            return false;
+        }
+
+        // Look for the BC subfield in the extra field.
+        const uint64_t headerSize = 12 + get16(p + 10);
+        if(offset + headerSize > n) {
+            return false;
+        }
+        uint64_t blockSize = 0;
+        for(uint64_t i=12; i+4<=headerSize; ) {
+            const uint64_t subfieldLength = get16(p + i + 2);
+            if(p[i]=='B' and p[i+1]=='C' and subfieldLength==2 and i+6<=headerSize) {
+                blockSize = get16(p + i + 4) + 1;
+            }
+            i += 4 + subfieldLength;
+        }
+        if(blockSize < headerSize + 8 or offset + blockSize > n) {
+            return false;
+        }
+
+        // Store this block, skipping empty blocks such as the end of file marker.
+        BgzfBlock block;
+        block.compressedBegin = offset + headerSize;
+        block.compressedSize = blockSize - headerSize - 8;
+        block.decompressedBegin = decompressedBegin;
+        block.crc32 = get32(p + blockSize - 8);
+        block.decompressedSize = get32(p + blockSize - 4);
+        if(block.decompressedSize > 0) {
+            bgzfBlocks.push_back(block);
+            decompressedBegin += block.decompressedSize;
+        }
+
+        offset += blockSize;
+    }
+    return true;
+}
+
+
+
+void ReadLoader::readBgzfFileThreadFunction(size_t threadId)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, -15) != Z_OK) {
+        throw runtime_error("Error initializing zlib.");
+    }
+
+    uint64_t begin, end;
+    while(getNextBatch(begin, end)) {
+        for(uint64_t i=begin; i!=end; i++) {
+            const BgzfBlock& block = bgzfBlocks[i];
+            Bytef* output = reinterpret_cast<Bytef*>(buffer.begin() + block.decompressedBegin);
+
+            // Each block is a complete raw deflate stream.
+            inflateReset(&stream);
+            stream.next_in = reinterpret_cast<Bytef*>(compressedBuffer.begin() + block.compressedBegin);
+            stream.avail_in = uInt(block.compressedSize);
+            stream.next_out = output;
+            stream.avail_out = block.decompressedSize;
+            const int status = inflate(&stream, Z_FINISH);
+            if(status != Z_STREAM_END or stream.avail_out != 0) {
+                inflateEnd(&stream);
+                throw runtime_error("Error decompressing BGZF block at offset " +
+                    to_string(block.compressedBegin) + " of " + fileName);
+            }
+            if(crc32(0, output, block.decompressedSize) != block.crc32) {
+                inflateEnd(&stream);
+                throw runtime_error("CRC error in BGZF block at offset " +
+                    to_string(block.compressedBegin) + " of " + fileName);
+            }
+        }
+    }
+
+    inflateEnd(&stream);
+}
+
+
+
+// Plain gzip files cannot be decompressed in parallel,
+// but we overlap reading the compressed data with inflating it.
+void ReadLoader::readPlainGzipFile()
+{
+    // Initial guess for the decompressed size.
+    // The buffer grows as needed during decompression.
+    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    buffer.resize(max(gzipChunkSize, 4 * compressedByteCount));
+    decompressedByteCount = 0;
+
+    gzipChunks.resize(gzipChunkCount);
+    for(GzipChunk& chunk: gzipChunks) {
+        chunk.data.resize(gzipChunkSize);
+        chunk.size = 0;
+    }
+    gzipChunkReadCount = 0;
+    gzipChunkConsumedCount = 0;
+    gzipEndOfFile = false;
+
+    gzipFileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if(gzipFileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + " for read.");
+    }
+    runThreads(&ReadLoader::readPlainGzipFileThreadFunction, 2);
+    ::close(gzipFileDescriptor);
+    gzipFileDescriptor = -1;
+    gzipChunks.clear();
+
+    buffer.resize(decompressedByteCount);
+    buffer.unreserve();
+}
+
+
+
+void ReadLoader::readPlainGzipFileThreadFunction(size_t threadId)
+{
+    if(threadId == 0) {
+        readGzipChunks();
+    } else {
+        inflateGzipChunks();
+    }
+}
+
+
+
+// Read compressed chunks in the ring of chunks, waiting
+// when all chunks are still waiting to be inflated.
+void ReadLoader::readGzipChunks()
+{
+    for(uint64_t i=0; ; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            gzipChunkCondition.wait(lock,
+                [&]{return i - gzipChunkConsumedCount < gzipChunkCount;});
+        }
+
+        // Fill this chunk.
+        GzipChunk& chunk = gzipChunks[i % gzipChunkCount];
+        chunk.size = 0;
+        while(chunk.size < gzipChunkSize) {
+            const int64_t bytesRead = ::read(gzipFileDescriptor,
+                chunk.data.data() + chunk.size, gzipChunkSize - chunk.size);
+            if(bytesRead == -1) {
+                throw runtime_error("Error reading from " + fileName + ".");
+            }
+            if(bytesRead == 0) {
+                break;
+            }
+            chunk.size += bytesRead;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(chunk.size == 0) {
+            gzipEndOfFile = true;
+            gzipChunkCondition.notify_all();
+            return;
+        }
+        gzipChunkReadCount = i + 1;
+        gzipChunkCondition.notify_all();
+    }
+}
+
+
+
+// Inflate the compressed chunks as they become available.
+// A gzip file can consist of multiple concatenated members.
+void ReadLoader::inflateGzipChunks()
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, 15 + 16) != Z_OK) {
+        throw runtime_error("Error initializing zlib.");
+    }
+    bool memberEnded = false;
+
+    for(uint64_t i=0; ; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            gzipChunkCondition.wait(lock,
+                [&]{return gzipChunkReadCount > i or gzipEndOfFile;});
+            if(gzipChunkReadCount <= i) {
+                break;
+            }
+        }
+
+        GzipChunk& chunk = gzipChunks[i % gzipChunkCount];
+        stream.next_in = reinterpret_cast<Bytef*>(chunk.data.data());
+        stream.avail_in = uInt(chunk.size);
+        while(stream.avail_in > 0) {
+
+            // If the previous member ended, start a new one.
+            if(memberEnded) {
+                inflateReset(&stream);
+                memberEnded = false;
+            }
+
+            // Make sure we have space in the buffer.
+            if(decompressedByteCount == buffer.size()) {
+                buffer.resize(2 * buffer.size());
+            }
+            const uint64_t availableSize = min(
+                buffer.size() - decompressedByteCount,
+                uint64_t(std::numeric_limits<uInt>::max()));
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.begin() + decompressedByteCount);
+            stream.avail_out = uInt(availableSize);
+
+            const int status = inflate(&stream, Z_NO_FLUSH);
+            decompressedByteCount += availableSize - stream.avail_out;
+            if(status == Z_STREAM_END) {
+                memberEnded = true;
+            } else if(status != Z_OK and status != Z_BUF_ERROR) {
+                inflateEnd(&stream);
+                throw runtime_error("Error decompressing " + fileName +
+                    " near decompressed offset " + to_string(decompressedByteCount) + ".");
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        gzipChunkConsumedCount = i + 1;
+        gzipChunkCondition.notify_all();
+    }
+
+    inflateEnd(&stream);
+    if(not memberEnded) {
+        throw runtime_error("Unexpected end of compressed file " + fileName + ".");
+    }
+}
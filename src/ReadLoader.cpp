@@ -2,9 +2,15 @@
 #include "ReadLoader.hpp"
 #include "CompressedRunnieReader.hpp"
 #include "computeRunLengthRepresentation.hpp"
+#include "findCharacters.hpp"
+#include "ReadSubsampler.hpp"
 #include "splitRange.hpp"
 using namespace shasta;
 
+// Linux.
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 // Standard library.
 #include "chrono.hpp"
 #include "iterator.hpp"
@@ -16,23 +22,31 @@ ReadLoader::ReadLoader(
     const string& fileName,
     size_t minReadLength,
     size_t threadCount,
+    uint64_t loadBufferSize,
     const string& dataNamePrefix,
     size_t pageSize,
     LongBaseSequences& reads,
     MemoryMapped::VectorOfVectors<char, uint64_t>& readNames,
-    MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts) :
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts,
+    ostream& out,
+    ReadSubsampler* readSubsampler) :
 
     MultithreadedObject(*this),
     fileName(fileName),
     minReadLength(minReadLength),
     threadCount(threadCount),
+    loadBufferSize(loadBufferSize),
     dataNamePrefix(dataNamePrefix),
     pageSize(pageSize),
     reads(reads),
     readNames(readNames),
-    readRepeatCounts(readRepeatCounts)
+    readRepeatCounts(readRepeatCounts),
+    out(out),
+    readSubsampler(readSubsampler)
 {
-    cout << timestamp << "Loading reads from " << fileName << endl;
+    out << timestamp << "Loading reads from " << fileName << endl;
+    out << "Character scanning uses " << findCharactersInstructionSet() <<
+        " instructions." << endl;
 
     adjustThreadCount();
 
@@ -45,6 +59,18 @@ ReadLoader::ReadLoader(
             " must have an extension consistent with its format.");
     }
 
+    // Gzip compressed file. The extension that precedes the .gz
+    // determines the format of the decompressed data.
+    if(extension=="gz" || extension=="GZ") {
+        isGzipCompressed = true;
+        try {
+            extension = filesystem::extension(filesystem::fileName(fileName));
+        } catch (...) {
+            throw runtime_error("Compressed input file " + fileName +
+                " must have an extension consistent with its format before the .gz.");
+        }
+    }
+
     // Fasta file. ReadLoader is more forgiving than OldFastaReadLoader.
     if(extension=="fasta" || extension=="fa" || extension=="FASTA" || extension=="FA") {
         processFastaFile();
@@ -59,13 +85,18 @@ ReadLoader::ReadLoader(
 
     // Runnie compressed file.
     if(extension=="rq" || extension=="RQ") {
+        if(isGzipCompressed) {
+            throw runtime_error("Gzip compression is not supported for .rq files.");
+        }
         processCompressedRunnieFile();
         return;
     }
 
     // If getting here, the file extension is not supported.
     throw runtime_error("File extension " + extension + " is not supported. "
-        "Supported file extensions are .fasta, .fa, .FASTA, .FA.");
+        "Supported file extensions are .fasta, .fa, .FASTA, .FA, "
+        ".fastq, .fq, .FASTQ, .FQ, .rq, .RQ, "
+        "optionally followed by .gz for fasta and fastq files.");
 }
 
 void ReadLoader::adjustThreadCount()
@@ -79,6 +110,12 @@ void ReadLoader::adjustThreadCount()
 
 void ReadLoader::processFastaFile()
 {
+    // If requested, process the file in chunks of bounded size.
+    // This is not supported for compressed files.
+    if(loadBufferSize and not isGzipCompressed) {
+        processFastaFileInChunks();
+        return;
+    }
 
     // Read the entire fasta file.
     const auto t0 = std::chrono::steady_clock::now();
@@ -93,12 +130,12 @@ void ReadLoader::processFastaFile()
     // Store the reads computed by each thread and free
     // the per-thread data structures.
     storeReads();
-    buffer.remove();
+    releaseFile();
     const auto t3 = std::chrono::steady_clock::now();
 
 
-    cout << "Time to process this file:\n" <<
-        "Allocate buffer + read: " << seconds(t1-t0) << " s.\n" <<
+    out << "Time to process this file:\n" <<
+        "Read or map: " << seconds(t1-t0) << " s.\n" <<
         "Parse: " << seconds(t2-t1) << " s.\n"
         "Store: " << seconds(t3-t2) << " s.\n"
         "Total: " << seconds(t3-t0) << " s." << endl;
@@ -112,8 +149,8 @@ void ReadLoader::processFastaFile()
 // is in the file block assigned to the read.
 void ReadLoader::processFastaFileThreadFunction(size_t threadId)
 {
-    const char* bufferPointer = &buffer[0];
-    const uint64_t bufferSize = buffer.size();
+    const char* bufferPointer = inputData.begin();
+    const uint64_t bufferSize = inputData.size();
 
     // Allocate and access the data structures where this thread will store the
     // reads it finds.
@@ -138,13 +175,11 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
             throw runtime_error("Fasta file " + fileName + " does not begin with a \">\".");
         }
     } else {
-        while(!fastaReadBeginsHere(offset)) {
-            ++offset;
-            if(offset == end) {
-                // We reached the end of the block assigned to this thread
-                // without finding any reads.
-                return;
-            }
+        offset = findFastaReadBegin(bufferPointer, begin, end);
+        if(offset == end) {
+            // We reached the end of the block assigned to this thread
+            // without finding any reads.
+            return;
         }
     }
 
@@ -152,8 +187,8 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
 
     // Main loop over the reads in the file block allocated to this thread.
     string readName;
-    vector<Base> read;
-    vector<Base> runLengthRead;
+    vector<char> sequence;
+    LongBaseSequence runLengthRead;
     vector<uint8_t> readRepeatCount;
     while(offset < end) {
         SHASTA_ASSERT(fastaReadBeginsHere(offset));
@@ -177,15 +212,10 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
         }
 
         // Read the rest of the line.
-        while(true) {
-            if(offset == bufferSize) {
-                throw runtime_error("Reached end of file while processing header line for read "
-                    + readName);
-            }
-            if(bufferPointer[offset] == '\n') {
-                break;
-            }
-            ++offset;
+        offset = findCharacter(bufferPointer, offset, bufferSize, '\n');
+        if(offset == bufferSize) {
+            throw runtime_error("Reached end of file while processing header line for read "
+                + readName);
         }
 
         // Consume the line end at the end of the header line.
@@ -193,57 +223,79 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
 
 
 
-        // Read the bases.
+        // Gather the sequence characters, one line at a time.
         // Note that here we can go past the file block assigned to this thread.
-        read.clear();
-        uint64_t invalidBaseCount = 0;
+        sequence.clear();
         while(offset != bufferSize) {
-            const char c = bufferPointer[offset];
-
-            // Skip white space.
-            if(c==' ' || c=='\t' || c=='\n' || c=='\r') {
-                ++offset;
-                continue;
-            }
 
+            // We are at the beginning of a line.
             // If we reached the beginning of another read, stop here.
-            if(c=='>' && fastaReadBeginsHere(offset))  {
+            if(bufferPointer[offset] == '>')  {
                 break;
             }
 
-            // Get a base from this character.
-            const Base base = Base::fromCharacterNoException(c);
-            if(base.isValid()) {
-                read.push_back(base);
-            } else {
-                ++invalidBaseCount;
+            // Append the characters on this line, without the line end.
+            const uint64_t lineEnd = findCharacter(bufferPointer, offset, bufferSize, '\n');
+            uint64_t sequenceLineEnd = lineEnd;
+            if(sequenceLineEnd != offset && bufferPointer[sequenceLineEnd-1] == '\r') {
+                --sequenceLineEnd;
+            }
+            sequence.insert(sequence.end(), bufferPointer + offset, bufferPointer + sequenceLineEnd);
+            offset = lineEnd;
+
+            // Consume the line end, if there is one.
+            if(offset != bufferSize) {
+                ++offset;
             }
-            ++offset;
         }
 
+        // Validate the bases and compute the run-length representation
+        // in a single pass.
+        uint64_t invalidBaseOffset = 0;
+        RunLengthStatus status = computeRunLengthRepresentation(
+            sequence.data(), sequence.data() + sequence.size(),
+            runLengthRead, readRepeatCount, invalidBaseOffset);
+
+        // White space is allowed in the sequence lines.
+        // This is rare, so we only remove it if necessary and try again.
+        if(status == RunLengthStatus::invalidBase) {
+            sequence.erase(remove_if(sequence.begin(), sequence.end(),
+                [](char c) {return c==' ' || c=='\t' || c=='\r';}),
+                sequence.end());
+            status = computeRunLengthRepresentation(
+                sequence.data(), sequence.data() + sequence.size(),
+                runLengthRead, readRepeatCount, invalidBaseOffset);
+        }
 
         // If we found invalid bases, skip this read.
-        if(invalidBaseCount) {
+        if(status == RunLengthStatus::invalidBase) {
+            const uint64_t validBaseCount = uint64_t(count_if(sequence.begin(), sequence.end(),
+                [](char c) {return Base::fromCharacterNoException(c).isValid();}));
             __sync_fetch_and_add(&discardedInvalidBaseReadCount, 1);
-            __sync_fetch_and_add(&discardedInvalidBaseReadCount, read.size());
+            __sync_fetch_and_add(&discardedInvalidBaseBaseCount, validBaseCount);
             continue;
         }
 
         // If the read is too short, skip it.
-        if(read.size() < minReadLength) {
+        const uint64_t baseCount = sequence.size();
+        if(baseCount < minReadLength) {
             __sync_fetch_and_add(&discardedShortReadReadCount, 1);
-            __sync_fetch_and_add(&discardedShortReadBaseCount, read.size());
+            __sync_fetch_and_add(&discardedShortReadBaseCount, baseCount);
             continue;
         }
 
-        // Store the read bases.
-        if(computeRunLengthRepresentation(read, runLengthRead, readRepeatCount)) {
+        // Store the read bases, unless it is not selected by the ReadSubsampler.
+        if(status == RunLengthStatus::success) {
+            if(readSubsampler and not readSubsampler->select(
+                readName.data(), readName.data() + readName.size(), baseCount)) {
+                continue;
+            }
             thisThreadReadNames.appendVector(readName.begin(), readName.end());
             thisThreadReads.append(runLengthRead);
             thisThreadReadRepeatCounts.appendVector(readRepeatCount);
         } else {
             __sync_fetch_and_add(&discardedBadRepeatCountReadCount, 1);
-            __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, read.size());
+            __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, baseCount);
         }
     }
 
@@ -255,11 +307,11 @@ void ReadLoader::processFastaFileThreadFunction(size_t threadId)
 // at this position in Fasta format.
 bool ReadLoader::fastaReadBeginsHere(uint64_t offset) const
 {
-    if(buffer[offset] == '>') {
+    if(inputData[offset] == '>') {
         if(offset == 0) {
             return true;
         } else {
-            return buffer[offset-1] == '\n';
+            return inputData[offset-1] == '\n';
         }
     } else {
         return false;
@@ -280,6 +332,12 @@ bool ReadLoader::fastaReadBeginsHere(uint64_t offset) const
 // - No Windows line ends.
 void ReadLoader::processFastqFile()
 {
+    // If requested, process the file in chunks of bounded size.
+    // This is not supported for compressed files.
+    if(loadBufferSize and not isGzipCompressed) {
+        processFastqFileInChunks();
+        return;
+    }
 
     // Read the entire fastq file.
     const auto t0 = std::chrono::steady_clock::now();
@@ -288,7 +346,7 @@ void ReadLoader::processFastqFile()
     // Find all line ends in the file.
     const auto t1 = std::chrono::steady_clock::now();
     findLineEnds();
-    cout << "Found " << lineEnds.size() << " lines in this file." << endl;
+    out << "Found " << lineEnds.size() << " lines in this file." << endl;
 
     // Check that the number of lines is a multiple of 4
     // (there must be exactly 4 mlines per read per the above assumptions).
@@ -308,12 +366,12 @@ void ReadLoader::processFastqFile()
     // the per-thread data structures.
     const auto t3 = std::chrono::steady_clock::now();
     storeReads();
-    buffer.remove();
+    releaseFile();
     const auto t4 = std::chrono::steady_clock::now();
 
 
-    cout << "Time to process this file:\n" <<
-        "Allocate buffer + read: " << seconds(t1-t0) << " s.\n" <<
+    out << "Time to process this file:\n" <<
+        "Read or map: " << seconds(t1-t0) << " s.\n" <<
         "Locate: " << seconds(t2-t1) << " s.\n"
         "Parse: " << seconds(t3-t2) << " s.\n"
         "Store: " << seconds(t4-t3) << " s.\n"
@@ -348,10 +406,9 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
 
     // Loop over this range of reads.
     string readName;
-    vector<Base> read;
-    vector<Base> runLengthRead;
+    LongBaseSequence runLengthRead;
     vector<uint8_t> readRepeatCount;
-    const auto fileBegin = buffer.begin();
+    const auto fileBegin = inputData.begin();
     for(uint64_t i=begin; i!=end; i++) {
 
         // Locate the 4 line ends corresponding to this read.
@@ -427,48 +484,63 @@ void ReadLoader::processFastqFileThreadFunction(size_t threadId)
                 );
         }
 
-        // Get the bases.
-        read.clear();
-        for(auto it=sequenceBegin; it!=sequenceEnd; ++it) {
-            const char c = *it;
-            const Base base = Base::fromCharacterNoException(c);
-            if(!base.isValid()) {
-                throw runtime_error("Invalid base " + string(1, c) + " for read " +
-                    readName + " at offset " + to_string(it-fileBegin) + ".");
-            }
-            read.push_back(base);
+        // Validate the bases and compute the run-length representation
+        // in a single pass.
+        uint64_t invalidBaseOffset = 0;
+        const RunLengthStatus status = computeRunLengthRepresentation(
+            sequenceBegin, sequenceEnd, runLengthRead, readRepeatCount, invalidBaseOffset);
+        if(status == RunLengthStatus::invalidBase) {
+            const auto it = sequenceBegin + invalidBaseOffset;
+            throw runtime_error("Invalid base " + string(1, *it) + " for read " +
+                readName + " at offset " + to_string(it-fileBegin) + ".");
         }
 
         // If the read is too short, skip it.
-        if(read.size() < minReadLength) {
+        if(uint64_t(baseCount) < minReadLength) {
             __sync_fetch_and_add(&discardedShortReadReadCount, 1);
-            __sync_fetch_and_add(&discardedShortReadBaseCount, read.size());
+            __sync_fetch_and_add(&discardedShortReadBaseCount, uint64_t(baseCount));
             continue;
         }
 
-        // Store the read.
-        if(computeRunLengthRepresentation(read, runLengthRead, readRepeatCount)) {
+        // Store the read, unless it is not selected by the ReadSubsampler.
+        if(status == RunLengthStatus::success) {
+            if(readSubsampler and not readSubsampler->select(
+                readName.data(), readName.data() + readName.size(), uint64_t(baseCount))) {
+                continue;
+            }
             thisThreadReadNames.appendVector(readName.begin(), readName.end());
             thisThreadReads.append(runLengthRead);
             thisThreadReadRepeatCounts.appendVector(readRepeatCount);
         } else {
             __sync_fetch_and_add(&discardedBadRepeatCountReadCount, 1);
-            __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, read.size());
+            __sync_fetch_and_add(&discardedBadRepeatCountBaseCount, uint64_t(baseCount));
         }
     }
 }
 
 
 
-// Read an entire file into a buffer,
-// using threadCountForReading threads.
+// Make the contents of the input file available in inputData.
 void ReadLoader::readFile()
 {
-    // Resize our buffer to contain the entire file.
+    // Gzip compressed files are decompressed into the buffer.
+    if(isGzipCompressed) {
+        readGzipFile();
+        inputData = MemoryAsContainer<const char>(buffer.begin(), buffer.end());
+        return;
+    }
+
+    // Regular files are parsed directly from a read-only mapping.
+    if(mapFile()) {
+        return;
+    }
+
+    // Otherwise, read the file into the buffer.
+    // This is used for pipes and other files that cannot be mapped,
+    // so we don't rely on the file size and read until end of file.
     const auto t0 = std::chrono::steady_clock::now();
-    int64_t bytesToRead = filesystem::fileSize(fileName);
     buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
-    buffer.resize(bytesToRead);
+    buffer.resize(max(uint64_t(1024 * 1024), uint64_t(filesystem::fileSize(fileName))));
 
     // Open the input file.
     const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
@@ -478,32 +550,383 @@ void ReadLoader::readFile()
 
     // Read it in.
     const auto t1 = std::chrono::steady_clock::now();
-    char* bufferPointer = &buffer[0];
-    while(bytesToRead) {
-        const int64_t bytesRead = ::read(fileDescriptor, bufferPointer, bytesToRead);
-        if(bytesRead == -1) {
+    uint64_t bytesRead = 0;
+    while(true) {
+        if(bytesRead == buffer.size()) {
+            buffer.resize(2 * buffer.size());
+        }
+        const int64_t n = ::read(fileDescriptor, buffer.begin() + bytesRead, buffer.size() - bytesRead);
+        if(n == -1) {
             ::close(fileDescriptor);
             throw runtime_error("Error reading from " + fileName + " near offset " +
-                to_string(buffer.size()-bytesToRead));
+                to_string(bytesRead));
+        }
+        if(n == 0) {
+            break;
         }
-        bufferPointer += bytesRead;
-        bytesToRead -= bytesRead;
+        bytesRead += uint64_t(n);
     }
     ::close(fileDescriptor);
+    buffer.resize(bytesRead);
+    inputData = MemoryAsContainer<const char>(buffer.begin(), buffer.end());
     const auto t2 = std::chrono::steady_clock::now();
     const double t01 = seconds(t1 - t0);
     const double t12 = seconds(t2 - t1);
 
-    cout <<  "File size: " << buffer.size() << " bytes." << endl;
-    cout << "Allocate buffer time: " << t01 << " s." << endl;
-    cout << "Read time: " << t12 << " s." << endl;
-    cout << "Read rate: " << double(buffer.size()) / t12 << " bytes/s." << endl;
+    out <<  "File size: " << buffer.size() << " bytes." << endl;
+    out << "Allocate buffer time: " << t01 << " s." << endl;
+    out << "Read time: " << t12 << " s." << endl;
+    out << "Read rate: " << double(buffer.size()) / t12 << " bytes/s." << endl;
 
 
 }
 
 
 
+// If the input file is a non-empty regular file, map it read-only
+// and make inputData point to the mapping.
+// This avoids copying the file and the extra page cache use
+// of reading it into the buffer.
+// Returns false if the file cannot be mapped.
+bool ReadLoader::mapFile()
+{
+    const int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if(fileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + " for read.");
+    }
+    struct stat fileInformation;
+    if(::fstat(fileDescriptor, &fileInformation) == -1) {
+        ::close(fileDescriptor);
+        throw runtime_error("Error obtaining file information for " + fileName + ".");
+    }
+    if(not S_ISREG(fileInformation.st_mode) or fileInformation.st_size == 0) {
+        ::close(fileDescriptor);
+        return false;
+    }
+    const uint64_t fileSize = uint64_t(fileInformation.st_size);
+    void* pointer = ::mmap(0, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    if(pointer == MAP_FAILED) {
+        out << "Unable to map " << fileName << ", reading it instead." << endl;
+        return false;
+    }
+
+    // Each thread scans its portion of the file sequentially.
+    ::madvise(pointer, fileSize, MADV_SEQUENTIAL);
+
+    mappedFilePointer = pointer;
+    mappedFileSize = fileSize;
+    const char* begin = static_cast<const char*>(pointer);
+    inputData = MemoryAsContainer<const char>(begin, begin + fileSize);
+    out <<  "File size: " << fileSize << " bytes. The file was mapped read-only." << endl;
+    return true;
+}
+
+
+
+// Release the input file mapping or the buffer,
+// whichever was used by readFile.
+void ReadLoader::releaseFile()
+{
+    if(mappedFilePointer) {
+        ::munmap(mappedFilePointer, mappedFileSize);
+        mappedFilePointer = 0;
+        mappedFileSize = 0;
+    } else {
+        buffer.remove();
+    }
+    inputData = MemoryAsContainer<const char>();
+}
+
+
+
+// Process a fasta file in chunks of approximately loadBufferSize bytes.
+// Only one chunk is processed at any given time,
+// while the next one is read by a separate thread.
+void ReadLoader::processFastaFileInChunks()
+{
+    out << "Processing this file in chunks of " << loadBufferSize << " bytes." << endl;
+    double readTime = 0.;
+    double parseTime = 0.;
+    double storeTime = 0.;
+    uint64_t chunkCount = 0;
+
+    openChunkedFile();
+    try {
+        while(true) {
+
+            // Read the next chunk.
+            const auto t0 = std::chrono::steady_clock::now();
+            readChunk();
+            if(inputData.empty()) {
+                break;
+            }
+
+            // Cut the chunk at the beginning of the last read,
+            // unless we reached the end of file.
+            // If the chunk contains only a partial read, keep
+            // it all and read more.
+            if(not chunkEndOfFile) {
+                const uint64_t boundary = findLastFastaReadBegin();
+                carryOverChunkTail(boundary);
+                if(boundary == 0) {
+                    continue;
+                }
+            }
+
+            // Parse the reads in this chunk, then store them.
+            const auto t1 = std::chrono::steady_clock::now();
+            allocatePerThreadDataStructures();
+            runThreads(&ReadLoader::processFastaFileThreadFunction, threadCount);
+            const auto t2 = std::chrono::steady_clock::now();
+            storeReads();
+            const auto t3 = std::chrono::steady_clock::now();
+
+            readTime += seconds(t1 - t0);
+            parseTime += seconds(t2 - t1);
+            storeTime += seconds(t3 - t2);
+            ++chunkCount;
+        }
+    } catch(...) {
+        closeChunkedFile();
+        throw;
+    }
+    closeChunkedFile();
+
+    out << "Time to process this file in " << chunkCount << " chunks:\n" <<
+        "Read: " << readTime << " s.\n" <<
+        "Parse: " << parseTime << " s.\n"
+        "Store: " << storeTime << " s.\n"
+        "Total: " << readTime + parseTime + storeTime << " s." << endl;
+}
+
+
+
+// Process a fastq file in chunks of approximately loadBufferSize bytes.
+// Only one chunk is processed at any given time,
+// while the next one is read by a separate thread.
+void ReadLoader::processFastqFileInChunks()
+{
+    out << "Processing this file in chunks of " << loadBufferSize << " bytes." << endl;
+    double readTime = 0.;
+    double locateTime = 0.;
+    double parseTime = 0.;
+    double storeTime = 0.;
+    uint64_t chunkCount = 0;
+
+    openChunkedFile();
+    try {
+        while(true) {
+
+            // Read the next chunk.
+            const auto t0 = std::chrono::steady_clock::now();
+            readChunk();
+            if(inputData.empty()) {
+                break;
+            }
+
+            // Find the line ends in the portion of this chunk
+            // that was not already scanned.
+            const auto t1 = std::chrono::steady_clock::now();
+            lineEnds.swap(chunkCarryOverLineEnds);
+            chunkCarryOverLineEnds.clear();
+            findLineEnds();
+
+            // Cut the chunk after the last complete read,
+            // unless we reached the end of file.
+            // If the chunk contains only a partial read, keep
+            // it all and read more.
+            if(chunkEndOfFile) {
+                if((lineEnds.size() %4) != 0) {
+                    throw runtime_error("File " + fileName + " ends with an incomplete read. "
+                        "Only fastq files with each read on exactly 4 lines are supported.");
+                }
+            } else {
+                const uint64_t completeReadCount = lineEnds.size() / 4;
+                const uint64_t boundary = (completeReadCount == 0) ? 0 :
+                    lineEnds[4 * completeReadCount - 1] + 1;
+                for(uint64_t i=4*completeReadCount; i<lineEnds.size(); i++) {
+                    chunkCarryOverLineEnds.push_back(lineEnds[i] - boundary);
+                }
+                lineEnds.resize(4 * completeReadCount);
+                carryOverChunkTail(boundary);
+                if(boundary == 0) {
+                    continue;
+                }
+            }
+
+            // Parse the reads in this chunk, then store them.
+            const auto t2 = std::chrono::steady_clock::now();
+            allocatePerThreadDataStructures();
+            runThreads(&ReadLoader::processFastqFileThreadFunction, threadCount);
+            const auto t3 = std::chrono::steady_clock::now();
+            storeReads();
+            const auto t4 = std::chrono::steady_clock::now();
+
+            readTime += seconds(t1 - t0);
+            locateTime += seconds(t2 - t1);
+            parseTime += seconds(t3 - t2);
+            storeTime += seconds(t4 - t3);
+            ++chunkCount;
+        }
+    } catch(...) {
+        closeChunkedFile();
+        throw;
+    }
+    closeChunkedFile();
+    lineEnds.clear();
+
+    out << "Time to process this file in " << chunkCount << " chunks:\n" <<
+        "Read: " << readTime << " s.\n" <<
+        "Locate: " << locateTime << " s.\n"
+        "Parse: " << parseTime << " s.\n"
+        "Store: " << storeTime << " s.\n"
+        "Total: " << readTime + locateTime + parseTime + storeTime << " s." << endl;
+}
+
+
+
+// Return the offset in the buffer of the last read that begins
+// in the buffer, or 0 if there is only one.
+// The portion of the buffer already scanned in previous chunks
+// is known not to contain a read beginning, other than at offset 0,
+// so it is not scanned again.
+uint64_t ReadLoader::findLastFastaReadBegin() const
+{
+    const uint64_t scanBegin = max(chunkScannedSize, uint64_t(1));
+    for(uint64_t offset=inputData.size(); offset>scanBegin; ) {
+        --offset;
+        if(fastaReadBeginsHere(offset)) {
+            return offset;
+        }
+    }
+    return 0;
+}
+
+
+
+void ReadLoader::openChunkedFile()
+{
+    chunkFileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if(chunkFileDescriptor == -1) {
+        throw runtime_error("Error opening " + fileName + " for read.");
+    }
+    chunkEndOfFile = false;
+    chunkCarryOverBegin = 0;
+    chunkScannedSize = 0;
+    chunkCarryOverLineEnds.clear();
+    buffer.createNew(dataName("tmp-FastaBuffer"), pageSize);
+    nextChunk.resize(loadBufferSize);
+    startNextChunkRead();
+}
+
+
+
+void ReadLoader::closeChunkedFile()
+{
+    if(nextChunkThread.joinable()) {
+        nextChunkThread.join();
+    }
+    ::close(chunkFileDescriptor);
+    chunkFileDescriptor = -1;
+    chunkScannedSize = 0;
+    chunkCarryOverLineEnds.clear();
+    nextChunk.clear();
+    nextChunk.shrink_to_fit();
+    buffer.remove();
+    inputData = MemoryAsContainer<const char>();
+}
+
+
+
+// Fill the buffer with the bytes carried over from the previous chunk,
+// followed by the next chunk of up to loadBufferSize bytes,
+// then start reading the following chunk.
+void ReadLoader::readChunk()
+{
+    // If we already reached the end of file, the last
+    // chunk was processed entirely and there is nothing left.
+    if(chunkEndOfFile) {
+        buffer.resize(0);
+        inputData = MemoryAsContainer<const char>(buffer.begin(), buffer.end());
+        return;
+    }
+
+    // Move the carried over bytes to the beginning of the buffer.
+    const uint64_t carryOverSize = buffer.size() - chunkCarryOverBegin;
+    if(chunkCarryOverBegin != 0) {
+        copy(buffer.begin() + chunkCarryOverBegin, buffer.end(), buffer.begin());
+    }
+    chunkCarryOverBegin = 0;
+
+    // Append the next chunk.
+    waitForNextChunk();
+    buffer.resize(carryOverSize + nextChunkSize);
+    copy(nextChunk.begin(), nextChunk.begin() + nextChunkSize, buffer.begin() + carryOverSize);
+    chunkEndOfFile = nextChunkEndOfFile;
+    inputData = MemoryAsContainer<const char>(buffer.begin(), buffer.end());
+
+    // Read the following chunk while this one is processed.
+    if(not chunkEndOfFile) {
+        startNextChunkRead();
+    }
+}
+
+
+
+// Move the portion of the buffer beginning at the
+// specified offset to the next chunk.
+// It was already scanned, so it does not need to be scanned again.
+void ReadLoader::carryOverChunkTail(uint64_t boundary)
+{
+    chunkCarryOverBegin = boundary;
+    chunkScannedSize = buffer.size() - boundary;
+    inputData = MemoryAsContainer<const char>(buffer.begin(), buffer.begin() + boundary);
+}
+
+
+
+void ReadLoader::startNextChunkRead()
+{
+    nextChunkThread = std::thread(&ReadLoader::readNextChunk, this);
+}
+
+
+
+// Read up to loadBufferSize bytes into nextChunk.
+// This runs in its own thread, so errors are stored
+// and reported by waitForNextChunk.
+void ReadLoader::readNextChunk()
+{
+    nextChunkSize = 0;
+    nextChunkEndOfFile = false;
+    while(nextChunkSize < loadBufferSize) {
+        const int64_t bytesRead = ::read(chunkFileDescriptor,
+            nextChunk.data() + nextChunkSize, loadBufferSize - nextChunkSize);
+        if(bytesRead == -1) {
+            nextChunkError = "Error reading from " + fileName + ".";
+            return;
+        }
+        if(bytesRead == 0) {
+            nextChunkEndOfFile = true;
+            return;
+        }
+        nextChunkSize += uint64_t(bytesRead);
+    }
+}
+
+
+
+void ReadLoader::waitForNextChunk()
+{
+    nextChunkThread.join();
+    if(not nextChunkError.empty()) {
+        throw runtime_error(nextChunkError);
+    }
+}
+
+
+
 // Find all of the line ends ('\n') in the buffer.
 void ReadLoader::findLineEnds()
 {
@@ -527,17 +950,15 @@ void ReadLoader::findLineEndsThreadFunction(size_t threadId)
 
     // Compute the file block assigned to this thread.
     uint64_t begin, end;
-    tie(begin, end) = splitRange(0, buffer.size(), threadCount, threadId);
+    // When processing a file in chunks, the bytes carried over
+    // from the previous chunk were already scanned.
+    tie(begin, end) = splitRange(chunkScannedSize, inputData.size(), threadCount, threadId);
     if(begin == end) {
         return;
     }
 
     // Look for line ends in this block.
-    for(uint64_t offset=begin; offset!=end; offset++) {
-        if(buffer[offset] == '\n') {
-            thisThreadLineEnds.push_back(offset);
-        }
-    }
+    findCharacters(inputData.begin(), begin, end, '\n', thisThreadLineEnds);
 }
 
 
@@ -591,8 +1012,9 @@ void ReadLoader::allocatePerThreadDataStructures(size_t threadId)
 
 
 // Compressed runnie file, via class CompressedRunnieReader.
-// For now this is sequential but it could be made faster
-// using CompressedRunnieReader functionality.
+// The CompressedRunnieReader maps the file and parses its index.
+// Space for the reads is then allocated sequentially, and each thread
+// decodes its batches of reads directly from the mapping.
 void ReadLoader::processCompressedRunnieFile()
 {
     const auto t0 = std::chrono::steady_clock::now();
@@ -601,7 +1023,7 @@ void ReadLoader::processCompressedRunnieFile()
     compressedRunnieReader = make_shared<CompressedRunnieReader>(fileName);
     CompressedRunnieReader& reader = *compressedRunnieReader;
     const uint64_t readCountInFile = reader.getReadCount();
-    cout << "Input file contains " << readCountInFile << " reads." << endl;
+    out << "Input file contains " << readCountInFile << " reads." << endl;
 
     // Use single-threaded code to create the space.
     readIdTable.resize(readCountInFile);
@@ -609,6 +1031,19 @@ void ReadLoader::processCompressedRunnieFile()
     for(uint64_t i=0; i!=readCountInFile; i++) {
         const uint64_t baseCount = reader.getLength(i);
         if(baseCount >= minReadLength) {
+            if(readSubsampler) {
+                const string& readName = reader.getReadName(i);
+                const uint8_t* encoding = reader.getEncodingBegin(i);
+                uint64_t rawBaseCount = 0;
+                for(uint64_t j=0; j<baseCount; j++) {
+                    rawBaseCount += encoding[j];
+                }
+                if(not readSubsampler->select(
+                    readName.data(), readName.data() + readName.size(), rawBaseCount)) {
+                    readIdTable[i] = invalidReadId;
+                    continue;
+                }
+            }
             readNames.appendVector(reader.getReadName(i).size());
             reads.append(baseCount);
             readRepeatCounts.appendVector(baseCount);
@@ -626,7 +1061,7 @@ void ReadLoader::processCompressedRunnieFile()
     compressedRunnieReader = 0;
 
     const auto t1 = std::chrono::steady_clock::now();
-    cout << "Input file read and processed in " <<
+    out << "Input file read and processed in " <<
         seconds(t1-t0) << " s." << endl;
 }
 
@@ -638,7 +1073,6 @@ void ReadLoader::processCompressedRunnieFileThreadFunction(size_t threadId)
 
     // Loop over all batches assigned to this thread.
     uint64_t begin, end;
-    NamedCompressedRunnieSequence read;
     while(getNextBatch(begin, end)) {
 
         // Loop over all reads in this batch.
@@ -647,13 +1081,16 @@ void ReadLoader::processCompressedRunnieFileThreadFunction(size_t threadId)
             if(readId == invalidReadId) {
                 continue;
             }
-            reader.getSequenceData(read, i);
-            copy(read.name.begin(), read.name.end(), readNames.begin(readId));
+            const string& readName = reader.getReadName(i);
+            copy(readName.begin(), readName.end(), readNames.begin(readId));
+            const uint64_t length = reader.getLength(i);
+            const char* sequence = reader.getSequenceBegin(i);
             LongBaseSequenceView storedSequence = reads[readId];
-            for(uint64_t j=0; j<read.sequence.size(); j++) {
-                storedSequence.set(j, Base::fromCharacter(read.sequence[j]));
+            for(uint64_t j=0; j<length; j++) {
+                storedSequence.set(j, Base::fromCharacter(sequence[j]));
             }
-            copy(read.encoding.begin(), read.encoding.end(), readRepeatCounts.begin(readId));
+            const uint8_t* encoding = reader.getEncodingBegin(i);
+            copy(encoding, encoding + length, readRepeatCounts.begin(readId));
         }
     }
 
@@ -665,40 +1102,45 @@ void ReadLoader::processCompressedRunnieFileThreadFunction(size_t threadId)
 // the per-thread data structures.
 void ReadLoader::storeReads()
 {
-    // Loop over all threads.
+    const uint64_t oldReadCount = reads.size();
+    SHASTA_ASSERT(readNames.size() == oldReadCount);
+    SHASTA_ASSERT(readRepeatCounts.size() == oldReadCount);
+
+    // Compute the positions where the reads of each thread will be stored.
+    threadReadBegin.resize(threadCount + 1);
+    threadReadNameBegin.resize(threadCount + 1);
+    threadReadWordBegin.resize(threadCount + 1);
+    threadReadRepeatCountBegin.resize(threadCount + 1);
+    threadReadBegin[0] = oldReadCount;
+    threadReadNameBegin[0] = readNames.totalSize();
+    threadReadWordBegin[0] = reads.totalWordCount();
+    threadReadRepeatCountBegin[0] = readRepeatCounts.totalSize();
     for(size_t threadId=0; threadId<threadCount; threadId++) {
+        const uint64_t n = threadReads[threadId]->size();
+        SHASTA_ASSERT(threadReadNames[threadId]->size() == n);
+        SHASTA_ASSERT(threadReadRepeatCounts[threadId]->size() == n);
+        threadReadBegin[threadId + 1] =
+            threadReadBegin[threadId] + n;
+        threadReadNameBegin[threadId + 1] =
+            threadReadNameBegin[threadId] + threadReadNames[threadId]->totalSize();
+        threadReadWordBegin[threadId + 1] =
+            threadReadWordBegin[threadId] + threadReads[threadId]->totalWordCount();
+        threadReadRepeatCountBegin[threadId + 1] =
+            threadReadRepeatCountBegin[threadId] + threadReadRepeatCounts[threadId]->totalSize();
+    }
 
-        // Access the names.
-        MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames =
-            *(threadReadNames[threadId]);
-
-        // Access the reads.
-        LongBaseSequences& thisThreadReads = *(threadReads[threadId]);
-        const size_t n = thisThreadReadNames.size();
-        SHASTA_ASSERT(thisThreadReads.size() == n);
-
-        // Access the repeat counts.
-        MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
-            *threadReadRepeatCounts[threadId];
-        SHASTA_ASSERT(thisThreadReadRepeatCounts.size() == n);
+    // Make space for all the new reads.
+    const uint64_t newReadCount = threadReadBegin[threadCount] - oldReadCount;
+    reads.appendUninitialized(newReadCount,
+        threadReadWordBegin[threadCount] - threadReadWordBegin[0]);
+    readNames.appendUninitializedVectors(newReadCount,
+        threadReadNameBegin[threadCount] - threadReadNameBegin[0]);
+    readRepeatCounts.appendUninitializedVectors(newReadCount,
+        threadReadRepeatCountBegin[threadCount] - threadReadRepeatCountBegin[0]);
 
-        // Store the reads.
-        for(size_t i=0; i<n; i++) {
-            readNames.appendVector(thisThreadReadNames.begin(i), thisThreadReadNames.end(i));
-            reads.append(thisThreadReads[i]);
-            const size_t j = readRepeatCounts.size();
-            readRepeatCounts.appendVector(thisThreadReadRepeatCounts.size(i));
-            copy(
-                thisThreadReadRepeatCounts.begin(i),
-                thisThreadReadRepeatCounts.end(i),
-                readRepeatCounts.begin(j));
-        }
-
-        // Remove the data structures used by this thread.
-        thisThreadReadNames.remove();
-        thisThreadReads.remove();
-        thisThreadReadRepeatCounts.remove();
-    }
+    // Each thread copies its reads into place
+    // and removes its data structures.
+    runThreads(&ReadLoader::storeReadsThreadFunction, threadCount);
 
     // Clear the per-thread data structures.
     threadReadNames.clear();
@@ -707,3 +1149,26 @@ void ReadLoader::storeReads()
 
 }
 
+
+
+void ReadLoader::storeReadsThreadFunction(size_t threadId)
+{
+    MemoryMapped::VectorOfVectors<char, uint64_t>& thisThreadReadNames =
+        *(threadReadNames[threadId]);
+    LongBaseSequences& thisThreadReads = *(threadReads[threadId]);
+    MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& thisThreadReadRepeatCounts =
+        *threadReadRepeatCounts[threadId];
+
+    // Store the reads.
+    const uint64_t readBegin = threadReadBegin[threadId];
+    readNames.copyVectors(readBegin, threadReadNameBegin[threadId], thisThreadReadNames);
+    reads.copySequences(readBegin, threadReadWordBegin[threadId], thisThreadReads);
+    readRepeatCounts.copyVectors(readBegin, threadReadRepeatCountBegin[threadId],
+        thisThreadReadRepeatCounts);
+
+    // Remove the data structures used by this thread.
+    thisThreadReadNames.remove();
+    thisThreadReads.remove();
+    thisThreadReadRepeatCounts.remove();
+}
+
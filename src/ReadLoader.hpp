@@ -3,15 +3,20 @@
 
 // shasta
 #include "LongBaseSequence.hpp"
+#include "MemoryAsContainer.hpp"
 #include "MemoryMappedObject.hpp"
 #include "MultithreadedObject.hpp"
 
 // Standard library.
+#include <condition_variable>
+#include <thread>
+#include "iostream.hpp"
 #include "memory.hpp"
 #include "string.hpp"
 
 namespace shasta {
     class ReadLoader;
+    class ReadSubsampler;
 }
 class CompressedRunnieReader;
 
@@ -23,15 +28,20 @@ class shasta::ReadLoader :
 public:
 
     // The constructor does all the work.
+    // If a ReadSubsampler is specified, reads it does not select
+    // are not stored.
     ReadLoader(
         const string& fileName,
         size_t minReadLength,
         size_t threadCount,
+        uint64_t loadBufferSize,
         const string& dataNamePrefix,
         size_t pageSize,
         LongBaseSequences& reads,
         MemoryMapped::VectorOfVectors<char, uint64_t>& readNames,
-        MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts);
+        MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts,
+        ostream& out,
+        ReadSubsampler* readSubsampler = 0);
 
     // The number of reads and raw bases discarded because the read
     // contained invalid bases.
@@ -48,6 +58,12 @@ public:
     uint64_t discardedBadRepeatCountReadCount = 0;
     uint64_t discardedBadRepeatCountBaseCount = 0;
 
+    // Statistics on gzip decompression.
+    // These stay at zero if the input file is not compressed.
+    uint64_t compressedByteCount = 0;
+    uint64_t decompressedByteCount = 0;
+    double decompressionTime = 0.;
+
 private:
 
     // The name of the file we are processing.
@@ -62,6 +78,11 @@ private:
     size_t threadCount;
     void adjustThreadCount();
 
+    // If not zero, the file is read and processed in chunks of
+    // this many bytes, instead of reading the entire file at once.
+    // This bounds the memory used by the input buffer.
+    const uint64_t loadBufferSize;
+
     // Information that we can use to create temporary
     // memory mapped binary data structures.
     const string& dataNamePrefix;
@@ -72,6 +93,12 @@ private:
     MemoryMapped::VectorOfVectors<char, uint64_t>& readNames;
     MemoryMapped::VectorOfVectors<uint8_t, uint64_t>& readRepeatCounts;
 
+    // The stream where messages are written.
+    ostream& out;
+
+    // If not zero, used to decide which reads are stored.
+    ReadSubsampler* readSubsampler;
+
     // Create the name to be used for a MemoryMapped object.
     string dataName(
         const string& dataName) const;
@@ -79,10 +106,67 @@ private:
         size_t threadId,
         const string& dataName) const;
 
-    // Read an entire file into a buffer,
-    // using threadCountForReading threads.
+    // Make the entire file available in inputData.
+    // Regular uncompressed files are mapped read-only and parsed in place.
+    // Other files are read into the buffer, and gzip compressed
+    // files are decompressed into the buffer.
     MemoryMapped::Vector<char> buffer;
+    MemoryAsContainer<const char> inputData;
     void readFile();
+    void releaseFile();
+
+    // The read-only mapping of the input file, if one is used.
+    void* mappedFilePointer = 0;
+    uint64_t mappedFileSize = 0;
+    bool mapFile();
+
+
+
+    // Functions and data used for gzip compressed input
+    // (file names ending in .gz). See ReadLoader-Gzip.cpp.
+    // Files in BGZF format (as created by bgzip) consist of independent
+    // gzip blocks and are decompressed by all threads in parallel.
+    // Plain gzip files use a pipeline of two threads: one reads
+    // compressed chunks from the file while the other inflates them.
+    bool isGzipCompressed = false;
+    void readGzipFile();
+
+    // BGZF decompression.
+    class BgzfBlock {
+    public:
+        uint64_t compressedBegin;       // Offset of the compressed deflate data.
+        uint64_t compressedSize;        // Size of the compressed deflate data.
+        uint64_t decompressedBegin;     // Offset in the decompressed buffer.
+        uint32_t decompressedSize;
+        uint32_t crc32;
+    };
+    vector<BgzfBlock> bgzfBlocks;
+    MemoryMapped::Vector<char> compressedBuffer;
+    bool isBgzf() const;
+    void readBgzfFile();
+    bool findBgzfBlocks();
+    void readBgzfFileThreadFunction(size_t threadId);
+
+    // Plain gzip decompression.
+    // Thread 0 fills a ring of compressed chunks,
+    // thread 1 inflates them into the buffer.
+    class GzipChunk {
+    public:
+        vector<char> data;
+        uint64_t size = 0;
+    };
+    const uint64_t gzipChunkSize = 16 * 1024 * 1024;
+    const uint64_t gzipChunkCount = 4;
+    vector<GzipChunk> gzipChunks;
+    int gzipFileDescriptor = -1;
+    uint64_t gzipChunkReadCount = 0;
+    uint64_t gzipChunkConsumedCount = 0;
+    bool gzipEndOfFile = false;
+    std::condition_variable gzipChunkCondition;
+    void readPlainGzipFile();
+    void readPlainGzipFileThreadFunction(size_t threadId);
+    void readGzipChunks();
+    void inflateGzipChunks();
 
     // Vectors where each thread stores the reads it found.
     // Indexed by threadId.
@@ -94,7 +178,51 @@ private:
 
     // Store the reads computed by each thread and free
     // the per-thread data structures.
+    // A prefix sum over the per-thread sizes gives the position
+    // where the reads of each thread go. The global data structures
+    // are then resized once, and each thread copies its own reads into place.
     void storeReads();
+    void storeReadsThreadFunction(size_t threadId);
+    vector<uint64_t> threadReadBegin;
+    vector<uint64_t> threadReadNameBegin;
+    vector<uint64_t> threadReadWordBegin;
+    vector<uint64_t> threadReadRepeatCountBegin;
+
+    // Functions and data used to process the file in chunks
+    // when loadBufferSize is not zero.
+    // Each chunk is stored in the buffer and cut at the beginning
+    // of the last read it contains, which may be incomplete.
+    // The bytes following the cut are moved to the beginning
+    // of the buffer and completed by the next chunk.
+    int chunkFileDescriptor = -1;
+    bool chunkEndOfFile = false;
+    uint64_t chunkCarryOverBegin = 0;
+    void openChunkedFile();
+    void readChunk();
+    void closeChunkedFile();
+    void carryOverChunkTail(uint64_t boundary);
+    void processFastaFileInChunks();
+    void processFastqFileInChunks();
+    uint64_t findLastFastaReadBegin() const;
+
+    // The number of bytes at the beginning of the buffer that were
+    // already scanned for read boundaries or line ends.
+    // Only the bytes that follow are scanned, so each byte
+    // is scanned once even when a read spans many chunks.
+    // For fastq files, the line ends of the carried over bytes are kept.
+    uint64_t chunkScannedSize = 0;
+    vector<uint64_t> chunkCarryOverLineEnds;
+
+    // While a chunk is being parsed, a separate thread
+    // reads the next chunk from the file.
+    std::thread nextChunkThread;
+    vector<char> nextChunk;
+    uint64_t nextChunkSize = 0;
+    bool nextChunkEndOfFile = false;
+    string nextChunkError;
+    void startNextChunkRead();
+    void readNextChunk();
+    void waitForNextChunk();
 
     // Functions used for fasta files.
     void processFastaFile();
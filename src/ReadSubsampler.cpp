@@ -0,0 +1,82 @@
+// Shasta.
+#include "ReadSubsampler.hpp"
+#include "MurmurHash2.hpp"
+using namespace shasta;
+
+// Standard library.
+#include <limits>
+#include <stdexcept>
+
+
+
+ReadSubsampler::ReadSubsampler(
+    double targetCoverage,
+    uint64_t genomeSize,
+    const string& method) :
+    targetCoverage(targetCoverage),
+    genomeSize(genomeSize),
+    method(method),
+    targetBaseCount(uint64_t(targetCoverage * double(genomeSize))),
+    threshold(std::numeric_limits<uint64_t>::max())
+{
+    if(targetCoverage <= 0.) {
+        throw std::runtime_error("Invalid target coverage for read subsampling.");
+    }
+    if(genomeSize == 0) {
+        throw std::runtime_error("A genome size must be specified for read subsampling.");
+    }
+    if(method == "hash") {
+        useHash = true;
+    } else if(method == "longest") {
+        useHash = false;
+    } else {
+        throw std::runtime_error("Invalid read subsampling method " + method +
+            ". Valid methods are hash and longest.");
+    }
+}
+
+
+
+uint64_t ReadSubsampler::getKey(
+    const char* nameBegin,
+    const char* nameEnd,
+    uint64_t rawBaseCount) const
+{
+    if(useHash) {
+        return MurmurHash64A(nameBegin, int(nameEnd - nameBegin), 2113);
+    } else {
+        return std::numeric_limits<uint64_t>::max() - rawBaseCount;
+    }
+}
+
+
+
+bool ReadSubsampler::select(
+    const char* nameBegin,
+    const char* nameEnd,
+    uint64_t rawBaseCount)
+{
+    __sync_fetch_and_add(&totalReadCount, 1);
+    __sync_fetch_and_add(&totalBaseCount, rawBaseCount);
+
+    // Most reads are rejected here, without locking.
+    const uint64_t key = getKey(nameBegin, nameEnd, rawBaseCount);
+    if(key > threshold) {
+        return false;
+    }
+
+    // Add it to the selected reads, then remove the reads
+    // with the greatest keys as long as the remaining ones
+    // still reach the target.
+    std::lock_guard<std::mutex> lock(mutex);
+    heap.push(make_pair(key, rawBaseCount));
+    heapBaseCount += rawBaseCount;
+    while(heap.size() > 1 and heapBaseCount - heap.top().second >= targetBaseCount) {
+        heapBaseCount -= heap.top().second;
+        heap.pop();
+    }
+    if(heapBaseCount >= targetBaseCount) {
+        threshold = heap.top().first;
+    }
+    return key <= threshold;
+}
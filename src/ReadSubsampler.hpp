@@ -0,0 +1,103 @@
+#ifndef SHASTA_READ_SUBSAMPLER_HPP
+#define SHASTA_READ_SUBSAMPLER_HPP
+
+/*******************************************************************************
+
+Class ReadSubsampler selects a subset of the reads with total number
+of raw bases close to targetCoverage * genomeSize, while the reads
+are being loaded, so most of the reads that are not selected
+are never stored.
+
+Each read gets a key, and the selected reads are those with the
+lowest keys, up to the first read at which the target number
+of bases is reached. The key can be:
+- For method "hash", a hash of the read name.
+  This gives a deterministic, unbiased random subsample.
+- For method "longest", the maximum uint64_t minus the raw read length,
+  so the longest reads are selected.
+
+The ReadSubsampler keeps a max-heap containing the key and length
+of the reads currently selected, and the largest key that can still
+be selected. Each call to select() checks the key of a read
+against that threshold, without locking, and only reads that pass
+are added to the heap, under a mutex. The threshold only decreases,
+so a read that was selected when it was seen can later become
+unselected. After all reads are loaded, a final pass over
+the names and lengths of the stored reads, using isSelected(),
+removes those. The final selection is the same regardless of
+the order in which reads are seen. Reads with the same key as the
+last selected read are all selected.
+
+*******************************************************************************/
+
+// Standard library.
+#include <atomic>
+#include "cstdint.hpp"
+#include <mutex>
+#include <queue>
+#include "string.hpp"
+#include "utility.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+    class ReadSubsampler;
+}
+
+
+
+class shasta::ReadSubsampler {
+public:
+
+    ReadSubsampler(
+        double targetCoverage,
+        uint64_t genomeSize,
+        const string& method);
+
+    // Called for each read that passes all other filters.
+    // Returns false if the read is not selected
+    // and does not need to be stored.
+    // This can be called by multiple threads at the same time.
+    bool select(
+        const char* nameBegin,
+        const char* nameEnd,
+        uint64_t rawBaseCount);
+
+    // Returns true if a read that was passed to select()
+    // is part of the final selection.
+    // Only valid after all reads were passed to select().
+    bool isSelected(
+        const char* nameBegin,
+        const char* nameEnd,
+        uint64_t rawBaseCount) const
+    {
+        return getKey(nameBegin, nameEnd, rawBaseCount) <= threshold;
+    }
+
+    const double targetCoverage;
+    const uint64_t genomeSize;
+    const string method;
+    const uint64_t targetBaseCount;
+
+    // The number of reads and raw bases passed to select().
+    uint64_t totalReadCount = 0;
+    uint64_t totalBaseCount = 0;
+
+private:
+    bool useHash;
+    uint64_t getKey(
+        const char* nameBegin,
+        const char* nameEnd,
+        uint64_t rawBaseCount) const;
+
+    // Reads with a key greater than this are not selected.
+    std::atomic<uint64_t> threshold;
+
+    // The keys and raw lengths of the selected reads,
+    // with the greatest key at the top, and their total length.
+    // Protected by the mutex.
+    std::priority_queue< pair<uint64_t, uint64_t> > heap;
+    uint64_t heapBaseCount = 0;
+    std::mutex mutex;
+};
+
+#endif
@@ -1,6 +1,16 @@
 #include "computeRunLengthRepresentation.hpp"
 using namespace shasta;
 
+// Vector intrinsics.
+#include <immintrin.h>
+
+// Standard library.
+#include "algorithm.hpp"
+#include "chrono.hpp"
+#include "iostream.hpp"
+#include <random>
+#include "string.hpp"
+
 
 
 // Given the raw representation of a sequence, compute its
@@ -43,3 +53,372 @@ bool shasta::computeRunLengthRepresentation(
     return true;
 
 }
+
+
+
+// Everything below is for the fused version that works
+// directly on the characters of the sequence.
+
+// Selection of the implementation to be used.
+// This is only done once.
+static bool useAvx2()
+{
+    static const bool avx2 = []()
+    {
+        __builtin_cpu_init();
+        return bool(__builtin_cpu_supports("avx2"));
+    }();
+    return avx2;
+}
+
+
+
+// Store a run-length base in the next position of a LongBaseSequence.
+// The words must be initialized to zero.
+static inline void storeRunLengthBase(
+    uint64_t* words,
+    uint64_t i,
+    uint64_t value)
+{
+    const uint64_t word0Index = (i >> 6ULL) << 1ULL;
+    const uint64_t bitIndex = 63ULL - (i & 63ULL);
+    words[word0Index] |= (value & 1ULL) << bitIndex;
+    words[word0Index + 1] |= (value >> 1ULL) << bitIndex;
+}
+
+
+
+// Scalar implementation.
+// The implementations store the run-length bases in words and the repeat counts
+// in repeatCounts. Both must have space for n entries.
+// If a run is too long we keep going, because an invalid base,
+// if present, takes precedence.
+static RunLengthStatus computeRunLengthRepresentationScalar(
+    const char* sequence,
+    uint64_t n,
+    uint64_t* words,
+    uint8_t* repeatCounts,
+    uint64_t& runCount,
+    uint64_t& invalidBaseOffset)
+{
+    runCount = 0;
+    uint64_t runBegin = 0;
+    uint8_t previousValue = 255;
+    bool repeatCountTooLarge = false;
+
+    for(uint64_t i=0; i!=n; i++) {
+        const uint8_t value = BaseInitializer::table[uint8_t(sequence[i])];
+        if(value == 255) {
+            invalidBaseOffset = i;
+            return RunLengthStatus::invalidBase;
+        }
+        if(value != previousValue) {
+            if(runCount) {
+                const uint64_t count = i - runBegin;
+                if(count > 255) {
+                    repeatCountTooLarge = true;
+                }
+                repeatCounts[runCount - 1] = uint8_t(count);
+            }
+            storeRunLengthBase(words, runCount, value);
+            ++runCount;
+            runBegin = i;
+            previousValue = value;
+        }
+    }
+
+    // Finish the last run.
+    if(runCount) {
+        const uint64_t count = n - runBegin;
+        if(count > 255) {
+            repeatCountTooLarge = true;
+        }
+        repeatCounts[runCount - 1] = uint8_t(count);
+    }
+
+    return repeatCountTooLarge ? RunLengthStatus::repeatCountTooLarge : RunLengthStatus::success;
+}
+
+
+
+// AVX2 implementation.
+// For each block of 32 characters:
+// - Convert to upper case and validate with four vector compares.
+// - Convert to base values (A=0, C=1, G=2, T=3) with a shuffle
+//   indexed by the low four bits of each character.
+// - Extract the two bit planes of the base values as bit masks.
+// - Compare each bit plane with itself shifted by one position
+//   (carrying over the last base of the previous block)
+//   to get a bit mask of the positions where a run begins.
+// - Iterate over the run begins to store run-length bases and repeat counts.
+// The last partial block is copied to a padded buffer
+// and masked out.
+__attribute__((target("avx2")))
+static RunLengthStatus computeRunLengthRepresentationAvx2(
+    const char* sequence,
+    uint64_t n,
+    uint64_t* words,
+    uint8_t* repeatCounts,
+    uint64_t& runCount,
+    uint64_t& invalidBaseOffset)
+{
+    const __m256i upperCaseMask = _mm256_set1_epi8(char(0xdf));
+    const __m256i lowBitsMask = _mm256_set1_epi8(0x0f);
+    const __m256i a = _mm256_set1_epi8('A');
+    const __m256i c = _mm256_set1_epi8('C');
+    const __m256i g = _mm256_set1_epi8('G');
+    const __m256i t = _mm256_set1_epi8('T');
+
+    // The low four bits of A, C, G, T are 1, 3, 7, 4.
+    const __m256i valueTable = _mm256_setr_epi8(
+        0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    runCount = 0;
+    uint64_t runBegin = 0;
+    bool repeatCountTooLarge = false;
+    uint32_t previousBit0 = 0;
+    uint32_t previousBit1 = 0;
+    char paddedBlock[32];
+
+    for(uint64_t blockBegin=0; blockBegin<n; blockBegin+=32) {
+
+        // Load this block.
+        const uint64_t blockSize = min(uint64_t(32), n - blockBegin);
+        const uint32_t blockMask = (blockSize == 32) ? 0xffffffffU : ((1U << blockSize) - 1U);
+        __m256i block;
+        if(blockSize == 32) {
+            block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sequence + blockBegin));
+        } else {
+            fill(paddedBlock, paddedBlock + 32, 'A');
+            copy(sequence + blockBegin, sequence + n, paddedBlock);
+            block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(paddedBlock));
+        }
+
+        // Validate.
+        const __m256i upperCase = _mm256_and_si256(block, upperCaseMask);
+        const __m256i isValid = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(upperCase, a), _mm256_cmpeq_epi8(upperCase, c)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(upperCase, g), _mm256_cmpeq_epi8(upperCase, t)));
+        const uint32_t invalid = ~uint32_t(_mm256_movemask_epi8(isValid)) & blockMask;
+        if(invalid) {
+            invalidBaseOffset = blockBegin + uint64_t(__builtin_ctz(invalid));
+            return RunLengthStatus::invalidBase;
+        }
+
+        // Get the two bit planes of the base values.
+        // The base values are less than 4, so the 16-bit shifts
+        // don't carry anything into bit 7 of the next byte.
+        const __m256i values = _mm256_shuffle_epi8(valueTable, _mm256_and_si256(block, lowBitsMask));
+        const uint32_t bit0 = uint32_t(_mm256_movemask_epi8(_mm256_slli_epi16(values, 7)));
+        const uint32_t bit1 = uint32_t(_mm256_movemask_epi8(_mm256_slli_epi16(values, 6)));
+
+        // Find the positions where a run begins.
+        uint32_t runBegins =
+            ((bit0 ^ ((bit0 << 1U) | previousBit0)) |
+             (bit1 ^ ((bit1 << 1U) | previousBit1))) & blockMask;
+        if(blockBegin == 0) {
+            runBegins |= 1U;
+        }
+        previousBit0 = bit0 >> 31U;
+        previousBit1 = bit1 >> 31U;
+
+        // Store the run-length bases and the repeat counts of the runs that just ended.
+        while(runBegins) {
+            const uint32_t j = uint32_t(__builtin_ctz(runBegins));
+            const uint64_t i = blockBegin + j;
+            if(runCount) {
+                const uint64_t count = i - runBegin;
+                if(count > 255) {
+                    repeatCountTooLarge = true;
+                }
+                repeatCounts[runCount - 1] = uint8_t(count);
+            }
+            storeRunLengthBase(words, runCount, (((bit1 >> j) & 1U) << 1U) | ((bit0 >> j) & 1U));
+            ++runCount;
+            runBegin = i;
+            runBegins &= runBegins - 1U;
+        }
+    }
+
+    // Finish the last run.
+    if(runCount) {
+        const uint64_t count = n - runBegin;
+        if(count > 255) {
+            repeatCountTooLarge = true;
+        }
+        repeatCounts[runCount - 1] = uint8_t(count);
+    }
+
+    return repeatCountTooLarge ? RunLengthStatus::repeatCountTooLarge : RunLengthStatus::success;
+}
+
+
+
+RunLengthStatus shasta::computeRunLengthRepresentation(
+    const char* begin,
+    const char* end,
+    LongBaseSequence& runLengthSequence,
+    vector<uint8_t>& repeatCount,
+    uint64_t& invalidBaseOffset)
+{
+    // Make space for the worst case, one run per base.
+    const uint64_t n = uint64_t(end - begin);
+    runLengthSequence.initialize(n);
+    repeatCount.resize(n);
+
+    uint64_t runCount = 0;
+    const RunLengthStatus status = useAvx2() ?
+        computeRunLengthRepresentationAvx2(
+            begin, n, runLengthSequence.begin, repeatCount.data(), runCount, invalidBaseOffset) :
+        computeRunLengthRepresentationScalar(
+            begin, n, runLengthSequence.begin, repeatCount.data(), runCount, invalidBaseOffset);
+
+    runLengthSequence.baseCount = runCount;
+    repeatCount.resize(runCount);
+    return status;
+}
+
+
+
+// Check the fused version against the scalar version above
+// on random sequences and time them.
+void shasta::testComputeRunLengthRepresentation()
+{
+    std::mt19937 randomSource(231);
+    using Distribution = std::uniform_int_distribution<uint64_t>;
+    const string baseCharacters = "ACGTacgt";
+
+    // Generate a random sequence with a realistic
+    // distribution of homopolymer run lengths.
+    auto generateSequence = [&](uint64_t length, string& sequence)
+    {
+        sequence.clear();
+        while(sequence.size() < length) {
+            const char character = baseCharacters[Distribution(0, 7)(randomSource)];
+            const uint64_t runLength = 1 + Distribution(0, 3)(randomSource) * Distribution(0, 2)(randomSource);
+            for(uint64_t i=0; i<runLength && sequence.size()<length; i++) {
+                sequence.push_back(character);
+            }
+        }
+    };
+
+    // The current scalar code path: convert to bases,
+    // compute the run-length representation, then pack.
+    auto computeReference = [](
+        const string& sequence,
+        vector<Base>& bases,
+        vector<Base>& runLengthBases,
+        vector<uint8_t>& repeatCount,
+        uint64_t& invalidBaseOffset) -> RunLengthStatus
+    {
+        bases.clear();
+        for(uint64_t i=0; i<sequence.size(); i++) {
+            const Base base = Base::fromCharacterNoException(sequence[i]);
+            if(!base.isValid()) {
+                invalidBaseOffset = i;
+                return RunLengthStatus::invalidBase;
+            }
+            bases.push_back(base);
+        }
+        if(computeRunLengthRepresentation(bases, runLengthBases, repeatCount)) {
+            return RunLengthStatus::success;
+        } else {
+            return RunLengthStatus::repeatCountTooLarge;
+        }
+    };
+
+
+
+    // Check both implementations against the reference.
+    string sequence;
+    vector<Base> bases;
+    vector<Base> runLengthBases;
+    vector<uint8_t> expectedRepeatCount;
+    LongBaseSequence runLengthSequence;
+    vector<uint8_t> repeatCount;
+    const uint64_t testCount = 100000;
+    for(uint64_t test=0; test<testCount; test++) {
+        generateSequence(Distribution(0, 300)(randomSource), sequence);
+        if(sequence.size() > 0 && Distribution(0, 9)(randomSource) == 0) {
+            sequence[Distribution(0, sequence.size() - 1)(randomSource)] = 'N';
+        }
+        if(Distribution(0, 19)(randomSource) == 0) {
+            const uint64_t position = Distribution(0, sequence.size())(randomSource);
+            sequence.insert(position, Distribution(250, 260)(randomSource), 'G');
+        }
+
+        uint64_t expectedInvalidBaseOffset = 0;
+        const RunLengthStatus expectedStatus = computeReference(
+            sequence, bases, runLengthBases, expectedRepeatCount, expectedInvalidBaseOffset);
+
+        for(uint64_t implementation=0; implementation<2; implementation++) {
+            if(implementation==1 && !useAvx2()) {
+                continue;
+            }
+            const uint64_t n = sequence.size();
+            runLengthSequence.initialize(n);
+            repeatCount.resize(n);
+            uint64_t runCount = 0;
+            uint64_t invalidBaseOffset = 0;
+            const RunLengthStatus status = (implementation == 0) ?
+                computeRunLengthRepresentationScalar(
+                    sequence.data(), n, runLengthSequence.begin, repeatCount.data(),
+                    runCount, invalidBaseOffset) :
+                computeRunLengthRepresentationAvx2(
+                    sequence.data(), n, runLengthSequence.begin, repeatCount.data(),
+                    runCount, invalidBaseOffset);
+            runLengthSequence.baseCount = runCount;
+            repeatCount.resize(runCount);
+
+            SHASTA_ASSERT(status == expectedStatus);
+            if(status == RunLengthStatus::invalidBase) {
+                SHASTA_ASSERT(invalidBaseOffset == expectedInvalidBaseOffset);
+            } else if(status == RunLengthStatus::success) {
+                SHASTA_ASSERT(repeatCount == expectedRepeatCount);
+                SHASTA_ASSERT(runCount == runLengthBases.size());
+                for(uint64_t i=0; i<runCount; i++) {
+                    SHASTA_ASSERT(runLengthSequence[i] == runLengthBases[i]);
+                }
+            }
+        }
+    }
+    cout << "Tested " << testCount << " random sequences." << endl;
+
+
+
+    // Time the reference code path and the fused version.
+    const uint64_t readCount = 1000;
+    const uint64_t readLength = 20000;
+    vector<string> reads(readCount);
+    for(string& read: reads) {
+        generateSequence(readLength, read);
+    }
+    const double baseCount = double(readCount * readLength);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    uint64_t checkSum0 = 0;
+    for(const string& read: reads) {
+        uint64_t invalidBaseOffset;
+        computeReference(read, bases, runLengthBases, expectedRepeatCount, invalidBaseOffset);
+        const LongBaseSequence packed(runLengthBases);
+        checkSum0 += packed.baseCount;
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    uint64_t checkSum1 = 0;
+    for(const string& read: reads) {
+        uint64_t invalidBaseOffset;
+        computeRunLengthRepresentation(
+            read.data(), read.data() + read.size(), runLengthSequence, repeatCount, invalidBaseOffset);
+        checkSum1 += runLengthSequence.baseCount;
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    SHASTA_ASSERT(checkSum0 == checkSum1);
+
+    const double t01 = seconds(t1 - t0);
+    const double t12 = seconds(t2 - t1);
+    cout << "Scalar: " << t01 << " s, " << 1.e-6 * baseCount / t01 << " Mb/s." << endl;
+    cout << "Fused (" << (useAvx2() ? "AVX2" : "scalar") << "): " <<
+        t12 << " s, " << 1.e-6 * baseCount / t12 << " Mb/s." << endl;
+    cout << "Speedup: " << t01 / t12 << endl;
+}
@@ -2,6 +2,7 @@
 #define SHASTA_COMPUTE_RUN_LENGTH_REPRESENTATION_HPP
 
 #include "Base.hpp"
+#include "LongBaseSequence.hpp"
 #include "vector.hpp"
 
 namespace shasta {
@@ -16,6 +17,33 @@ namespace shasta {
         vector<Base>& runLengthSequence,
         vector<uint8_t>& repeatCount);
 
+
+
+    // Fused version that works directly on the characters of a sequence
+    // as they appear in a fasta or fastq file.
+    // In a single pass, it validates the bases, computes the
+    // run-length representation, and stores the run-length bases
+    // already packed in the two bit representation used by LongBaseSequence.
+    // Upper and lower case bases are accepted.
+    // If the return value is invalidBase, invalidBaseOffset is set to
+    // the offset, relative to begin, of the first invalid character.
+    // The AVX2 implementation processes 32 characters at a time
+    // and is selected at run time if the processor supports it.
+    enum class RunLengthStatus {
+        success,
+        invalidBase,
+        repeatCountTooLarge
+    };
+    RunLengthStatus computeRunLengthRepresentation(
+        const char* begin,
+        const char* end,
+        LongBaseSequence& runLengthSequence,
+        vector<uint8_t>& repeatCount,
+        uint64_t& invalidBaseOffset);
+
+    // Check the fused version against the scalar version above
+    // on random sequences and time them.
+    void testComputeRunLengthRepresentation();
 }
 
 #endif
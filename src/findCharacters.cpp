@@ -0,0 +1,297 @@
+#include "findCharacters.hpp"
+using namespace shasta;
+
+// Vector intrinsics.
+#include <immintrin.h>
+
+
+
+// Selection of the implementation to be used.
+namespace shasta {
+    namespace findCharactersImplementation {
+        enum class InstructionSet {scalar, SSE2, AVX2};
+        InstructionSet getInstructionSet();
+    }
+}
+using namespace shasta::findCharactersImplementation;
+
+
+
+// Determine the instruction set to use.
+// This is only done once.
+InstructionSet shasta::findCharactersImplementation::getInstructionSet()
+{
+    static const InstructionSet instructionSet = []()
+    {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            return InstructionSet::AVX2;
+        } else if(__builtin_cpu_supports("sse2")) {
+            return InstructionSet::SSE2;
+        } else {
+            return InstructionSet::scalar;
+        }
+    }();
+    return instructionSet;
+}
+
+
+
+const char* shasta::findCharactersInstructionSet()
+{
+    switch(getInstructionSet()) {
+    case InstructionSet::AVX2:
+        return "AVX2";
+    case InstructionSet::SSE2:
+        return "SSE2";
+    default:
+        return "scalar";
+    }
+}
+
+
+
+// Scalar implementations.
+// These are also used for the tail of the range
+// by the vector implementations.
+static void findCharactersScalar(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c,
+    vector<uint64_t>& positions)
+{
+    for(uint64_t i=begin; i!=end; i++) {
+        if(data[i] == c) {
+            positions.push_back(i);
+        }
+    }
+}
+static uint64_t findCharacterScalar(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c)
+{
+    for(uint64_t i=begin; i!=end; i++) {
+        if(data[i] == c) {
+            return i;
+        }
+    }
+    return end;
+}
+static uint64_t findFastaReadBeginScalar(
+    const char* data,
+    uint64_t begin,
+    uint64_t end)
+{
+    for(uint64_t i=begin; i!=end; i++) {
+        if(data[i] == '>' and (i == 0 or data[i-1] == '\n')) {
+            return i;
+        }
+    }
+    return end;
+}
+
+
+
+// AVX2 implementations.
+__attribute__((target("avx2")))
+static void findCharactersAvx2(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c,
+    vector<uint64_t>& positions)
+{
+    const __m256i target = _mm256_set1_epi8(c);
+    uint64_t i = begin;
+    for(; i+32<=end; i+=32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target)));
+        while(mask) {
+            positions.push_back(i + uint64_t(__builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+    findCharactersScalar(data, i, end, c, positions);
+}
+__attribute__((target("avx2")))
+static uint64_t findCharacterAvx2(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c)
+{
+    const __m256i target = _mm256_set1_epi8(c);
+    uint64_t i = begin;
+    for(; i+32<=end; i+=32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target)));
+        if(mask) {
+            return i + uint64_t(__builtin_ctz(mask));
+        }
+    }
+    return findCharacterScalar(data, i, end, c);
+}
+__attribute__((target("avx2")))
+static uint64_t findFastaReadBeginAvx2(
+    const char* data,
+    uint64_t begin,
+    uint64_t end)
+{
+    // Offset 0 has no preceding character.
+    if(begin == 0) {
+        if(end == 0 or data[0] == '>') {
+            return 0;
+        }
+        begin = 1;
+    }
+
+    // Compare each block against '>' and the block
+    // shifted back by one byte against '\n'.
+    const __m256i greater = _mm256_set1_epi8('>');
+    const __m256i newLine = _mm256_set1_epi8('\n');
+    uint64_t i = begin;
+    for(; i+32<=end; i+=32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        const __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i - 1));
+        const __m256i match = _mm256_and_si256(
+            _mm256_cmpeq_epi8(block, greater),
+            _mm256_cmpeq_epi8(previous, newLine));
+        const uint32_t mask = uint32_t(_mm256_movemask_epi8(match));
+        if(mask) {
+            return i + uint64_t(__builtin_ctz(mask));
+        }
+    }
+    return findFastaReadBeginScalar(data, i, end);
+}
+
+
+
+// SSE2 implementations.
+__attribute__((target("sse2")))
+static void findCharactersSse2(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c,
+    vector<uint64_t>& positions)
+{
+    const __m128i target = _mm_set1_epi8(c);
+    uint64_t i = begin;
+    for(; i+16<=end; i+=16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)));
+        while(mask) {
+            positions.push_back(i + uint64_t(__builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+    }
+    findCharactersScalar(data, i, end, c, positions);
+}
+__attribute__((target("sse2")))
+static uint64_t findCharacterSse2(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c)
+{
+    const __m128i target = _mm_set1_epi8(c);
+    uint64_t i = begin;
+    for(; i+16<=end; i+=16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)));
+        if(mask) {
+            return i + uint64_t(__builtin_ctz(mask));
+        }
+    }
+    return findCharacterScalar(data, i, end, c);
+}
+__attribute__((target("sse2")))
+static uint64_t findFastaReadBeginSse2(
+    const char* data,
+    uint64_t begin,
+    uint64_t end)
+{
+    // Offset 0 has no preceding character.
+    if(begin == 0) {
+        if(end == 0 or data[0] == '>') {
+            return 0;
+        }
+        begin = 1;
+    }
+
+    const __m128i greater = _mm_set1_epi8('>');
+    const __m128i newLine = _mm_set1_epi8('\n');
+    uint64_t i = begin;
+    for(; i+16<=end; i+=16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i - 1));
+        const __m128i match = _mm_and_si128(
+            _mm_cmpeq_epi8(block, greater),
+            _mm_cmpeq_epi8(previous, newLine));
+        const uint32_t mask = uint32_t(_mm_movemask_epi8(match));
+        if(mask) {
+            return i + uint64_t(__builtin_ctz(mask));
+        }
+    }
+    return findFastaReadBeginScalar(data, i, end);
+}
+
+
+
+// Functions that dispatch to the appropriate implementation.
+void shasta::findCharacters(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c,
+    vector<uint64_t>& positions)
+{
+    switch(getInstructionSet()) {
+    case InstructionSet::AVX2:
+        findCharactersAvx2(data, begin, end, c, positions);
+        return;
+    case InstructionSet::SSE2:
+        findCharactersSse2(data, begin, end, c, positions);
+        return;
+    default:
+        findCharactersScalar(data, begin, end, c, positions);
+    }
+}
+
+
+
+uint64_t shasta::findCharacter(
+    const char* data,
+    uint64_t begin,
+    uint64_t end,
+    char c)
+{
+    switch(getInstructionSet()) {
+    case InstructionSet::AVX2:
+        return findCharacterAvx2(data, begin, end, c);
+    case InstructionSet::SSE2:
+        return findCharacterSse2(data, begin, end, c);
+    default:
+        return findCharacterScalar(data, begin, end, c);
+    }
+}
+
+
+
+uint64_t shasta::findFastaReadBegin(
+    const char* data,
+    uint64_t begin,
+    uint64_t end)
+{
+    switch(getInstructionSet()) {
+    case InstructionSet::AVX2:
+        return findFastaReadBeginAvx2(data, begin, end);
+    case InstructionSet::SSE2:
+        return findFastaReadBeginSse2(data, begin, end);
+    default:
+        return findFastaReadBeginScalar(data, begin, end);
+    }
+}
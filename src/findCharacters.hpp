@@ -0,0 +1,57 @@
+#ifndef SHASTA_FIND_CHARACTERS_HPP
+#define SHASTA_FIND_CHARACTERS_HPP
+
+/*******************************************************************************
+
+Character scanning functions used by ReadLoader to locate
+line ends and the beginning of fasta reads.
+
+Each function has an AVX2 implementation (32 bytes at a time),
+an SSE2 implementation (16 bytes at a time), and a scalar implementation.
+The implementation to be used is selected at run time based on the
+capabilities of the processor, so these functions are fast
+even when Shasta is not built with -march=native.
+The vector implementations compare a block of bytes against
+the target character, extract the result as a bit mask,
+and then iterate over the bits that are set.
+
+All offsets are relative to the data pointer passed in, and all
+functions operate on the half-open range [begin, end).
+
+*******************************************************************************/
+
+#include "cstdint.hpp"
+#include "vector.hpp"
+
+namespace shasta {
+
+    // Append to positions the offsets of all occurrences of character c.
+    void findCharacters(
+        const char* data,
+        uint64_t begin,
+        uint64_t end,
+        char c,
+        vector<uint64_t>& positions);
+
+    // Return the offset of the first occurrence of character c,
+    // or end if there is none.
+    uint64_t findCharacter(
+        const char* data,
+        uint64_t begin,
+        uint64_t end,
+        char c);
+
+    // Return the offset of the first '>' that is at offset 0
+    // or immediately follows a '\n' (that is, the beginning
+    // of a read in fasta format), or end if there is none.
+    uint64_t findFastaReadBegin(
+        const char* data,
+        uint64_t begin,
+        uint64_t end);
+
+    // Return the instruction set used by the above functions:
+    // "AVX2", "SSE2", or "scalar".
+    const char* findCharactersInstructionSet();
+}
+
+#endif
@@ -18,7 +18,8 @@ namespace shasta {
         void assemble(
             Assembler&,
             const AssemblerOptions&,
-            vector<string> inputNames);
+            vector<string> inputNames,
+            const string& cacheDirectory);
 
         void setupRunDirectory(
             const string& memoryMode,
@@ -157,6 +158,33 @@ void shasta::main::assemble(
             to_string(assemblerOptions.assemblyOptions.strategy));
     }
 
+    // Check the read subsampling options.
+    if(assemblerOptions.readsOptions.targetCoverage > 0.) {
+        if(assemblerOptions.readsOptions.genomeSize == 0) {
+            throw runtime_error("Reads.genomeSize must be specified when using Reads.targetCoverage.");
+        }
+        if(assemblerOptions.readsOptions.subsamplingMethod != "hash" and
+            assemblerOptions.readsOptions.subsamplingMethod != "longest") {
+            throw runtime_error("Invalid Reads.subsamplingMethod " +
+                assemblerOptions.readsOptions.subsamplingMethod +
+                ". Must be hash or longest.");
+        }
+    }
+
+    // Check the minimizer window.
+    if(assemblerOptions.kmersOptions.minimizerWindow < 0) {
+        throw runtime_error("Invalid Kmers.minimizerWindow " +
+            to_string(assemblerOptions.kmersOptions.minimizerWindow));
+    }
+
+    // The k-mer occurrence index is indexed by KmerId,
+    // so its size grows as 4^k.
+    if(assemblerOptions.kmersOptions.storeKmerOccurrences and
+        uint64_t(assemblerOptions.kmersOptions.k) > Assembler::maxKmerOccurrencesK) {
+        throw runtime_error("Kmers.storeKmerOccurrences can only be used with Kmers.k <= " +
+            to_string(Assembler::maxKmerOccurrencesK) + ".");
+    }
+
     // Check that we have at least one input file.
     if(assemblerOptions.commandLineOnlyOptions.inputFileNames.empty()) {
         cout << executableDescription << assemblerOptions.allOptionsDescription << endl;
@@ -184,6 +212,19 @@ void shasta::main::assemble(
             " specified for --MinHash.version. Must be 0 or 1.");
     }
 
+    // The adaptive LowHash iteration count is only available with MinHash.version 0.
+    if(assemblerOptions.minHashOptions.minNewCandidateFraction < 0. or
+        assemblerOptions.minHashOptions.minCandidatesPerRead < 0) {
+        throw runtime_error("--MinHash.minNewCandidateFraction and "
+            "--MinHash.minCandidatesPerRead cannot be negative.");
+    }
+    if(assemblerOptions.minHashOptions.version != 0 and
+        (assemblerOptions.minHashOptions.minNewCandidateFraction > 0. or
+        assemblerOptions.minHashOptions.minCandidatesPerRead > 0)) {
+        throw runtime_error("--MinHash.minNewCandidateFraction and "
+            "--MinHash.minCandidatesPerRead can only be used with --MinHash.version 0.");
+    }
+
     // If coverage data was requested, memoryMode should be filesystem,
     // otherwise the coverage data cannot be accessed.
     if(assemblerOptions.assemblyOptions.storeCoverageData) {
@@ -220,6 +261,17 @@ void shasta::main::assemble(
         inputFileAbsolutePaths.push_back(filesystem::getAbsolutePath(inputFileName));
     }
 
+    // Same for the reads cache directory, if one was specified.
+    // Create it if it does not exist.
+    string cacheDirectoryAbsolutePath;
+    const string& cacheDirectory = assemblerOptions.readsOptions.cacheDirectory;
+    if(!cacheDirectory.empty()) {
+        if(!filesystem::exists(cacheDirectory)) {
+            filesystem::createDirectory(cacheDirectory);
+        }
+        cacheDirectoryAbsolutePath = filesystem::getAbsolutePath(cacheDirectory);
+    }
+
 
 
     // Create the run the output directory. If it exists, stop.
@@ -298,7 +350,7 @@ void shasta::main::assemble(
     Assembler assembler(dataDirectory, true, pageSize);
 
     // Run the assembly.
-    assemble(assembler, assemblerOptions, inputFileAbsolutePaths);
+    assemble(assembler, assemblerOptions, inputFileAbsolutePaths, cacheDirectoryAbsolutePath);
 
     // Final disclaimer message.
 #ifdef __linux
@@ -435,7 +487,8 @@ void shasta::main::setupRunDirectory(
 void shasta::main::assemble(
     Assembler& assembler,
     const AssemblerOptions& assemblerOptions,
-    vector<string> inputFileNames)
+    vector<string> inputFileNames,
+    const string& cacheDirectory)
 {
     const auto steadyClock0 = std::chrono::steady_clock::now();
     const auto userClock0 = boost::chrono::process_user_cpu_clock::now();
@@ -458,18 +511,38 @@ void shasta::main::assemble(
     // Add reads from the specified input files.
     cout << timestamp << "Begin loading reads from " << inputFileNames.size() << " files." << endl;
     const auto t0 = steady_clock::now();
-    for(const string& inputFileName: inputFileNames) {
-        assembler.addReads(
-            inputFileName,
-            assemblerOptions.readsOptions.minReadLength,
-            threadCount);
-    }
+    assembler.addReads(
+        inputFileNames,
+        assemblerOptions.readsOptions.minReadLength,
+        threadCount,
+        assemblerOptions.readsOptions.loadBufferSize,
+        size_t(max(1, assemblerOptions.readsOptions.concurrentFileCount)),
+        cacheDirectory,
+        assemblerOptions.readsOptions.targetCoverage,
+        assemblerOptions.readsOptions.genomeSize,
+        assemblerOptions.readsOptions.subsamplingMethod);
     if(assembler.readCount() == 0) {
         throw runtime_error("There are no input reads.");
     }
     const auto t1 = steady_clock::now();
     cout << timestamp << "Done loading reads from " << inputFileNames.size() << " files." << endl;
-    cout << "Read loading took " << seconds(t1-t0) << "s." << endl;
+    cout << "Read loading took " << seconds(t1-t0) << "s";
+    const double decompressionTime = assembler.getInputDecompressionTime();
+    if(decompressionTime > 0.) {
+        cout << ", including " << decompressionTime << "s to read and decompress " <<
+            assembler.getDecompressedInputByteCount() << " bytes of gzip compressed input (" <<
+            double(assembler.getDecompressedInputByteCount()) / decompressionTime <<
+            " decompressed bytes/s)";
+    }
+    cout << "." << endl;
+
+    // If requested, store repeat counts and read names in compressed form.
+    if(assemblerOptions.readsOptions.compressRepeatCounts) {
+        assembler.compressReadRepeatCounts();
+    }
+    if(assemblerOptions.readsOptions.compressNames) {
+        assembler.compressReadNames();
+    }
 
 
 
@@ -492,7 +565,23 @@ void shasta::main::assemble(
     }
 
     // Find the markers in the reads.
-    assembler.findMarkers(0);
+    assembler.findMarkers(0,
+        not assemblerOptions.kmersOptions.storeStrand0MarkersOnly,
+        uint64_t(assemblerOptions.kmersOptions.minimizerWindow),
+        assemblerOptions.kmersOptions.findMarkersInSinglePass);
+
+    // Optionally sort the markers of each oriented read by k-mer id.
+    // This way it does not need to be done for each alignment.
+    if(assemblerOptions.kmersOptions.storeSortedMarkers) {
+        assembler.computeSortedMarkers(threadCount);
+    }
+
+    // Optionally create the k-mer occurrence index.
+    // This is not used by the assembly, but it allows the http server
+    // and Python scripts to find the reads that contain a given sequence.
+    if(assemblerOptions.kmersOptions.storeKmerOccurrences) {
+        assembler.computeKmerOccurrences(threadCount);
+    }
 
     // Flag palindromic reads.
     // These will be excluded from further processing.
@@ -519,7 +608,10 @@ void shasta::main::assemble(
             assemblerOptions.minHashOptions.minBucketSize,
             assemblerOptions.minHashOptions.maxBucketSize,
             assemblerOptions.minHashOptions.minFrequency,
-            threadCount);
+            threadCount,
+            assemblerOptions.minHashOptions.hashFeaturesOnce,
+            assemblerOptions.minHashOptions.minNewCandidateFraction,
+            assemblerOptions.minHashOptions.minCandidatesPerRead);
     } else {
         SHASTA_ASSERT(assemblerOptions.minHashOptions.version == 1);    // Already checked for that.
         assembler.findAlignmentCandidatesLowHash1(
@@ -530,7 +622,8 @@ void shasta::main::assemble(
             assemblerOptions.minHashOptions.minBucketSize,
             assemblerOptions.minHashOptions.maxBucketSize,
             assemblerOptions.minHashOptions.minFrequency,
-            threadCount);
+            threadCount,
+            assemblerOptions.minHashOptions.hashFeaturesOnce);
     }
 
 